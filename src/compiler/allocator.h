@@ -17,5 +17,11 @@ namespace stackjit {
 
 		//Makes the given memory executable
 		bool makeExecutable(void* memory, std::size_t size);
+
+		//Reserves address space of the given size, without memory backing it. Deallocated as any memory block.
+		void* reserve(std::size_t size);
+
+		//Commits memory to the given part of reserved address space. The committed memory is zeroed.
+		bool commit(void* memory, std::size_t size);
 	}
 }
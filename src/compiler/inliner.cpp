@@ -0,0 +1,332 @@
+#include "inliner.h"
+#include "../vmstate.h"
+#include "../loader/verifier.h"
+#include "../core/functionsignature.h"
+#include "../type/type.h"
+#include <stdexcept>
+
+namespace stackjit {
+	namespace {
+		//The maximum number of instructions that a function can grow to by inlining
+		const std::size_t MAX_FUNCTION_SIZE = 2000;
+
+		//Indicates if the given instruction is a branch
+		bool isBranch(const Instruction& instruction) {
+			switch (instruction.opCode()) {
+				case OpCodes::BRANCH:
+				case OpCodes::BRANCH_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		//Creates an instruction with an int operand
+		Instruction makeWithInt(OpCodes opCode, int value) {
+			Instruction instruction(opCode);
+			instruction.intValue = value;
+			return instruction;
+		}
+
+		//Creates an instruction that loads the default value for the given type
+		Instruction loadDefaultValue(const Type* type) {
+			if (TypeSystem::isPrimitiveType(type, PrimitiveTypes::Integer)) {
+				return makeWithInt(OpCodes::LOAD_INT, 0);
+			} else if (TypeSystem::isPrimitiveType(type, PrimitiveTypes::Float)) {
+				return Instruction(OpCodes::LOAD_FLOAT);
+			} else if (TypeSystem::isPrimitiveType(type, PrimitiveTypes::Char)) {
+				return Instruction(OpCodes::LOAD_CHAR);
+			} else if (TypeSystem::isPrimitiveType(type, PrimitiveTypes::Bool)) {
+				return Instruction(OpCodes::LOAD_FALSE);
+			} else {
+				return Instruction(OpCodes::LOAD_NULL);
+			}
+		}
+
+		//Indicates if the given local of the given function can be read before it has been written to.
+		//For functions without branches, this is the case if the first use of the local is not a store.
+		bool mayReadDefaultValue(const ManagedFunction& function, std::size_t local) {
+			for (auto& instruction : function.instructions()) {
+				if (isBranch(instruction)) {
+					return true;
+				}
+			}
+
+			for (auto& instruction : function.instructions()) {
+				if ((instruction.opCode() == OpCodes::LOAD_LOCAL || instruction.opCode() == OpCodes::STORE_LOCAL)
+					&& instruction.intValue == (int)local) {
+					return instruction.opCode() == OpCodes::LOAD_LOCAL;
+				}
+			}
+
+			return false;
+		}
+
+		//Indicates if the first instruction of the given member function that can fail or has side effects
+		//accesses 'this'. The null check of the access then replaces the null check made by the call.
+		bool accessesThisFirst(const ManagedFunction& function) {
+			//Indicates if the operands are 'this'
+			std::vector<bool> isThis;
+
+			for (auto& instruction : function.instructions()) {
+				switch (instruction.opCode()) {
+					case OpCodes::LOAD_ARG:
+						isThis.push_back(instruction.intValue == 0);
+						break;
+					case OpCodes::LOAD_LOCAL:
+					case OpCodes::LOAD_INT:
+					case OpCodes::LOAD_FLOAT:
+					case OpCodes::LOAD_CHAR:
+					case OpCodes::LOAD_TRUE:
+					case OpCodes::LOAD_FALSE:
+					case OpCodes::LOAD_NULL:
+						isThis.push_back(false);
+						break;
+					case OpCodes::LOAD_FIELD:
+						return !isThis.empty() && isThis.back();
+					case OpCodes::STORE_FIELD:
+						return isThis.size() >= 2 && isThis[isThis.size() - 2];
+					case OpCodes::CALL_INSTANCE:
+					case OpCodes::CALL_VIRTUAL: {
+						auto numArgs = instruction.parameters.size() + 1;
+						return isThis.size() >= numArgs && isThis[isThis.size() - numArgs];
+					}
+					default:
+						return false;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	Inliner::Inliner(VMState& vmState, Verifier& verifier, LoadFunction loadFunction)
+		: mVMState(vmState), mVerifier(verifier), mLoadFunction(loadFunction) {
+
+	}
+
+	const ManagedFunction* Inliner::getInlineCandidate(const ManagedFunction& function, std::size_t index) const {
+		auto& instruction = function.instructions()[index];
+		std::string signature;
+
+		switch (instruction.opCode()) {
+			case OpCodes::CALL:
+				signature = FunctionSignature::function(instruction.stringValue, instruction.parameters).str();
+				break;
+			case OpCodes::CALL_INSTANCE:
+				signature = FunctionSignature::memberFunction(
+					instruction.classType,
+					instruction.stringValue,
+					instruction.parameters).str();
+				break;
+			case OpCodes::NEW_OBJECT:
+				if (!instruction.callConstructor) {
+					return nullptr;
+				}
+
+				signature = FunctionSignature::memberFunction(
+					instruction.classType,
+					instruction.stringValue,
+					instruction.parameters).str();
+				break;
+			default:
+				return nullptr;
+		}
+
+		auto callee = mLoadFunction(signature);
+		if (callee == nullptr
+			|| &callee->def() == &function.def()
+			|| callee->instructions().size() > (std::size_t)mVMState.config.inlineMaxSize) {
+			return nullptr;
+		}
+
+		//Recursive calls are not inlined, and the depth of the inlining is bounded
+		int depth = 0;
+		for (auto& inlinedFunction : function.inlinedFunctions()) {
+			if (inlinedFunction.contains((int)index)) {
+				if (inlinedFunction.function == &callee->def()) {
+					return nullptr;
+				}
+
+				depth++;
+			}
+		}
+
+		if (depth >= mVMState.config.inlineMaxDepth) {
+			return nullptr;
+		}
+
+		if (instruction.opCode() == OpCodes::CALL_INSTANCE && !accessesThisFirst(*callee)) {
+			return nullptr;
+		}
+
+		return callee;
+	}
+
+	bool Inliner::tryInline(ManagedFunction& function, std::size_t index, const ManagedFunction& callee) {
+		auto& instructions = function.instructions();
+		auto& call = instructions[index];
+		bool isConstructor = call.opCode() == OpCodes::NEW_OBJECT;
+
+		auto numArgs = callee.def().numParameters();
+		auto numLocals = callee.numLocals();
+		auto firstLocal = function.numLocals();
+
+		std::vector<bool> isArgumentUsed(numArgs, false);
+		for (auto& instruction : callee.instructions()) {
+			if (instruction.opCode() == OpCodes::LOAD_ARG) {
+				isArgumentUsed[instruction.intValue] = true;
+			}
+		}
+
+		std::vector<Instruction> inlined;
+
+		//The arguments are stored in locals. For constructors, the object is created before the constructor is called.
+		for (int arg = (int)numArgs - 1; arg >= (isConstructor ? 1 : 0); arg--) {
+			if (isArgumentUsed[arg]) {
+				inlined.push_back(makeWithInt(OpCodes::STORE_LOCAL, (int)(firstLocal + arg)));
+			} else {
+				inlined.push_back(Instruction(OpCodes::POP));
+			}
+		}
+
+		if (isConstructor) {
+			Instruction newObject(call);
+			newObject.callConstructor = false;
+			inlined.push_back(newObject);
+
+			if (isArgumentUsed[0]) {
+				inlined.push_back(Instruction(OpCodes::DUPLICATE));
+				inlined.push_back(makeWithInt(OpCodes::STORE_LOCAL, (int)firstLocal));
+			}
+		}
+
+		//The locals are reset, as they might have been used by a previous execution of the inlined code
+		for (std::size_t local = 0; local < numLocals; local++) {
+			if (mayReadDefaultValue(callee, local)) {
+				inlined.push_back(loadDefaultValue(callee.getLocal(local)));
+				inlined.push_back(makeWithInt(OpCodes::STORE_LOCAL, (int)(firstLocal + numArgs + local)));
+			}
+		}
+
+		//The body. The last instruction is the return, which falls through to the instruction after the call.
+		auto& calleeInstructions = callee.instructions();
+		auto bodyStart = index + inlined.size();
+		auto bodyEnd = bodyStart + calleeInstructions.size() - 1;
+
+		for (std::size_t i = 0; i < calleeInstructions.size(); i++) {
+			auto& instruction = calleeInstructions[i];
+
+			switch (instruction.opCode()) {
+				case OpCodes::LOAD_ARG:
+					inlined.push_back(makeWithInt(OpCodes::LOAD_LOCAL, (int)firstLocal + instruction.intValue));
+					break;
+				case OpCodes::LOAD_LOCAL:
+				case OpCodes::STORE_LOCAL: {
+					Instruction variableInstruction(instruction);
+					variableInstruction.intValue += (int)(firstLocal + numArgs);
+					inlined.push_back(variableInstruction);
+					break;
+				}
+				case OpCodes::RET:
+					if (i != calleeInstructions.size() - 1) {
+						inlined.push_back(makeWithInt(OpCodes::BRANCH, (int)bodyEnd));
+					}
+					break;
+				default:
+					inlined.push_back(instruction);
+
+					if (isBranch(instruction)) {
+						inlined.back().intValue += (int)bodyStart;
+					}
+					break;
+			}
+		}
+
+		//Create the new function and verify it. This also computes the types of the inlined operands.
+		auto growth = inlined.size() - 1;
+		ManagedFunction inlinedFunction(function.def());
+		inlinedFunction.setJitTier(function.jitTier());
+
+		inlinedFunction.setNumLocals(firstLocal + numArgs + numLocals);
+		for (std::size_t local = 0; local < firstLocal; local++) {
+			inlinedFunction.setLocal(local, function.getLocal(local));
+		}
+
+		for (std::size_t arg = 0; arg < numArgs; arg++) {
+			inlinedFunction.setLocal(firstLocal + arg, callee.def().parameters()[arg]);
+		}
+
+		for (std::size_t local = 0; local < numLocals; local++) {
+			inlinedFunction.setLocal(firstLocal + numArgs + local, callee.getLocal(local));
+		}
+
+		for (std::size_t i = 0; i < instructions.size(); i++) {
+			if (i == index) {
+				for (auto& instruction : inlined) {
+					inlinedFunction.instructions().push_back(instruction);
+				}
+			} else {
+				inlinedFunction.instructions().push_back(instructions[i]);
+				auto& instruction = inlinedFunction.instructions().back();
+
+				if (isBranch(instruction) && instruction.intValue > (int)index) {
+					instruction.intValue += (int)growth;
+				}
+			}
+		}
+
+		try {
+			mVerifier.verifyFunction(inlinedFunction);
+		} catch (std::runtime_error&) {
+			//For example, the inlined code accesses private members
+			return false;
+		}
+
+		//Replace the function
+		function.instructions().swap(inlinedFunction.instructions());
+		function.setNumLocals(inlinedFunction.numLocals());
+		for (std::size_t local = firstLocal; local < inlinedFunction.numLocals(); local++) {
+			function.setLocal(local, inlinedFunction.getLocal(local));
+		}
+
+		function.setOperandStackSize(inlinedFunction.operandStackSize());
+
+		for (auto& current : function.inlinedFunctions()) {
+			if (current.start > index) {
+				current.start += growth;
+			}
+
+			if (current.end > index) {
+				current.end += growth;
+			}
+		}
+
+		InlinedFunction inlinedCall;
+		inlinedCall.function = &callee.def();
+		inlinedCall.start = index;
+		inlinedCall.end = index + inlined.size();
+		inlinedCall.firstLocal = firstLocal;
+		function.inlinedFunctions().push_back(inlinedCall);
+		return true;
+	}
+
+	void Inliner::inlineCalls(ManagedFunction& function) {
+		//As the inlined code follows the call site, the calls in the inlined code are also considered
+		for (std::size_t index = 0; index < function.instructions().size(); index++) {
+			if (function.instructions().size() >= MAX_FUNCTION_SIZE) {
+				break;
+			}
+
+			auto callee = getInlineCandidate(function, index);
+			if (callee != nullptr) {
+				tryInline(function, index, *callee);
+			}
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include <string>
+#include "../core/function.h"
+
+namespace stackjit {
+	class VMState;
+	class Verifier;
+
+	//Inlines calls to small managed functions and constructors at the bytecode level.
+	//The arguments and locals of an inlined function become locals of the caller,
+	//which means that the stack frame of the caller describes the inlined code as well.
+	class Inliner {
+	public:
+		//Returns the verified function with the given signature, or null if it can't be inlined
+		using LoadFunction = std::function<const ManagedFunction* (const std::string& signature)>;
+	private:
+		VMState& mVMState;
+		Verifier& mVerifier;
+		LoadFunction mLoadFunction;
+
+		//Returns the function called by the instruction at the given index if it can be inlined, else null
+		const ManagedFunction* getInlineCandidate(const ManagedFunction& function, std::size_t index) const;
+
+		//Tries to inline the given function at the given index. Returns false if the inlined code could not be verified.
+		bool tryInline(ManagedFunction& function, std::size_t index, const ManagedFunction& callee);
+	public:
+		//Creates a new inliner
+		Inliner(VMState& vmState, Verifier& verifier, LoadFunction loadFunction);
+
+		//Inlines the calls in the given function. The function must have been verified.
+		void inlineCalls(ManagedFunction& function);
+	};
+}
@@ -0,0 +1,398 @@
+#include "ir.h"
+#include "../../type/type.h"
+#include "../../core/function.h"
+#include <algorithm>
+#include <functional>
+#include <unordered_set>
+#include <sstream>
+
+namespace stackjit {
+	namespace IR {
+		namespace {
+			std::string toString(OpCode opCode) {
+				switch (opCode) {
+					case OpCode::Constant:
+						return "const";
+					case OpCode::Argument:
+						return "arg";
+					case OpCode::Phi:
+						return "phi";
+					case OpCode::Add:
+						return "add";
+					case OpCode::Sub:
+						return "sub";
+					case OpCode::Mul:
+						return "mul";
+					case OpCode::Div:
+						return "div";
+					case OpCode::And:
+						return "and";
+					case OpCode::Or:
+						return "or";
+					case OpCode::Not:
+						return "not";
+					case OpCode::ConvertIntToFloat:
+						return "convi2f";
+					case OpCode::ConvertFloatToInt:
+						return "convf2i";
+					case OpCode::Compare:
+						return "cmp";
+					case OpCode::Call:
+						return "call";
+					case OpCode::Branch:
+						return "br";
+					case OpCode::ConditionalBranch:
+						return "condbr";
+					case OpCode::Return:
+						return "ret";
+				}
+
+				return "";
+			}
+
+			std::string toString(Condition condition) {
+				switch (condition) {
+					case Condition::Equal:
+						return "eq";
+					case Condition::NotEqual:
+						return "ne";
+					case Condition::GreaterThan:
+						return "gt";
+					case Condition::GreaterThanOrEqual:
+						return "ge";
+					case Condition::LessThan:
+						return "lt";
+					case Condition::LessThanOrEqual:
+						return "le";
+				}
+
+				return "";
+			}
+		}
+
+		Instruction::Instruction(OpCode opCode, const Type* type, int id)
+			: mOpCode(opCode), mType(type), mId(id) {
+
+		}
+
+		OpCode Instruction::opCode() const {
+			return mOpCode;
+		}
+
+		const Type* Instruction::type() const {
+			return mType;
+		}
+
+		int Instruction::id() const {
+			return mId;
+		}
+
+		bool Instruction::hasValue() const {
+			return mType != nullptr;
+		}
+
+		bool Instruction::isFloat() const {
+			return mType != nullptr && TypeSystem::isPrimitiveType(mType, PrimitiveTypes::Float);
+		}
+
+		bool Instruction::isTerminator() const {
+			return mOpCode == OpCode::Branch || mOpCode == OpCode::ConditionalBranch || mOpCode == OpCode::Return;
+		}
+
+		bool Instruction::hasSideEffects() const {
+			switch (mOpCode) {
+				case OpCode::Call:
+				case OpCode::Branch:
+				case OpCode::ConditionalBranch:
+				case OpCode::Return:
+					return true;
+				case OpCode::Div:
+					//Integer division by zero traps
+					return !isFloat();
+				default:
+					return false;
+			}
+		}
+
+		std::string Instruction::toString() const {
+			std::stringstream stream;
+
+			if (hasValue()) {
+				stream << "%" << mId << ":" << mType->name() << " = ";
+			}
+
+			stream << IR::toString(mOpCode);
+
+			if (mOpCode == OpCode::Compare || mOpCode == OpCode::ConditionalBranch) {
+				stream << "." << IR::toString(condition);
+			}
+
+			if (mOpCode == OpCode::Constant) {
+				if (isFloat()) {
+					stream << " " << *reinterpret_cast<const float*>(&intValue);
+				} else {
+					stream << " " << intValue;
+				}
+			} else if (mOpCode == OpCode::Argument) {
+				stream << " " << intValue;
+			} else if (mOpCode == OpCode::Call) {
+				stream << " " << calledFunction->name();
+			}
+
+			for (auto operand : operands) {
+				stream << " %" << operand->id();
+			}
+
+			if (isTerminator()) {
+				for (auto successor : block->successors) {
+					stream << " B" << successor->id();
+				}
+			}
+
+			return stream.str();
+		}
+
+		BasicBlock::BasicBlock(int id, int startIndex)
+			: mId(id), mStartIndex(startIndex) {
+
+		}
+
+		int BasicBlock::id() const {
+			return mId;
+		}
+
+		int BasicBlock::startIndex() const {
+			return mStartIndex;
+		}
+
+		Instruction* BasicBlock::terminator() const {
+			if (instructions.empty() || !instructions.back()->isTerminator()) {
+				return nullptr;
+			}
+
+			return instructions.back();
+		}
+
+		int BasicBlock::predecessorIndex(const BasicBlock* block) const {
+			for (std::size_t i = 0; i < predecessors.size(); i++) {
+				if (predecessors[i] == block) {
+					return (int)i;
+				}
+			}
+
+			return -1;
+		}
+
+		Function::Function(const ManagedFunction& function)
+			: mFunction(function) {
+
+		}
+
+		const ManagedFunction& Function::function() const {
+			return mFunction;
+		}
+
+		BasicBlock* Function::newBlock(int startIndex) {
+			mBlocks.emplace_back(new BasicBlock((int)mBlocks.size(), startIndex));
+			return mBlocks.back().get();
+		}
+
+		Instruction* Function::newInstruction(OpCode opCode, const Type* type, int sourceIndex) {
+			mInstructions.emplace_back(new Instruction(opCode, type, (int)mInstructions.size()));
+			auto instruction = mInstructions.back().get();
+			instruction->sourceIndex = sourceIndex;
+			return instruction;
+		}
+
+		void Function::addEdge(BasicBlock* from, BasicBlock* to) {
+			from->successors.push_back(to);
+			to->predecessors.push_back(from);
+		}
+
+		void Function::removeEdge(BasicBlock* from, BasicBlock* to, int predecessorIndex) {
+			auto& successors = from->successors;
+			auto successor = std::find(successors.begin(), successors.end(), to);
+			if (successor != successors.end()) {
+				successors.erase(successor);
+			}
+
+			to->predecessors.erase(to->predecessors.begin() + predecessorIndex);
+
+			for (auto instruction : to->instructions) {
+				if (instruction->opCode() == OpCode::Phi) {
+					instruction->operands.erase(instruction->operands.begin() + predecessorIndex);
+				}
+			}
+		}
+
+		BasicBlock* Function::entry() const {
+			return mBlocks.front().get();
+		}
+
+		const std::vector<BasicBlock*>& Function::blocks() const {
+			return mReversePostorder;
+		}
+
+		std::size_t Function::numInstructions() const {
+			return mInstructions.size();
+		}
+
+		void Function::computeOrder() {
+			std::vector<BasicBlock*> postorder;
+			std::unordered_set<BasicBlock*> visited;
+
+			std::function<void (BasicBlock*)> visit = [&](BasicBlock* block) {
+				visited.insert(block);
+
+				for (auto successor : block->successors) {
+					if (visited.count(successor) == 0) {
+						visit(successor);
+					}
+				}
+
+				postorder.push_back(block);
+			};
+
+			visit(entry());
+
+			//Remove the edges from unreachable blocks
+			for (auto block : postorder) {
+				for (int i = (int)block->predecessors.size() - 1; i >= 0; i--) {
+					if (visited.count(block->predecessors[i]) == 0) {
+						removeEdge(block->predecessors[i], block, i);
+					}
+				}
+			}
+
+			mReversePostorder.assign(postorder.rbegin(), postorder.rend());
+			for (std::size_t i = 0; i < mReversePostorder.size(); i++) {
+				mReversePostorder[i]->orderIndex = (int)i;
+			}
+		}
+
+		void Function::computeDominators() {
+			//Uses the algorithm by Cooper, Harvey & Kennedy: "A Simple, Fast Dominance Algorithm".
+			auto intersect = [](BasicBlock* first, BasicBlock* second) {
+				while (first != second) {
+					while (first->orderIndex > second->orderIndex) {
+						first = first->immediateDominator;
+					}
+
+					while (second->orderIndex > first->orderIndex) {
+						second = second->immediateDominator;
+					}
+				}
+
+				return first;
+			};
+
+			for (auto block : mReversePostorder) {
+				block->immediateDominator = nullptr;
+				block->dominated.clear();
+				block->dominanceFrontier.clear();
+			}
+
+			auto entryBlock = entry();
+			entryBlock->immediateDominator = entryBlock;
+
+			bool changed = true;
+			while (changed) {
+				changed = false;
+
+				for (auto block : mReversePostorder) {
+					if (block == entryBlock) {
+						continue;
+					}
+
+					BasicBlock* newDominator = nullptr;
+					for (auto predecessor : block->predecessors) {
+						if (predecessor->immediateDominator != nullptr) {
+							newDominator = newDominator == nullptr ? predecessor : intersect(predecessor, newDominator);
+						}
+					}
+
+					if (block->immediateDominator != newDominator) {
+						block->immediateDominator = newDominator;
+						changed = true;
+					}
+				}
+			}
+
+			for (auto block : mReversePostorder) {
+				if (block != entryBlock) {
+					block->immediateDominator->dominated.push_back(block);
+				}
+			}
+
+			//The dominance frontiers
+			for (auto block : mReversePostorder) {
+				if (block->predecessors.size() >= 2) {
+					for (auto predecessor : block->predecessors) {
+						auto runner = predecessor;
+
+						while (runner != block->immediateDominator) {
+							auto& frontier = runner->dominanceFrontier;
+							if (std::find(frontier.begin(), frontier.end(), block) == frontier.end()) {
+								frontier.push_back(block);
+							}
+
+							runner = runner->immediateDominator;
+						}
+					}
+				}
+			}
+
+			entryBlock->immediateDominator = nullptr;
+		}
+
+		bool Function::dominates(const BasicBlock* first, const BasicBlock* second) const {
+			while (second != nullptr) {
+				if (second == first) {
+					return true;
+				}
+
+				second = second->immediateDominator;
+			}
+
+			return false;
+		}
+
+		void Function::replaceUses(Instruction* value, Instruction* replacement) {
+			for (auto block : mReversePostorder) {
+				for (auto instruction : block->instructions) {
+					for (auto& operand : instruction->operands) {
+						if (operand == value) {
+							operand = replacement;
+						}
+					}
+				}
+
+				for (auto& variableValue : block->variableValues) {
+					if (variableValue == value) {
+						variableValue = replacement;
+					}
+				}
+			}
+		}
+
+		std::string Function::toString() const {
+			std::stringstream stream;
+
+			for (auto block : mReversePostorder) {
+				stream << "B" << block->id() << ":";
+
+				if (block->immediateDominator != nullptr) {
+					stream << " ; idom: B" << block->immediateDominator->id();
+				}
+
+				stream << std::endl;
+
+				for (auto instruction : block->instructions) {
+					stream << "\t" << instruction->toString() << std::endl;
+				}
+			}
+
+			return stream.str();
+		}
+	}
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <string>
+
+namespace stackjit {
+	class Type;
+	class FunctionDefinition;
+	class ManagedFunction;
+
+	//The SSA based intermediate representation used by the optimizing JIT tier
+	namespace IR {
+		class BasicBlock;
+
+		//The operations in the IR
+		enum class OpCode : unsigned char {
+			Constant,
+			Argument,
+			Phi,
+			Add,
+			Sub,
+			Mul,
+			Div,
+			And,
+			Or,
+			Not,
+			ConvertIntToFloat,
+			ConvertFloatToInt,
+			Compare,
+			Call,
+			Branch,
+			ConditionalBranch,
+			Return
+		};
+
+		//The conditions for comparisons
+		enum class Condition : unsigned char {
+			Equal,
+			NotEqual,
+			GreaterThan,
+			GreaterThanOrEqual,
+			LessThan,
+			LessThanOrEqual
+		};
+
+		//Represents an instruction in the IR. An instruction with a type defines a SSA value.
+		class Instruction {
+		private:
+			const OpCode mOpCode;
+			const Type* mType;
+			const int mId;
+		public:
+			//The operands. For phi instructions, the operands are in the same order as the predecessors of the block.
+			std::vector<Instruction*> operands;
+
+			//The block that the instruction belongs to
+			BasicBlock* block = nullptr;
+
+			//The index of the bytecode instruction that the instruction was created from
+			int sourceIndex = -1;
+
+			//The value of a constant (the bit pattern for floats), or the index of an argument
+			int intValue = 0;
+
+			//The condition for compare and conditional branch instructions
+			Condition condition = Condition::Equal;
+
+			//The function called by a call instruction
+			const FunctionDefinition* calledFunction = nullptr;
+
+			//Creates a new instruction. If the type is null, the instruction defines no value.
+			Instruction(OpCode opCode, const Type* type, int id);
+
+			//Returns the op code
+			OpCode opCode() const;
+
+			//Returns the type of the value, or null if the instruction defines no value
+			const Type* type() const;
+
+			//Returns the unique id of the instruction
+			int id() const;
+
+			//Indicates if the instruction defines a value
+			bool hasValue() const;
+
+			//Indicates if the value is a float
+			bool isFloat() const;
+
+			//Indicates if the instruction ends a block
+			bool isTerminator() const;
+
+			//Indicates if the instruction has side effects, which means that it can't be removed even if not used
+			bool hasSideEffects() const;
+
+			//Returns a string representation of the instruction
+			std::string toString() const;
+		};
+
+		//Represents a basic block
+		class BasicBlock {
+		private:
+			const int mId;
+			const int mStartIndex;
+		public:
+			//The instructions of the block. The phi instructions are first and the terminator last.
+			std::vector<Instruction*> instructions;
+
+			//The edges of the control flow graph. For conditional branches, the branch target is the first successor.
+			std::vector<BasicBlock*> predecessors;
+			std::vector<BasicBlock*> successors;
+
+			//The dominator tree
+			BasicBlock* immediateDominator = nullptr;
+			std::vector<BasicBlock*> dominated;
+
+			//The blocks in the dominance frontier
+			std::vector<BasicBlock*> dominanceFrontier;
+
+			//The index of the block in the reverse postorder
+			int orderIndex = -1;
+
+			//The values of the arguments, locals and operand stack entries (in that order) at the start of the block.
+			//Only set for loop headers, which can be entered from the baseline code by on-stack replacement.
+			std::vector<Instruction*> variableValues;
+
+			//Creates a new block starting at the given bytecode instruction
+			BasicBlock(int id, int startIndex);
+
+			//Returns the id of the block
+			int id() const;
+
+			//Returns the index of the first bytecode instruction in the block, -1 for the entry block
+			int startIndex() const;
+
+			//Returns the terminator of the block
+			Instruction* terminator() const;
+
+			//Returns the index of the given block in the list of predecessors
+			int predecessorIndex(const BasicBlock* block) const;
+		};
+
+		//Represents a function in the IR
+		class Function {
+		private:
+			const ManagedFunction& mFunction;
+			std::vector<std::unique_ptr<BasicBlock>> mBlocks;
+			std::vector<std::unique_ptr<Instruction>> mInstructions;
+			std::vector<BasicBlock*> mReversePostorder;
+		public:
+			//Creates a new IR function for the given function
+			explicit Function(const ManagedFunction& function);
+
+			//Prevent it from being copied
+			Function(const Function&) = delete;
+			Function& operator=(const Function&) = delete;
+
+			//Returns the function that the IR was created from
+			const ManagedFunction& function() const;
+
+			//Creates a new block
+			BasicBlock* newBlock(int startIndex);
+
+			//Creates a new instruction. The instruction is not added to any block.
+			Instruction* newInstruction(OpCode opCode, const Type* type, int sourceIndex);
+
+			//Adds an edge between the given blocks
+			void addEdge(BasicBlock* from, BasicBlock* to);
+
+			//Removes the edge between the given blocks, where the index is the index of the edge in the predecessors.
+			//The operands of the phi instructions for the edge are removed.
+			void removeEdge(BasicBlock* from, BasicBlock* to, int predecessorIndex);
+
+			//Returns the entry block
+			BasicBlock* entry() const;
+
+			//Returns the blocks reachable from the entry in reverse postorder
+			const std::vector<BasicBlock*>& blocks() const;
+
+			//The number of instructions that has been created. Ids are less than this number.
+			std::size_t numInstructions() const;
+
+			//Removes the blocks that are not reachable from the entry and orders the remaining in reverse postorder
+			void computeOrder();
+
+			//Computes the dominator tree and the dominance frontiers
+			void computeDominators();
+
+			//Indicates if the first block dominates the second
+			bool dominates(const BasicBlock* first, const BasicBlock* second) const;
+
+			//Replaces all uses of the given value
+			void replaceUses(Instruction* value, Instruction* replacement);
+
+			//Returns a string representation of the function
+			std::string toString() const;
+		};
+	}
+}
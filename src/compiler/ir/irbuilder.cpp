@@ -0,0 +1,563 @@
+#include "irbuilder.h"
+#include "../../vmstate.h"
+#include "../../type/type.h"
+#include "../../core/function.h"
+#include "../../core/functionsignature.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+
+namespace stackjit {
+	namespace {
+		//Indicates if values of the given type can be represented in the IR
+		bool isValueType(const Type* type) {
+			return TypeSystem::isPrimitiveType(type, PrimitiveTypes::Integer)
+				   || TypeSystem::isPrimitiveType(type, PrimitiveTypes::Float)
+				   || TypeSystem::isPrimitiveType(type, PrimitiveTypes::Bool)
+				   || TypeSystem::isPrimitiveType(type, PrimitiveTypes::Char);
+		}
+
+		//Indicates if the given function can be called from the IR
+		bool isValueFunction(const FunctionDefinition& function) {
+			if (!isValueType(function.returnType())
+				&& !TypeSystem::isPrimitiveType(function.returnType(), PrimitiveTypes::Void)) {
+				return false;
+			}
+
+			for (auto parameter : function.parameters()) {
+				if (!isValueType(parameter)) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		//Returns the function called by the given instruction
+		const FunctionDefinition& getCalledFunction(const VMState& vmState, const Instruction& instruction) {
+			auto calledSignature = FunctionSignature::function(instruction.stringValue, instruction.parameters).str();
+			return vmState.binder().getFunction(calledSignature);
+		}
+
+		//Indicates if the given instruction is a branch
+		bool isBranch(const Instruction& instruction) {
+			switch (instruction.opCode()) {
+				case OpCodes::BRANCH:
+				case OpCodes::BRANCH_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		//Returns the condition for the given compare or branch instruction
+		IR::Condition getCondition(OpCodes opCode) {
+			switch (opCode) {
+				case OpCodes::COMPARE_NOT_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+					return IR::Condition::NotEqual;
+				case OpCodes::COMPARE_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN:
+					return IR::Condition::GreaterThan;
+				case OpCodes::COMPARE_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+					return IR::Condition::GreaterThanOrEqual;
+				case OpCodes::COMPARE_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN:
+					return IR::Condition::LessThan;
+				case OpCodes::COMPARE_LESS_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					return IR::Condition::LessThanOrEqual;
+				default:
+					return IR::Condition::Equal;
+			}
+		}
+
+		//Returns the IR op code for the given binary operator
+		IR::OpCode getBinaryOpCode(OpCodes opCode) {
+			switch (opCode) {
+				case OpCodes::ADD:
+					return IR::OpCode::Add;
+				case OpCodes::SUB:
+					return IR::OpCode::Sub;
+				case OpCodes::MUL:
+					return IR::OpCode::Mul;
+				case OpCodes::DIV:
+					return IR::OpCode::Div;
+				case OpCodes::AND:
+					return IR::OpCode::And;
+				default:
+					return IR::OpCode::Or;
+			}
+		}
+	}
+
+	IRBuilder::IRBuilder(const VMState& vmState)
+		: mVMState(vmState) {
+
+	}
+
+	bool IRBuilder::canBuild(const ManagedFunction& function) const {
+		if (!isValueFunction(function.def())) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < function.numLocals(); i++) {
+			if (!isValueType(function.getLocal(i))) {
+				return false;
+			}
+		}
+
+		for (auto& instruction : function.instructions()) {
+			switch (instruction.opCode()) {
+				case OpCodes::NOP:
+				case OpCodes::LOAD_INT:
+				case OpCodes::LOAD_FLOAT:
+				case OpCodes::LOAD_CHAR:
+				case OpCodes::POP:
+				case OpCodes::DUPLICATE:
+				case OpCodes::ADD:
+				case OpCodes::SUB:
+				case OpCodes::MUL:
+				case OpCodes::DIV:
+				case OpCodes::LOAD_TRUE:
+				case OpCodes::LOAD_FALSE:
+				case OpCodes::AND:
+				case OpCodes::OR:
+				case OpCodes::NOT:
+				case OpCodes::CONVERT_INT_TO_FLOAT:
+				case OpCodes::CONVERT_FLOAT_TO_INT:
+				case OpCodes::COMPARE_EQUAL:
+				case OpCodes::COMPARE_NOT_EQUAL:
+				case OpCodes::COMPARE_GREATER_THAN:
+				case OpCodes::COMPARE_GREATER_THAN_OR_EQUAL:
+				case OpCodes::COMPARE_LESS_THAN:
+				case OpCodes::COMPARE_LESS_THAN_OR_EQUAL:
+				case OpCodes::LOAD_LOCAL:
+				case OpCodes::STORE_LOCAL:
+				case OpCodes::RET:
+				case OpCodes::LOAD_ARG:
+				case OpCodes::BRANCH:
+				case OpCodes::BRANCH_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					break;
+				case OpCodes::CALL:
+					if (!isValueFunction(getCalledFunction(mVMState, instruction))) {
+						return false;
+					}
+					break;
+				default:
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	std::unique_ptr<IR::Function> IRBuilder::build(const ManagedFunction& function) const {
+		std::unique_ptr<IR::Function> irFunction(new IR::Function(function));
+		auto& instructions = function.instructions();
+		int numInstructions = (int)instructions.size();
+
+		auto numArgs = (int)function.def().numParameters();
+		auto numLocals = (int)function.numLocals();
+		auto numVariables = numArgs + numLocals + (int)function.operandStackSize();
+
+		auto localVariable = [&](int index) { return numArgs + index; };
+		auto stackVariable = [&](int index) { return numArgs + numLocals + index; };
+
+		//The entry block defines the arguments and locals
+		auto entryBlock = irFunction->newBlock(-1);
+
+		//Find the leaders of the blocks
+		std::vector<bool> isLeader((std::size_t)numInstructions, false);
+		std::vector<bool> isLoopHeader((std::size_t)numInstructions, false);
+		isLeader[0] = true;
+
+		for (int i = 0; i < numInstructions; i++) {
+			auto& instruction = instructions[i];
+			if (isBranch(instruction) || instruction.opCode() == OpCodes::RET) {
+				if (isBranch(instruction)) {
+					isLeader[instruction.intValue] = true;
+
+					if (instruction.intValue <= i) {
+						isLoopHeader[instruction.intValue] = true;
+					}
+				}
+
+				if (i + 1 < numInstructions) {
+					isLeader[i + 1] = true;
+				}
+			}
+		}
+
+		std::vector<IR::BasicBlock*> blockStartingAt((std::size_t)numInstructions, nullptr);
+		std::vector<IR::BasicBlock*> createdBlocks;
+
+		for (int i = 0; i < numInstructions; i++) {
+			if (isLeader[i]) {
+				blockStartingAt[i] = irFunction->newBlock(i);
+				createdBlocks.push_back(blockStartingAt[i]);
+			}
+		}
+
+		//The index of the last instruction in the given block
+		auto blockEnd = [&](IR::BasicBlock* block) {
+			auto end = block->startIndex() + 1;
+			while (end < numInstructions && !isLeader[end]) {
+				end++;
+			}
+
+			return end - 1;
+		};
+
+		//Create the control flow graph
+		irFunction->addEdge(entryBlock, blockStartingAt[0]);
+
+		for (auto block : createdBlocks) {
+			auto end = blockEnd(block);
+			auto& lastInstruction = instructions[end];
+			auto next = end + 1;
+
+			if (isBranch(lastInstruction)) {
+				irFunction->addEdge(block, blockStartingAt[lastInstruction.intValue]);
+			}
+
+			if (lastInstruction.opCode() != OpCodes::BRANCH && lastInstruction.opCode() != OpCodes::RET) {
+				irFunction->addEdge(block, blockStartingAt[next]);
+			}
+		}
+
+		irFunction->computeOrder();
+		irFunction->computeDominators();
+
+		//The number of operands on the stack at the start and end of the blocks
+		auto entryDepth = [&](IR::BasicBlock* block) {
+			return block == entryBlock ? 0 : (int)instructions[block->startIndex()].operandTypes().size();
+		};
+
+		auto exitDepth = [&](IR::BasicBlock* block) {
+			if (block == entryBlock) {
+				return 0;
+			}
+
+			auto end = blockEnd(block);
+			auto& lastInstruction = instructions[end];
+			if (lastInstruction.opCode() == OpCodes::RET) {
+				return 0;
+			} else if (isBranch(lastInstruction)) {
+				return (int)lastInstruction.operandTypes().size() - (lastInstruction.opCode() == OpCodes::BRANCH ? 0 : 2);
+			} else {
+				return (int)instructions[end + 1].operandTypes().size();
+			}
+		};
+
+		//Find the blocks where each variable is defined
+		std::vector<std::vector<IR::BasicBlock*>> definitions((std::size_t)numVariables);
+		for (int i = 0; i < numArgs + numLocals; i++) {
+			definitions[i].push_back(entryBlock);
+		}
+
+		for (auto block : irFunction->blocks()) {
+			if (block == entryBlock) {
+				continue;
+			}
+
+			for (int i = block->startIndex(); i <= blockEnd(block); i++) {
+				if (instructions[i].opCode() == OpCodes::STORE_LOCAL) {
+					definitions[localVariable(instructions[i].intValue)].push_back(block);
+				}
+			}
+
+			for (int i = 0; i < exitDepth(block); i++) {
+				definitions[stackVariable(i)].push_back(block);
+			}
+		}
+
+		//Place phi functions at the iterated dominance frontiers
+		std::unordered_map<IR::Instruction*, int> phiVariables;
+
+		for (int variable = numArgs; variable < numVariables; variable++) {
+			std::unordered_set<IR::BasicBlock*> hasPhi;
+			std::unordered_set<IR::BasicBlock*> hasDefinition(definitions[variable].begin(), definitions[variable].end());
+			auto worklist = definitions[variable];
+
+			while (!worklist.empty()) {
+				auto block = worklist.back();
+				worklist.pop_back();
+
+				for (auto frontierBlock : block->dominanceFrontier) {
+					if (hasPhi.count(frontierBlock) > 0) {
+						continue;
+					}
+
+					//The type of the variable at the start of the block
+					const Type* type = nullptr;
+					if (variable < stackVariable(0)) {
+						type = function.getLocal((std::size_t)(variable - numArgs));
+					} else {
+						auto& operandTypes = instructions[frontierBlock->startIndex()].operandTypes();
+						auto stackIndex = variable - stackVariable(0);
+
+						//The operand is not on the stack at the start of the block
+						if (stackIndex >= (int)operandTypes.size()) {
+							continue;
+						}
+
+						type = operandTypes[operandTypes.size() - 1 - stackIndex];
+					}
+
+					auto phi = irFunction->newInstruction(IR::OpCode::Phi, type, frontierBlock->startIndex());
+					phi->block = frontierBlock;
+					phi->operands.resize(frontierBlock->predecessors.size(), nullptr);
+					frontierBlock->instructions.push_back(phi);
+					phiVariables[phi] = variable;
+					hasPhi.insert(frontierBlock);
+
+					if (hasDefinition.count(frontierBlock) == 0) {
+						hasDefinition.insert(frontierBlock);
+						worklist.push_back(frontierBlock);
+					}
+				}
+			}
+		}
+
+		//Rename the variables by walking the dominator tree
+		std::vector<std::vector<IR::Instruction*>> currentDefinitions((std::size_t)numVariables);
+
+		std::function<void (IR::BasicBlock*)> rename = [&](IR::BasicBlock* block) {
+			std::vector<int> definedVariables;
+
+			auto define = [&](int variable, IR::Instruction* value) {
+				currentDefinitions[variable].push_back(value);
+				definedVariables.push_back(variable);
+			};
+
+			auto emit = [&](IR::OpCode opCode, const Type* type, int sourceIndex) {
+				auto instruction = irFunction->newInstruction(opCode, type, sourceIndex);
+				instruction->block = block;
+				block->instructions.push_back(instruction);
+				return instruction;
+			};
+
+			for (auto instruction : block->instructions) {
+				define(phiVariables[instruction], instruction);
+			}
+
+			if (block != entryBlock && isLoopHeader[block->startIndex()]) {
+				for (int i = 0; i < stackVariable(entryDepth(block)); i++) {
+					block->variableValues.push_back(currentDefinitions[i].empty() ? nullptr : currentDefinitions[i].back());
+				}
+			}
+
+			if (block == entryBlock) {
+				for (int i = 0; i < numArgs; i++) {
+					auto argument = emit(IR::OpCode::Argument, function.def().parameters()[i], -1);
+					argument->intValue = i;
+					define(i, argument);
+				}
+
+				for (int i = 0; i < numLocals; i++) {
+					define(localVariable(i), emit(IR::OpCode::Constant, function.getLocal((std::size_t)i), -1));
+				}
+
+				emit(IR::OpCode::Branch, nullptr, -1);
+			} else {
+				std::vector<IR::Instruction*> operandStack;
+				for (int i = 0; i < entryDepth(block); i++) {
+					operandStack.push_back(currentDefinitions[stackVariable(i)].back());
+				}
+
+				auto pop = [&]() {
+					auto value = operandStack.back();
+					operandStack.pop_back();
+					return value;
+				};
+
+				for (int i = block->startIndex(); i <= blockEnd(block); i++) {
+					auto& instruction = instructions[i];
+
+					//The type of the value pushed by the instruction
+					auto pushedType = [&]() {
+						return instructions[i + 1].operandTypes()[0];
+					};
+
+					switch (instruction.opCode()) {
+						case OpCodes::NOP:
+							break;
+						case OpCodes::POP:
+							pop();
+							break;
+						case OpCodes::DUPLICATE:
+							operandStack.push_back(operandStack.back());
+							break;
+						case OpCodes::LOAD_INT:
+						case OpCodes::LOAD_FLOAT:
+						case OpCodes::LOAD_CHAR:
+						case OpCodes::LOAD_TRUE:
+						case OpCodes::LOAD_FALSE: {
+							auto constant = emit(IR::OpCode::Constant, pushedType(), i);
+							switch (instruction.opCode()) {
+								case OpCodes::LOAD_INT:
+									constant->intValue = instruction.intValue;
+									break;
+								case OpCodes::LOAD_FLOAT:
+									constant->intValue = *reinterpret_cast<const int*>(&instruction.floatValue);
+									break;
+								case OpCodes::LOAD_CHAR:
+									constant->intValue = instruction.charValue;
+									break;
+								case OpCodes::LOAD_TRUE:
+									constant->intValue = 1;
+									break;
+								default:
+									constant->intValue = 0;
+									break;
+							}
+
+							operandStack.push_back(constant);
+							break;
+						}
+						case OpCodes::ADD:
+						case OpCodes::SUB:
+						case OpCodes::MUL:
+						case OpCodes::DIV:
+						case OpCodes::AND:
+						case OpCodes::OR: {
+							auto right = pop();
+							auto left = pop();
+							auto value = emit(getBinaryOpCode(instruction.opCode()), pushedType(), i);
+							value->operands = { left, right };
+							operandStack.push_back(value);
+							break;
+						}
+						case OpCodes::NOT:
+						case OpCodes::CONVERT_INT_TO_FLOAT:
+						case OpCodes::CONVERT_FLOAT_TO_INT: {
+							auto opCode = IR::OpCode::Not;
+							if (instruction.opCode() == OpCodes::CONVERT_INT_TO_FLOAT) {
+								opCode = IR::OpCode::ConvertIntToFloat;
+							} else if (instruction.opCode() == OpCodes::CONVERT_FLOAT_TO_INT) {
+								opCode = IR::OpCode::ConvertFloatToInt;
+							}
+
+							auto operand = pop();
+							auto value = emit(opCode, pushedType(), i);
+							value->operands = { operand };
+							operandStack.push_back(value);
+							break;
+						}
+						case OpCodes::COMPARE_EQUAL:
+						case OpCodes::COMPARE_NOT_EQUAL:
+						case OpCodes::COMPARE_GREATER_THAN:
+						case OpCodes::COMPARE_GREATER_THAN_OR_EQUAL:
+						case OpCodes::COMPARE_LESS_THAN:
+						case OpCodes::COMPARE_LESS_THAN_OR_EQUAL: {
+							auto right = pop();
+							auto left = pop();
+							auto value = emit(IR::OpCode::Compare, pushedType(), i);
+							value->condition = getCondition(instruction.opCode());
+							value->operands = { left, right };
+							operandStack.push_back(value);
+							break;
+						}
+						case OpCodes::LOAD_LOCAL:
+							operandStack.push_back(currentDefinitions[localVariable(instruction.intValue)].back());
+							break;
+						case OpCodes::STORE_LOCAL:
+							define(localVariable(instruction.intValue), pop());
+							break;
+						case OpCodes::LOAD_ARG:
+							operandStack.push_back(currentDefinitions[instruction.intValue].back());
+							break;
+						case OpCodes::CALL: {
+							auto& calledFunction = getCalledFunction(mVMState, instruction);
+							auto numParameters = calledFunction.numParameters();
+							auto returnType = calledFunction.returnType();
+							bool hasReturnValue = !TypeSystem::isPrimitiveType(returnType, PrimitiveTypes::Void);
+
+							auto call = emit(IR::OpCode::Call, hasReturnValue ? returnType : nullptr, i);
+							call->calledFunction = &calledFunction;
+							call->operands.assign(operandStack.end() - numParameters, operandStack.end());
+							operandStack.resize(operandStack.size() - numParameters);
+
+							if (hasReturnValue) {
+								operandStack.push_back(call);
+							}
+							break;
+						}
+						case OpCodes::RET: {
+							auto ret = emit(IR::OpCode::Return, nullptr, i);
+							if (!TypeSystem::isPrimitiveType(function.def().returnType(), PrimitiveTypes::Void)) {
+								ret->operands = { pop() };
+							}
+							break;
+						}
+						case OpCodes::BRANCH:
+							emit(IR::OpCode::Branch, nullptr, i);
+							break;
+						case OpCodes::BRANCH_EQUAL:
+						case OpCodes::BRANCH_NOT_EQUAL:
+						case OpCodes::BRANCH_GREATER_THAN:
+						case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+						case OpCodes::BRANCH_LESS_THAN:
+						case OpCodes::BRANCH_LESS_THAN_OR_EQUAL: {
+							auto right = pop();
+							auto left = pop();
+							auto branch = emit(IR::OpCode::ConditionalBranch, nullptr, i);
+							branch->condition = getCondition(instruction.opCode());
+							branch->operands = { left, right };
+							break;
+						}
+						default:
+							throw std::runtime_error("The instruction is not supported by the IR.");
+					}
+				}
+
+				//Fall through to the next block
+				if (block->terminator() == nullptr) {
+					emit(IR::OpCode::Branch, nullptr, blockEnd(block));
+				}
+
+				for (std::size_t i = 0; i < operandStack.size(); i++) {
+					define(stackVariable((int)i), operandStack[i]);
+				}
+			}
+
+			//Set the operands of the phi functions in the successors
+			for (auto successor : block->successors) {
+				for (std::size_t i = 0; i < successor->predecessors.size(); i++) {
+					if (successor->predecessors[i] != block) {
+						continue;
+					}
+
+					for (auto instruction : successor->instructions) {
+						if (instruction->opCode() == IR::OpCode::Phi) {
+							instruction->operands[i] = currentDefinitions[phiVariables[instruction]].back();
+						}
+					}
+				}
+			}
+
+			for (auto dominated : block->dominated) {
+				rename(dominated);
+			}
+
+			for (auto variable : definedVariables) {
+				currentDefinitions[variable].pop_back();
+			}
+		};
+
+		rename(entryBlock);
+		return irFunction;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "ir.h"
+#include <memory>
+
+namespace stackjit {
+	class VMState;
+	class ManagedFunction;
+
+	//Builds the IR in SSA form from verified bytecode
+	class IRBuilder {
+	private:
+		const VMState& mVMState;
+	public:
+		//Creates a new IR builder
+		explicit IRBuilder(const VMState& vmState);
+
+		//Indicates if the given function can be represented in the IR.
+		//Only functions that operate on primitive values are supported.
+		bool canBuild(const ManagedFunction& function) const;
+
+		//Builds the IR for the given function. The arguments, locals and operand stack entries are renamed into SSA values.
+		std::unique_ptr<IR::Function> build(const ManagedFunction& function) const;
+	};
+}
@@ -0,0 +1,265 @@
+#include "iroptimizer.h"
+#include "../../type/type.h"
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <climits>
+
+namespace stackjit {
+	namespace {
+		float toFloat(int value) {
+			float floatValue;
+			std::memcpy(&floatValue, &value, sizeof(float));
+			return floatValue;
+		}
+
+		int fromFloat(float value) {
+			int intValue;
+			std::memcpy(&intValue, &value, sizeof(int));
+			return intValue;
+		}
+
+		template <typename T>
+		bool compare(IR::Condition condition, T left, T right) {
+			switch (condition) {
+				case IR::Condition::Equal:
+					return left == right;
+				case IR::Condition::NotEqual:
+					return left != right;
+				case IR::Condition::GreaterThan:
+					return left > right;
+				case IR::Condition::GreaterThanOrEqual:
+					return left >= right;
+				case IR::Condition::LessThan:
+					return left < right;
+				case IR::Condition::LessThanOrEqual:
+					return left <= right;
+			}
+
+			return false;
+		}
+
+		//Tries to evaluate the given instruction at compile time. All operands must be constants.
+		bool tryEvaluate(const IR::Instruction* instruction, int& result) {
+			for (auto operand : instruction->operands) {
+				if (operand->opCode() != IR::OpCode::Constant) {
+					return false;
+				}
+			}
+
+			auto& operands = instruction->operands;
+
+			switch (instruction->opCode()) {
+				case IR::OpCode::Add:
+				case IR::OpCode::Sub:
+				case IR::OpCode::Mul:
+				case IR::OpCode::Div: {
+					auto opCode = instruction->opCode();
+
+					if (instruction->isFloat()) {
+						auto left = toFloat(operands[0]->intValue);
+						auto right = toFloat(operands[1]->intValue);
+						float value = 0;
+
+						if (opCode == IR::OpCode::Add) {
+							value = left + right;
+						} else if (opCode == IR::OpCode::Sub) {
+							value = left - right;
+						} else if (opCode == IR::OpCode::Mul) {
+							value = left * right;
+						} else {
+							value = left / right;
+						}
+
+						result = fromFloat(value);
+						return true;
+					}
+
+					//Integer arithmetic wraps around
+					auto left = (unsigned int)operands[0]->intValue;
+					auto right = (unsigned int)operands[1]->intValue;
+
+					if (opCode == IR::OpCode::Add) {
+						result = (int)(left + right);
+					} else if (opCode == IR::OpCode::Sub) {
+						result = (int)(left - right);
+					} else if (opCode == IR::OpCode::Mul) {
+						result = (int)(left * right);
+					} else {
+						//Leave the traps to runtime
+						if (right == 0 || (operands[0]->intValue == INT_MIN && operands[1]->intValue == -1)) {
+							return false;
+						}
+
+						result = operands[0]->intValue / operands[1]->intValue;
+					}
+
+					return true;
+				}
+				case IR::OpCode::And:
+					result = operands[0]->intValue & operands[1]->intValue;
+					return true;
+				case IR::OpCode::Or:
+					result = operands[0]->intValue | operands[1]->intValue;
+					return true;
+				case IR::OpCode::Not:
+					result = ~operands[0]->intValue & 1;
+					return true;
+				case IR::OpCode::ConvertIntToFloat:
+					result = fromFloat((float)operands[0]->intValue);
+					return true;
+				case IR::OpCode::Compare:
+				case IR::OpCode::ConditionalBranch: {
+					if (operands[0]->isFloat()) {
+						auto left = toFloat(operands[0]->intValue);
+						auto right = toFloat(operands[1]->intValue);
+
+						//Unordered comparisons are left to runtime
+						if (std::isnan(left) || std::isnan(right)) {
+							return false;
+						}
+
+						result = compare(instruction->condition, left, right) ? 1 : 0;
+					} else {
+						result = compare(instruction->condition, operands[0]->intValue, operands[1]->intValue) ? 1 : 0;
+					}
+
+					return true;
+				}
+				default:
+					return false;
+			}
+		}
+
+		//Removes phi functions where all operands are the same value
+		bool removeTrivialPhis(IR::Function& function) {
+			bool changed = false;
+
+			for (auto block : function.blocks()) {
+				auto& instructions = block->instructions;
+
+				for (std::size_t i = 0; i < instructions.size(); i++) {
+					auto phi = instructions[i];
+					if (phi->opCode() != IR::OpCode::Phi) {
+						continue;
+					}
+
+					IR::Instruction* same = nullptr;
+					bool isTrivial = true;
+
+					for (auto operand : phi->operands) {
+						if (operand == phi || operand == same) {
+							continue;
+						}
+
+						if (same != nullptr) {
+							isTrivial = false;
+							break;
+						}
+
+						same = operand;
+					}
+
+					if (isTrivial && same != nullptr) {
+						function.replaceUses(phi, same);
+						instructions.erase(instructions.begin() + i);
+						i--;
+						changed = true;
+					}
+				}
+			}
+
+			return changed;
+		}
+
+		//Replaces instructions with constant operands by their values
+		bool foldConstants(IR::Function& function) {
+			bool changed = false;
+			bool changedControlFlow = false;
+
+			for (auto block : function.blocks()) {
+				auto& instructions = block->instructions;
+
+				for (std::size_t i = 0; i < instructions.size(); i++) {
+					auto instruction = instructions[i];
+					int value = 0;
+
+					if (!tryEvaluate(instruction, value)) {
+						continue;
+					}
+
+					if (instruction->opCode() == IR::OpCode::ConditionalBranch) {
+						//Only one of the successors can be reached
+						auto notTaken = block->successors[value == 1 ? 1 : 0];
+						auto branch = function.newInstruction(IR::OpCode::Branch, nullptr, instruction->sourceIndex);
+						branch->block = block;
+						instructions[i] = branch;
+						function.removeEdge(block, notTaken, notTaken->predecessorIndex(block));
+						changedControlFlow = true;
+					} else {
+						auto constant = function.newInstruction(IR::OpCode::Constant, instruction->type(), instruction->sourceIndex);
+						constant->block = block;
+						constant->intValue = value;
+						instructions[i] = constant;
+						function.replaceUses(instruction, constant);
+					}
+
+					changed = true;
+				}
+			}
+
+			if (changedControlFlow) {
+				function.computeOrder();
+				function.computeDominators();
+			}
+
+			return changed;
+		}
+
+		//Removes the instructions whose values are never used
+		void removeDeadCode(IR::Function& function) {
+			std::vector<bool> isLive(function.numInstructions(), false);
+			std::vector<IR::Instruction*> worklist;
+
+			for (auto block : function.blocks()) {
+				for (auto instruction : block->instructions) {
+					if (instruction->hasSideEffects()) {
+						isLive[instruction->id()] = true;
+						worklist.push_back(instruction);
+					}
+				}
+			}
+
+			while (!worklist.empty()) {
+				auto instruction = worklist.back();
+				worklist.pop_back();
+
+				for (auto operand : instruction->operands) {
+					if (!isLive[operand->id()]) {
+						isLive[operand->id()] = true;
+						worklist.push_back(operand);
+					}
+				}
+			}
+
+			for (auto block : function.blocks()) {
+				auto& instructions = block->instructions;
+				instructions.erase(
+					std::remove_if(instructions.begin(), instructions.end(), [&](IR::Instruction* instruction) {
+						return !isLive[instruction->id()];
+					}),
+					instructions.end());
+			}
+		}
+	}
+
+	void IROptimizer::optimize(IR::Function& function) const {
+		bool changed = true;
+		while (changed) {
+			changed = removeTrivialPhis(function);
+			changed = foldConstants(function) || changed;
+		}
+
+		removeDeadCode(function);
+	}
+}
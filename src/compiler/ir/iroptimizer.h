@@ -0,0 +1,11 @@
+#pragma once
+#include "ir.h"
+
+namespace stackjit {
+	//Applies optimizations to functions in the IR
+	class IROptimizer {
+	public:
+		//Optimizes the given function. The function must be in SSA form.
+		void optimize(IR::Function& function) const;
+	};
+}
@@ -1,20 +1,26 @@
 #include "jit.h"
 #include "memory.h"
 #include "binder.h"
+#include "registerallocator.h"
 #include "x64/codegenerator.h"
+#include "ir/irbuilder.h"
+#include "ir/iroptimizer.h"
 #include "../vmstate.h"
 #include "../helpers.h"
 #include "../type/type.h"
+#include "../type/classmetadata.h"
 #include "../core/function.h"
 #include "../core/functionsignature.h"
 #include <string.h>
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
 
 namespace stackjit {
 	JITCompiler::JITCompiler(VMState& vmState)
-		: mVMState(vmState), mCodeGenerator(mCallingConvention, mExceptionHandling) {
+		: mVMState(vmState), mCodeGenerator(mCallingConvention, mExceptionHandling),
+		  mIRLowering(mCallingConvention, mCodeGenerator) {
 		mExceptionHandling.generateHandlers(mMemoryManager, mCallingConvention);
 		createMacros();
 	}
@@ -57,18 +63,21 @@ namespace stackjit {
 		mFunctions.emplace(signature, *function);
 		auto& functionData = mFunctions.at(signature);
 
-		//Initialize the function
-		mCodeGenerator.generateInitializeFunction(functionData);
-
-		//Generate the native instructions for the program
-		int i = 0;
-		for (auto& current : function->instructions()) {
-			mCodeGenerator.generateInstruction(mVMState, functionData, current, i);
-			i++;
+		if (useOptimizingTier(*function)) {
+			compileOptimized(functionData);
+		} else {
+			functionData.countForTierUp = canTierUp(*function);
+			compileBaseline(functionData);
 		}
 
-		//Patch branches with the native targets
-		resolveBranches(functionData);
+		//The stack maps replaces the operand types once the function has been compiled. They are kept if the function
+		//can be recompiled, or if the types of the values in the stack frames are printed.
+		bool printsStackFrames = mVMState.config.enableDebug
+			&& (mVMState.config.printStackFrame || mVMState.config.printGCStackTrace);
+
+		if (!functionData.countForTierUp && !printsStackFrames) {
+			function->clearOperandTypes();
+		}
 
 		//Get a pointer & size of the generated instructions
 		auto codePtr = function->generatedCode().data();
@@ -98,10 +107,240 @@ namespace stackjit {
 		//Copy the instructions
 		std::memcpy(memory, codePtr, size);
 
+		//The stack walker finds the callers using the return addresses
+		auto& callStack = mVMState.engine().callStack();
+		for (auto& callSite : functionData.callSites) {
+			callStack.addCallSite((BytePtr)memory + callSite.returnOffset, function, callSite.instructionIndex);
+		}
+
 		//Return the generated instructions as a function pointer
 		return (JitFunction)memory;
 	}
 
+	bool JITCompiler::useOptimizingTier(const ManagedFunction& function) const {
+		auto tier = function.jitTier();
+		if (tier == JitTier::Default) {
+			tier = mVMState.config.tieredCompilation ? JitTier::Baseline : mVMState.config.jitTier;
+		}
+
+		//The stack frame printing requires the layout of the baseline tier
+		if (tier != JitTier::Optimizing
+			|| (mVMState.config.enableDebug && mVMState.config.printStackFrame)) {
+			return false;
+		}
+
+		return IRBuilder(mVMState).canBuild(function);
+	}
+
+	bool JITCompiler::canTierUp(const ManagedFunction& function) const {
+		if (!mVMState.config.tieredCompilation || function.jitTier() != JitTier::Default) {
+			return false;
+		}
+
+		if (mVMState.config.enableDebug && mVMState.config.printStackFrame) {
+			return false;
+		}
+
+		return IRBuilder(mVMState).canBuild(function);
+	}
+
+	void JITCompiler::compileBaseline(FunctionCompilationData& functionData) {
+		auto& function = functionData.function;
+		functionData.operandStack.enableCache(mVMState.config.cacheOperandStack);
+
+		if (functionData.countForTierUp) {
+			function.invocationCounter() = mVMState.config.tierUpInvocations;
+			function.backedgeCounter() = mVMState.config.tierUpBackedges;
+		}
+
+		//Allocate registers for the variables. Functions that can be recompiled keep the variables in the stack frame,
+		//as the layout of the stack frame must be the same for both tiers.
+		if (mVMState.config.allocateRegisters) {
+			if (functionData.countForTierUp) {
+				function.setVariableRegisters({});
+			} else {
+				RegisterAllocator registerAllocator(ManagedFunction::NUM_VARIABLE_REGISTERS);
+				function.setVariableRegisters(registerAllocator.allocate(function));
+			}
+		}
+
+		//Find the branch targets
+		int i = 0;
+		for (auto& current : function.instructions()) {
+			switch (current.opCode()) {
+				case OpCodes::BRANCH:
+				case OpCodes::BRANCH_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					functionData.branchTargets.insert(current.intValue);
+
+					if (current.intValue <= i) {
+						functionData.loopHeaders.insert(current.intValue);
+					}
+					break;
+				default:
+					break;
+			}
+
+			i++;
+		}
+
+		findElidedWriteBarriers(functionData);
+
+		//Initialize the function
+		mCodeGenerator.generateInitializeFunction(functionData);
+
+		//Generate the native instructions for the program
+		i = 0;
+		for (auto& current : function.instructions()) {
+			mCodeGenerator.generateInstruction(mVMState, functionData, current, i);
+			i++;
+		}
+
+		//Patch branches with the native targets
+		resolveBranches(functionData);
+	}
+
+	void JITCompiler::findElidedWriteBarriers(FunctionCompilationData& functionData) {
+		auto& function = functionData.function;
+		auto& instructions = function.instructions();
+
+		//Indicates if the operands and locals hold objects that are known to be in the young generation. An object is
+		//allocated in the young generation, and it can only be promoted by a collection. As arrays may be allocated
+		//elsewhere, only class objects are tracked.
+		std::vector<bool> operands;
+		std::vector<bool> locals(function.numLocals(), false);
+
+		auto clear = [&]() {
+			std::fill(operands.begin(), operands.end(), false);
+			std::fill(locals.begin(), locals.end(), false);
+		};
+
+		for (std::size_t i = 0; i < instructions.size(); i++) {
+			auto& current = instructions[i];
+			auto& operandTypes = current.operandTypes();
+			auto stackSize = operandTypes.size();
+			auto nextStackSize = i + 1 < instructions.size() ? instructions[i + 1].operandTypes().size() : 0;
+
+			//Nothing is known about values that reach the instruction from a branch
+			if (functionData.branchTargets.count((int)i) > 0) {
+				clear();
+			}
+
+			operands.resize(stackSize, false);
+
+			switch (current.opCode()) {
+				case OpCodes::STORE_FIELD:
+					if (TypeSystem::isNullType(operandTypes[0]) || operands[stackSize - 2]) {
+						functionData.elidedWriteBarriers.insert((int)i);
+					}
+
+					//A marking can only start at a collection, so a young object that hasn't seen one is newer than the marking
+					if (operands[stackSize - 2]) {
+						functionData.elidedPreWriteBarriers.insert((int)i);
+					}
+
+					operands.resize(nextStackSize, false);
+					break;
+				case OpCodes::STORE_ELEMENT:
+					if (TypeSystem::isNullType(operandTypes[0])) {
+						functionData.elidedWriteBarriers.insert((int)i);
+					}
+
+					operands.resize(nextStackSize, false);
+					break;
+				case OpCodes::STORE_LOCAL:
+					locals[current.intValue] = operands[stackSize - 1];
+					operands.resize(nextStackSize, false);
+					break;
+				case OpCodes::LOAD_LOCAL:
+					operands.push_back(locals[current.intValue]);
+					break;
+				case OpCodes::DUPLICATE:
+					operands.push_back(operands[stackSize - 1]);
+					break;
+				case OpCodes::NEW_OBJECT:
+					//The allocation can cause a collection, and the constructor can do anything
+					clear();
+					operands.resize(nextStackSize, false);
+					if (!operands.empty()) {
+						operands.back() = !current.callConstructor;
+					}
+					break;
+				case OpCodes::NEW_ARRAY:
+				case OpCodes::LOAD_STRING:
+				case OpCodes::CALL:
+				case OpCodes::CALL_INSTANCE:
+				case OpCodes::CALL_VIRTUAL:
+					clear();
+					operands.resize(nextStackSize, false);
+					break;
+				default:
+					//The result (if any) is not a tracked object
+					operands.resize(nextStackSize, false);
+					if (!operands.empty()) {
+						operands.back() = false;
+					}
+					break;
+			}
+		}
+	}
+
+	void JITCompiler::compileOptimized(FunctionCompilationData& functionData) {
+		auto& function = functionData.function;
+
+		//The values are allocated to the registers used by the operand stack cache
+		functionData.operandStack.enableCache(false);
+
+		//The GC finds the variables of the callers that are allocated to registers in the register save area
+		if (mVMState.config.allocateRegisters) {
+			function.setVariableRegisters({});
+		}
+
+		auto irFunction = IRBuilder(mVMState).build(function);
+		IROptimizer().optimize(*irFunction);
+
+		if (mVMState.config.enableDebug && mVMState.config.printFunctionGeneration) {
+			std::cout << irFunction->toString() << std::endl;
+		}
+
+		mIRLowering.generateFunction(mVMState, functionData, *irFunction);
+	}
+
+	JitFunction JITCompiler::recompileFunction(ManagedFunction* function, JitTier jitTier) {
+		auto signature = FunctionSignature::from(function->def()).str();
+
+		//The current code may still be executed, so it can't call functions that are compiled when called
+		resolveLazyCalls(mFunctions.at(signature));
+
+		mFunctions.erase(signature);
+		function->generatedCode().clear();
+		function->setJitTier(jitTier);
+		return compileFunction(function);
+	}
+
+	void JITCompiler::patchTierUpJump(BytePtr baselineCode, BytePtr optimizedCode) {
+		mCodeGenerator.patchTierUpJump(baselineCode, optimizedCode);
+	}
+
+	BytePtr JITCompiler::getOsrEntry(const ManagedFunction& function, int loopHeader) const {
+		auto signature = FunctionSignature::from(function.def()).str();
+		if (mFunctions.count(signature) == 0) {
+			return nullptr;
+		}
+
+		auto& osrEntries = mFunctions.at(signature).osrEntries;
+		auto osrEntry = osrEntries.find(loopHeader);
+		if (osrEntry == osrEntries.end()) {
+			return nullptr;
+		}
+
+		return function.def().entryPoint() + osrEntry->second;
+	}
+
 	void JITCompiler::resolveBranches(FunctionCompilationData& functionData) {
 		auto& function = functionData.function;
 
@@ -143,6 +382,25 @@ namespace stackjit {
 		functionData.unresolvedNativeBranches.clear();
 	}
 
+	void JITCompiler::resolveLazyCalls(FunctionCompilationData& functionData) {
+		//Get a pointer to the functions native instructions
+		auto codePtr = functionData.function.def().entryPoint();
+
+		for (auto& lazyCall : functionData.lazyCalls) {
+			mVMState.engine().compileFunction(FunctionSignature::from(lazyCall.funcToCall).str());
+
+			//Update the call target
+			int target = (int)(lazyCall.funcToCall.entryPoint() - (codePtr + lazyCall.callOffset + 5));
+			Helpers::setValue(codePtr, lazyCall.callOffset + 1, target);
+
+			//Replace the check with a branch to end of the check
+			codePtr[lazyCall.checkStart] = 0xe9;
+			Helpers::setValue(codePtr, lazyCall.checkStart + 1, (int)(lazyCall.checkEnd - (lazyCall.checkStart + 5)));
+		}
+
+		functionData.lazyCalls.clear();
+	}
+
 	void JITCompiler::resolveCallTargets(FunctionCompilationData& functionData) {
 		//Get a pointer to the functions native instructions
 		auto codePtr = functionData.function.def().entryPoint();
@@ -166,6 +424,35 @@ namespace stackjit {
 		functionData.unresolvedCalls.clear();
 	}
 
+	void JITCompiler::createVirtualFunctionStubs(const ClassMetadataProvider& classProvider) {
+		for (auto& current : classProvider.classesMetadata()) {
+			auto& metadata = current.second;
+			auto virtualFunctionTable = metadata.virtualFunctionTable();
+
+			if (virtualFunctionTable == nullptr) {
+				continue;
+			}
+
+			CodeGen stubCode;
+			std::vector<std::pair<int, std::size_t>> stubOffsets;
+			for (auto& virtualFunc : metadata.virtualFunctions()) {
+				if (virtualFunctionTable[virtualFunc.first] == nullptr) {
+					stubOffsets.push_back({ virtualFunc.first, stubCode.size() });
+					mCodeGenerator.generateVirtualFunctionStub(stubCode, &metadata, virtualFunc.first);
+				}
+			}
+
+			if (!stubOffsets.empty()) {
+				auto stubMemory = (BytePtr)mMemoryManager.allocateMemory(stubCode.size());
+				memcpy(stubMemory, stubCode.data(), stubCode.size());
+
+				for (auto& stub : stubOffsets) {
+					virtualFunctionTable[stub.first] = stubMemory + stub.second;
+				}
+			}
+		}
+	}
+
 	void JITCompiler::resolveSymbols(const std::string& signature) {
 		if (mFunctions.count(signature) > 0) {
 			auto& func = mFunctions.at(signature);
@@ -192,7 +479,9 @@ namespace stackjit {
 			}
 		}
 
-		//Make the functions memory executable, but not writable.
-		mMemoryManager.makeMemoryExecutable();
+		//Make the functions memory executable, but not writable. Tiered compilation patches the code at runtime.
+		if (!mVMState.config.tieredCompilation) {
+			mMemoryManager.makeMemoryExecutable();
+		}
 	}
 }
@@ -4,6 +4,7 @@
 #include "x64/codegenerator.h"
 #include "x64/compilationdata.h"
 #include "x64/exceptions.h"
+#include "x64/irlowering.h"
 #include <unordered_map>
 #include <vector>
 #include <functional>
@@ -12,6 +13,7 @@ namespace stackjit {
 	class VMState;
 	class ManagedFunction;
 	class Type;
+	class ClassMetadataProvider;
 
 	//Represents a compiled function
 	using JitFunction = void(*)();
@@ -30,17 +32,37 @@ namespace stackjit {
 		CallingConvention mCallingConvention;
 		ExceptionHandling mExceptionHandling;
 		CodeGenerator mCodeGenerator;
+		IRLowering mIRLowering;
 		std::unordered_map<std::string, FunctionCompilationData> mFunctions;
 
 		//Creates macro functions
 		void createMacros();
 
+		//Indicates if the given function is compiled by the optimizing tier
+		bool useOptimizingTier(const ManagedFunction& function) const;
+
+		//Indicates if the baseline code for the given function counts invocations and loop iterations to be recompiled
+		bool canTierUp(const ManagedFunction& function) const;
+
+		//Compiles the given function using the baseline tier, which generates native instructions directly from the bytecode
+		void compileBaseline(FunctionCompilationData& functionData);
+
+		//Finds the stores of references in the given function that don't need a write barrier. This is the case if the
+		//stored value is null, or if the object was allocated by the function and no collection can have occurred since.
+		void findElidedWriteBarriers(FunctionCompilationData& functionData);
+
+		//Compiles the given function using the optimizing tier, which generates native instructions from the IR
+		void compileOptimized(FunctionCompilationData& functionData);
+
 		//Resolves branches for the given function
 		void resolveBranches(FunctionCompilationData& functionData);
 
 		//Resolves native branches for the given function
 		void resolveNativeBranches(FunctionCompilationData& functionData);
 
+		//Compiles the functions called by the lazy calls of the given function, and patches the calls
+		void resolveLazyCalls(FunctionCompilationData& functionData);
+
 		//Resolves call targets. This function should only be called after all functions has been compiled.
 		void resolveCallTargets(FunctionCompilationData& functionData);
 
@@ -63,6 +85,19 @@ namespace stackjit {
 		//Compiles the given function
 		JitFunction compileFunction(ManagedFunction* function);
 
+		//Recompiles the given function with the given tier
+		JitFunction recompileFunction(ManagedFunction* function, JitTier jitTier);
+
+		//Replaces the entry of the given baseline code with a jump to the given optimized code
+		void patchTierUpJump(BytePtr baselineCode, BytePtr optimizedCode);
+
+		//Returns the entry for on-stack replacement at the given loop header of the optimized function,
+		//or null if there is no such entry.
+		BytePtr getOsrEntry(const ManagedFunction& function, int loopHeader) const;
+
+		//Sets the unbound entries of the virtual function tables to stubs that compile the functions when called
+		void createVirtualFunctionStubs(const ClassMetadataProvider& classProvider);
+
 		//Resolves symbols for the given function
 		void resolveSymbols(const std::string& signature);
 
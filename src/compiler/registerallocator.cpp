@@ -0,0 +1,166 @@
+#include "registerallocator.h"
+#include <algorithm>
+
+namespace stackjit {
+	namespace {
+		//Indicates if the given instruction is a branch
+		bool isBranch(const Instruction& instruction) {
+			switch (instruction.opCode()) {
+				case OpCodes::BRANCH:
+				case OpCodes::BRANCH_EQUAL:
+				case OpCodes::BRANCH_NOT_EQUAL:
+				case OpCodes::BRANCH_GREATER_THAN:
+				case OpCodes::BRANCH_GREATER_THAN_OR_EQUAL:
+				case OpCodes::BRANCH_LESS_THAN:
+				case OpCodes::BRANCH_LESS_THAN_OR_EQUAL:
+					return true;
+				default:
+					return false;
+			}
+		}
+	}
+
+	RegisterAllocator::RegisterAllocator(int numRegisters)
+		: mNumRegisters(numRegisters) {
+
+	}
+
+	std::vector<VariableRegister> RegisterAllocator::computeLiveIntervals(const ManagedFunction& function) const {
+		auto numArgs = function.def().numParameters();
+		std::vector<VariableRegister> intervals(numArgs + function.numLocals());
+
+		//Find the first and last use of each variable
+		int index = 0;
+		for (auto& instruction : function.instructions()) {
+			int variable = -1;
+
+			switch (instruction.opCode()) {
+				case OpCodes::LOAD_ARG:
+					variable = instruction.intValue;
+					break;
+				case OpCodes::LOAD_LOCAL:
+				case OpCodes::STORE_LOCAL:
+					variable = (int)numArgs + instruction.intValue;
+					break;
+				default:
+					break;
+			}
+
+			if (variable != -1) {
+				auto& interval = intervals[variable];
+				if (interval.end == -1) {
+					interval.start = index;
+				}
+
+				interval.end = index;
+			}
+
+			index++;
+		}
+
+		//The arguments are defined at entry
+		for (std::size_t i = 0; i < numArgs; i++) {
+			intervals[i].start = 0;
+		}
+
+		//Extend the intervals such that the only way to enter an interval is through its start.
+		//This makes the intervals conservative for loops and for values that are defined on only some paths.
+		bool changed = true;
+		while (changed) {
+			changed = false;
+
+			int branchIndex = 0;
+			for (auto& instruction : function.instructions()) {
+				if (isBranch(instruction)) {
+					int target = instruction.intValue;
+
+					for (auto& interval : intervals) {
+						if (interval.end == -1) {
+							continue;
+						}
+
+						int newStart = interval.start;
+						int newEnd = interval.end;
+
+						if (target <= branchIndex) {
+							//A loop that overlaps the interval, the variable is live in the whole loop
+							if (target <= interval.end && branchIndex >= interval.start) {
+								newStart = std::min(newStart, target);
+								newEnd = std::max(newEnd, branchIndex);
+							}
+						} else if (branchIndex < interval.start && target >= interval.start && target <= interval.end) {
+							//A forward branch into the interval
+							newStart = branchIndex;
+						}
+
+						if (newStart != interval.start || newEnd != interval.end) {
+							interval.start = newStart;
+							interval.end = newEnd;
+							changed = true;
+						}
+					}
+				}
+
+				branchIndex++;
+			}
+		}
+
+		return intervals;
+	}
+
+	std::vector<VariableRegister> RegisterAllocator::allocate(const ManagedFunction& function) const {
+		auto intervals = computeLiveIntervals(function);
+
+		//Sort the live variables by start point
+		std::vector<int> unhandled;
+		for (int i = 0; i < (int)intervals.size(); i++) {
+			if (intervals[i].end != -1) {
+				unhandled.push_back(i);
+			}
+		}
+
+		std::stable_sort(unhandled.begin(), unhandled.end(), [&](int x, int y) {
+			return intervals[x].start < intervals[y].start;
+		});
+
+		std::vector<int> active;
+		std::vector<bool> freeRegisters((std::size_t)mNumRegisters, true);
+
+		for (auto current : unhandled) {
+			auto& currentInterval = intervals[current];
+
+			//Expire old intervals. An interval ending at the start of the current can't share register,
+			//as the current is initialized before the instruction is executed.
+			for (auto it = active.begin(); it != active.end();) {
+				auto& interval = intervals[*it];
+				if (interval.end < currentInterval.start) {
+					freeRegisters[interval.registerIndex] = true;
+					it = active.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			auto freeRegister = std::find(freeRegisters.begin(), freeRegisters.end(), true);
+			if (freeRegister != freeRegisters.end()) {
+				currentInterval.registerIndex = (int)(freeRegister - freeRegisters.begin());
+				*freeRegister = false;
+				active.push_back(current);
+			} else if (!active.empty()) {
+				//Spill the interval that ends last
+				auto spill = std::max_element(active.begin(), active.end(), [&](int x, int y) {
+					return intervals[x].end < intervals[y].end;
+				});
+
+				auto& spillInterval = intervals[*spill];
+				if (spillInterval.end > currentInterval.end) {
+					currentInterval.registerIndex = spillInterval.registerIndex;
+					spillInterval.registerIndex = -1;
+					*spill = current;
+				}
+			}
+		}
+
+		return intervals;
+	}
+}
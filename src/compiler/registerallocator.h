@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include "../core/function.h"
+
+namespace stackjit {
+	//Allocates the arguments and locals of a function to registers using linear scan
+	class RegisterAllocator {
+	private:
+		const int mNumRegisters;
+	public:
+		//Creates a new register allocator using the given number of registers
+		explicit RegisterAllocator(int numRegisters);
+
+		//Computes the live intervals for the arguments and locals (in that order) of the given function
+		std::vector<VariableRegister> computeLiveIntervals(const ManagedFunction& function) const;
+
+		//Allocates registers for the arguments and locals (in that order) of the given function
+		std::vector<VariableRegister> allocate(const ManagedFunction& function) const;
+	};
+}
@@ -194,6 +194,44 @@ namespace stackjit {
 		codeGen.push_back(0xc0 | (Byte)dest | ((Byte)src << 3));
 	}
 
+	void Amd64Backend::moveRegToReg(CodeGen& codeGen, FloatRegisters dest, FloatRegisters src) {
+		codeGen.push_back(0x0f);
+		codeGen.push_back(0x28);
+		codeGen.push_back(0xc0 | (Byte)src | ((Byte)dest << 3));
+	}
+
+	void Amd64Backend::moveRegToReg(CodeGen& codeGen, FloatRegisters dest, Registers src) {
+		codeGen.push_back(0x66);
+		codeGen.push_back(0x48);
+		codeGen.push_back(0x0f);
+		codeGen.push_back(0x6e);
+		codeGen.push_back(0xc0 | (Byte)src | ((Byte)dest << 3));
+	}
+
+	void Amd64Backend::moveRegToReg(CodeGen& codeGen, FloatRegisters dest, ExtendedRegisters src) {
+		codeGen.push_back(0x66);
+		codeGen.push_back(0x49);
+		codeGen.push_back(0x0f);
+		codeGen.push_back(0x6e);
+		codeGen.push_back(0xc0 | (Byte)src | ((Byte)dest << 3));
+	}
+
+	void Amd64Backend::moveRegToReg(CodeGen& codeGen, Registers dest, FloatRegisters src) {
+		codeGen.push_back(0x66);
+		codeGen.push_back(0x48);
+		codeGen.push_back(0x0f);
+		codeGen.push_back(0x7e);
+		codeGen.push_back(0xc0 | (Byte)dest | ((Byte)src << 3));
+	}
+
+	void Amd64Backend::moveRegToReg(CodeGen& codeGen, ExtendedRegisters dest, FloatRegisters src) {
+		codeGen.push_back(0x66);
+		codeGen.push_back(0x49);
+		codeGen.push_back(0x0f);
+		codeGen.push_back(0x7e);
+		codeGen.push_back(0xc0 | (Byte)dest | ((Byte)src << 3));
+	}
+
 	void Amd64Backend::moveRegToMemory(CodeGen& codeGen, BytePtr destAddr, Registers srcReg) {
 		assert(srcReg == Registers::AX && "Only the AX register is supported.");
 		codeGen.push_back(0x48);
@@ -462,6 +500,39 @@ namespace stackjit {
 		}
 	}
 
+	void Amd64Backend::moveByteToMemoryRegWithIntOffset(CodeGen& codeGen, Registers destMemReg, int offset, char value) {
+		codeGen.push_back(0xc6);
+
+		if (destMemReg != Registers::SP) {
+			codeGen.push_back((0x80 | (Byte)destMemReg));
+		} else {
+			codeGen.push_back(0x84);
+			codeGen.push_back(0x24);
+		}
+
+		IntToBytes converter;
+		converter.intValue = offset;
+		for (std::size_t i = 0; i < sizeof(int); i++) {
+			codeGen.push_back(converter.byteValues[i]);
+		}
+
+		codeGen.push_back((Byte)value);
+	}
+
+	void Amd64Backend::moveByteToMemoryRegWithIntOffset(CodeGen& codeGen, ExtendedRegisters destMemReg, int offset, char value) {
+		codeGen.push_back(0x41);
+		codeGen.push_back(0xc6);
+		codeGen.push_back((0x80 | (Byte)destMemReg));
+
+		IntToBytes converter;
+		converter.intValue = offset;
+		for (std::size_t i = 0; i < sizeof(int); i++) {
+			codeGen.push_back(converter.byteValues[i]);
+		}
+
+		codeGen.push_back((Byte)value);
+	}
+
 	void Amd64Backend::moveMemoryRegWithOffsetToReg(CodeGen& codeGen, Registers dest, Registers srcMemReg, int offset) {
 		if (validCharValue(offset)) {
 			moveMemoryRegWithCharOffsetToReg(codeGen, dest, srcMemReg, (char)offset);
@@ -750,6 +821,17 @@ namespace stackjit {
 		codeGen.push_back(0xd0 | (Byte)func);
 	}
 
+	void Amd64Backend::jumpInReg(CodeGen& codeGen, Registers target) {
+		codeGen.push_back(0xff);
+		codeGen.push_back(0xe0 | (Byte)target);
+	}
+
+	void Amd64Backend::jumpInReg(CodeGen& codeGen, ExtendedRegisters target) {
+		codeGen.push_back(0x41);
+		codeGen.push_back(0xff);
+		codeGen.push_back(0xe0 | (Byte)target);
+	}
+
 	void Amd64Backend::call(CodeGen& codeGen, int funcAddr) {
 		codeGen.push_back(0xe8);
 
@@ -1088,7 +1170,7 @@ namespace stackjit {
 		codeGen.push_back(0xf3);
 		codeGen.push_back(0x0f);
 		codeGen.push_back(0x5e);
-		codeGen.push_back(0xf8 | (Byte)src | ((Byte)dest << 3));
+		codeGen.push_back(0xc0 | (Byte)src | ((Byte)dest << 3));
 	}
 
 	void Amd64Backend::divRegFromRegUnsigned(CodeGen& codeGen, Registers dest, Registers src, bool is32bits) {
@@ -1239,6 +1321,20 @@ namespace stackjit {
 		codeGen.push_back(0xd0 | (Byte)reg);
 	}
 
+	void Amd64Backend::shiftRightReg(CodeGen& codeGen, Registers reg, unsigned char amount) {
+		codeGen.push_back(0x48);
+		codeGen.push_back(0xc1);
+		codeGen.push_back(0xe8 | (Byte)reg);
+		codeGen.push_back(amount);
+	}
+
+	void Amd64Backend::shiftRightReg(CodeGen& codeGen, ExtendedRegisters reg, unsigned char amount) {
+		codeGen.push_back(0x49);
+		codeGen.push_back(0xc1);
+		codeGen.push_back(0xe8 | (Byte)reg);
+		codeGen.push_back(amount);
+	}
+
 	void Amd64Backend::compareRegToReg(CodeGen& codeGen, Registers reg1, Registers reg2) {
 		codeGen.push_back(0x48);
 		codeGen.push_back(0x39);
@@ -1414,9 +1510,13 @@ namespace stackjit {
 		codeGen.push_back(0x99);
 	}
 
-	void Amd64Backend::convertIntToFloat(CodeGen& codeGen, FloatRegisters dest, Registers src) {
+	void Amd64Backend::convertIntToFloat(CodeGen& codeGen, FloatRegisters dest, Registers src, bool is32bits) {
 		codeGen.push_back(0xf3);
-		codeGen.push_back(0x48);
+
+		if (!is32bits) {
+			codeGen.push_back(0x48);
+		}
+
 		codeGen.push_back(0x0f);
 		codeGen.push_back(0x2a);
 		codeGen.push_back((0xc0 | (Byte)src | (Byte)dest << 3));
@@ -109,6 +109,13 @@ namespace stackjit {
 		void moveRegToReg(CodeGen& codeGen, ExtendedRegisters dest, ExtendedRegisters src);
 		void moveRegToReg(CodeGen& codeGen, ExtendedRegisters dest, Registers src);
 		void moveRegToReg(CodeGen& codeGen, Registers dest, ExtendedRegisters src);
+		void moveRegToReg(CodeGen& codeGen, FloatRegisters dest, FloatRegisters src);
+
+		//Moves the content of an int register to a float register and vice versa (64-bits)
+		void moveRegToReg(CodeGen& codeGen, FloatRegisters dest, Registers src);
+		void moveRegToReg(CodeGen& codeGen, FloatRegisters dest, ExtendedRegisters src);
+		void moveRegToReg(CodeGen& codeGen, Registers dest, FloatRegisters src);
+		void moveRegToReg(CodeGen& codeGen, ExtendedRegisters dest, FloatRegisters src);
 
 		//Moves the content from the register to the memory address
 		void moveRegToMemory(CodeGen& codeGen, BytePtr destAddr, Registers srcReg);
@@ -144,6 +151,10 @@ namespace stackjit {
 		void moveIntToMemoryRegWithIntOffset(CodeGen& codeGen, Registers destMemReg, int offset, int value);
 		void moveIntToMemoryRegWithIntOffset(CodeGen& codeGen, ExtendedRegisters destMemReg, int offset, int value);
 
+		//Moves a byte to the memory where the address is in a register + int offset
+		void moveByteToMemoryRegWithIntOffset(CodeGen& codeGen, Registers destMemReg, int offset, char value);
+		void moveByteToMemoryRegWithIntOffset(CodeGen& codeGen, ExtendedRegisters destMemReg, int offset, char value);
+
 		//Moves the content from a memory where the address is a register + offset to a register
 		void moveMemoryRegWithOffsetToReg(CodeGen& codeGen, Registers dest, Registers srcMemReg, int offset);
 
@@ -185,6 +196,10 @@ namespace stackjit {
 		void callInReg(CodeGen& codeGen, Registers func);
 		void callInReg(CodeGen& codeGen, ExtendedRegisters func);
 
+		//Jumps to the address in the given register
+		void jumpInReg(CodeGen& codeGen, Registers target);
+		void jumpInReg(CodeGen& codeGen, ExtendedRegisters target);
+
 		//Calls the given function
 		void call(CodeGen& codeGen, int funcAddr);
 
@@ -283,6 +298,10 @@ namespace stackjit {
 		void notReg(CodeGen& codeGen, Registers reg, bool is32bits = false);
 		void notReg(CodeGen& codeGen, ExtendedRegisters reg);
 
+		//Shifts the register right by the given amount, where the shifted in bits are zero
+		void shiftRightReg(CodeGen& codeGen, Registers reg, unsigned char amount);
+		void shiftRightReg(CodeGen& codeGen, ExtendedRegisters reg, unsigned char amount);
+
 		//Compares the two registers
 		void compareRegToReg(CodeGen& codeGen, Registers reg1, Registers reg2);
 		void compareRegToReg(CodeGen& codeGen, ExtendedRegisters reg1, ExtendedRegisters reg2);
@@ -333,7 +352,7 @@ namespace stackjit {
 		void signExtend16(CodeGen& codeGen);
 
 		//Converts the second register to a float
-		void convertIntToFloat(CodeGen& codeGen, FloatRegisters dest, Registers src);
+		void convertIntToFloat(CodeGen& codeGen, FloatRegisters dest, Registers src, bool is32bits = false);
 		void convertIntToFloat(CodeGen& codeGen, FloatRegisters dest, ExtendedRegisters src);
 
 		//Converts the second register to an int
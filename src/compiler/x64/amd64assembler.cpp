@@ -344,6 +344,14 @@ namespace stackjit {
 			[&](CodeGen& codeGen, ExtendedRegisters x) { Amd64Backend::notReg(codeGen, x); });
 	}
 
+	void Amd64Assembler::shiftRight(IntRegister intRegister, unsigned char amount) {
+		generateOneRegisterWithValueInstruction<unsigned char>(
+			intRegister,
+			amount,
+			[&](CodeGen& codeGen, Registers x, unsigned char y) { Amd64Backend::shiftRightReg(codeGen, x, y); },
+			[&](CodeGen& codeGen, ExtendedRegisters x, unsigned char y) { Amd64Backend::shiftRightReg(codeGen, x, y); });
+	}
+
 	void Amd64Assembler::move(IntRegister destination, IntRegister source) {
 		generateTwoRegistersInstruction(
 			destination,
@@ -354,6 +362,26 @@ namespace stackjit {
 			[&](CodeGen& codeGen, ExtendedRegisters x, Registers y) { Amd64Backend::moveRegToReg(codeGen, x, y); });
 	}
 
+	void Amd64Assembler::move(FloatRegisters destination, FloatRegisters source) {
+		Amd64Backend::moveRegToReg(mData, destination, source);
+	}
+
+	void Amd64Assembler::move(FloatRegisters destination, IntRegister source) {
+		if (source.isBase()) {
+			Amd64Backend::moveRegToReg(mData, destination, source.baseRegister());
+		} else {
+			Amd64Backend::moveRegToReg(mData, destination, source.extendedRegister());
+		}
+	}
+
+	void Amd64Assembler::move(IntRegister destination, FloatRegisters source) {
+		if (destination.isBase()) {
+			Amd64Backend::moveRegToReg(mData, destination.baseRegister(), source);
+		} else {
+			Amd64Backend::moveRegToReg(mData, destination.extendedRegister(), source);
+		}
+	}
+
 	void Amd64Assembler::moveInt(IntRegister destination, std::int32_t value) {
 		generateOneRegisterWithValueInstruction<std::int32_t>(
 			destination,
@@ -547,6 +575,14 @@ namespace stackjit {
 			[&](CodeGen& codeGen, ExtendedRegisters dest, int offset, std::int32_t x) { Amd64Backend::moveIntToMemoryRegWithIntOffset(codeGen, dest, offset, x); });
 	}
 
+	void Amd64Assembler::moveByte(MemoryOperand destination, char value) {
+		generateOneMemoryOperandWithValueInstruction<char>(
+			destination,
+			value,
+			[&](CodeGen& codeGen, Registers dest, int offset, char x) { Amd64Backend::moveByteToMemoryRegWithIntOffset(codeGen, dest, offset, x); },
+			[&](CodeGen& codeGen, ExtendedRegisters dest, int offset, char x) { Amd64Backend::moveByteToMemoryRegWithIntOffset(codeGen, dest, offset, x); });
+	}
+
 	void Amd64Assembler::move(BytePtr destination, IntRegister source) {
 		if (!source.isBase()) {
 			throw std::runtime_error("Extended registers not supported");
@@ -613,10 +649,10 @@ namespace stackjit {
 		}
 	}
 
-	void Amd64Assembler::convert(FloatRegisters destination, IntRegister source) {
+	void Amd64Assembler::convert(FloatRegisters destination, IntRegister source, bool is32Bits) {
 		//cvtsi2ss xmm0, rax
 		if (source.isBase()) {
-			Amd64Backend::convertIntToFloat(mData, destination, source.baseRegister());
+			Amd64Backend::convertIntToFloat(mData, destination, source.baseRegister(), is32Bits);
 		} else {
 			Amd64Backend::convertIntToFloat(mData, destination, source.extendedRegister());
 		}
@@ -680,6 +716,13 @@ namespace stackjit {
 		}
 	}
 
+	void Amd64Assembler::jump(IntRegister intRegister) {
+		generateOneRegisterInstruction(
+			intRegister,
+			[&](CodeGen& codeGen, Registers reg) { Amd64Backend::jumpInReg(mData, reg); },
+			[&](CodeGen& codeGen, ExtendedRegisters reg) { Amd64Backend::jumpInReg(mData, reg); });
+	}
+
 	void Amd64Assembler::call(IntRegister intRegister) {
 		generateOneRegisterInstruction(
 			intRegister,
@@ -234,8 +234,16 @@ namespace stackjit {
 		//Applies bitwise NOT to the given register
 		void bitwiseNot(IntRegister intRegister, bool is32Bits = DEFAULT_IS_32_BITS);
 
+		//Shifts the given register right by the given amount, where the shifted in bits are zero
+		void shiftRight(IntRegister intRegister, unsigned char amount);
+
 		//Moves the second register to the first
 		void move(IntRegister destination, IntRegister source);
+		void move(FloatRegisters destination, FloatRegisters source);
+
+		//Moves the bits of an int register to a float register and vice versa
+		void move(FloatRegisters destination, IntRegister source);
+		void move(IntRegister destination, FloatRegisters source);
 
 		//Moves the given 32-bits integer to the given register
 		void moveInt(IntRegister destination, std::int32_t value);
@@ -259,6 +267,9 @@ namespace stackjit {
 		//Moves the given into the memory operand
 		void move(MemoryOperand destination, std::int32_t value);
 
+		//Moves the given byte into the memory operand
+		void moveByte(MemoryOperand destination, char value);
+
 		//Moves the given register to the given address. Only the RAX register is supported.
 		void move(BytePtr destination, IntRegister source);
 
@@ -284,7 +295,7 @@ namespace stackjit {
 		void convert(IntRegister destination, FloatRegisters source);
 
 		//Converts the source to a float
-		void convert(FloatRegisters destination, IntRegister source);
+		void convert(FloatRegisters destination, IntRegister source, bool is32Bits = DEFAULT_IS_32_BITS);
 
 		//Compares two registers
 		void compare(IntRegister destination, IntRegister source);
@@ -293,6 +304,9 @@ namespace stackjit {
 		//Jumps to the given target
 		void jump(JumpCondition condition, int target, bool unsignedComparison = false);
 
+		//Jumps to the address in the given register
+		void jump(IntRegister intRegister);
+
 		//Calls the function in the given register
 		void call(IntRegister intRegister);
 
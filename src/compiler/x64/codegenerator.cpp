@@ -9,6 +9,8 @@
 #include "../../core/functionsignature.h"
 #include "amd64assembler.h"
 #include <string.h>
+#include <cstring>
+#include <cstddef>
 #include <iostream>
 
 namespace stackjit {
@@ -72,22 +74,114 @@ namespace stackjit {
 		}
 	}
 
+	void CodeGenerator::moveVariableRegisters(Amd64Assembler& assembler,
+											  const ManagedFunction& function,
+											  int instructionIndex,
+											  bool toStackFrame) {
+		if (!function.hasRegisterSaveArea()) {
+			return;
+		}
+
+		auto numVariables = function.def().numParameters() + function.numLocals();
+		for (std::size_t i = 0; i < numVariables; i++) {
+			auto variableRegister = function.getVariableRegister(i);
+			if (variableRegister.isAllocated() && variableRegister.isLive(instructionIndex)) {
+				MemoryOperand variableOperand(Registers::BP, -(int)((i + 1) * Amd64Backend::REGISTER_SIZE));
+				auto reg = VARIABLE_REGISTERS[variableRegister.registerIndex];
+
+				if (toStackFrame) {
+					assembler.move(variableOperand, reg);
+				} else {
+					assembler.move(reg, variableOperand);
+				}
+			}
+		}
+
+		for (int i = 0; i < ManagedFunction::NUM_VARIABLE_REGISTERS; i++) {
+			if (!function.usesRegister(i)) {
+				MemoryOperand saveSlot(Registers::BP, function.registerSaveSlotOffset(i));
+
+				if (toStackFrame) {
+					assembler.move(saveSlot, VARIABLE_REGISTERS[i]);
+				} else {
+					assembler.move(VARIABLE_REGISTERS[i], saveSlot);
+				}
+			}
+		}
+	}
+
 	void CodeGenerator::generateGCCall(CodeGen& generatedCode, ManagedFunction& function, int instructionIndex, int generation) {
 		Amd64Assembler assembler(generatedCode);
+		function.addSafepoint(instructionIndex);
+		moveVariableRegisters(assembler, function, instructionIndex, true);
+
 		assembler.move(RegisterCallArguments::Arg0, Registers::BP); //BP as the first argument
 		assembler.moveLong(RegisterCallArguments::Arg1,	(PtrValue)&function); //Address of the function as second argument
 		assembler.moveInt(RegisterCallArguments::Arg2, instructionIndex); //Current inst index as third argument
 		assembler.moveInt(RegisterCallArguments::Arg3, generation); //Generation as fourth argument
 		generateCall(assembler, (BytePtr)&Runtime::garbageCollect);
+
+		//The GC may have moved the objects
+		moveVariableRegisters(assembler, function, instructionIndex, false);
+	}
+
+	void CodeGenerator::generateTierUpCheck(Amd64Assembler& assembler, ManagedFunction& function, int& counter, int loopHeader) {
+		assembler.moveLong(Registers::AX, (PtrValue)&counter);
+		assembler.move(Registers::CX, MemoryOperand(Registers::AX), DataSize::Size32);
+		assembler.sub(Registers::CX, 1, true);
+		assembler.move(MemoryOperand(Registers::AX), Registers::CX, DataSize::Size32);
+
+		std::size_t checkStart = assembler.size();
+		assembler.jump(JumpCondition::NotEqual, 0);
+		std::size_t callStart = assembler.size();
+
+		assembler.moveLong(RegisterCallArguments::Arg0, (PtrValue)&function);
+
+		if (loopHeader == -1) {
+			generateCall(assembler, (BytePtr)&Runtime::tierUpFunction);
+		} else {
+			assembler.moveInt(RegisterCallArguments::Arg1, loopHeader);
+			generateCall(assembler, (BytePtr)&Runtime::tierUpLoop);
+
+			//Continue the execution in the optimized code if it has an entry for the loop
+			assembler.bitwiseXor(Registers::CX, Registers::CX);
+			assembler.compare(Registers::AX, Registers::CX);
+			assembler.jump(JumpCondition::Equal, 2);
+			assembler.jump(Registers::AX);
+		}
+
+		Helpers::setValue(assembler.data(), checkStart + 2, (int)(assembler.size() - callStart));
+	}
+
+	void CodeGenerator::patchTierUpJump(BytePtr baselineCode, BytePtr optimizedCode) {
+		std::vector<unsigned char> jumpCode;
+		Amd64Assembler assembler(jumpCode);
+		assembler.moveLong(Registers::AX, (PtrValue)optimizedCode);
+		assembler.jump(Registers::AX);
+
+		std::memcpy(baselineCode, jumpCode.data(), jumpCode.size());
 	}
 
 	void CodeGenerator::generateInitializeFunction(FunctionCompilationData& functionData) {
 		auto& function = functionData.function;
 		Amd64Assembler assembler(functionData.function.generatedCode());
 
+		//Reserve room for a jump to the optimized code, as the function may be recompiled while the baseline code is used
+		if (functionData.countForTierUp) {
+			assembler.jump(JumpCondition::Always, TIER_UP_JUMP_SIZE - 5);
+			for (int i = 5; i < TIER_UP_JUMP_SIZE; i++) {
+				assembler.data().push_back(0x90); //nop
+			}
+		}
+
 		//Calculate the size of the stack aligned to 16 bytes
 		std::size_t neededStackSize = (function.def().numParameters() + function.numLocals() + function.operandStackSize())
 									  * Amd64Backend::REGISTER_SIZE;
+
+		if (function.hasRegisterSaveArea()) {
+			neededStackSize += ManagedFunction::NUM_VARIABLE_REGISTERS * Amd64Backend::REGISTER_SIZE;
+		}
+
 		std::size_t stackSize = ((neededStackSize + 15) / 16) * 16;
 
 		//Save the base pointer
@@ -99,8 +193,30 @@ namespace stackjit {
 			assembler.sub(Registers::SP, (int)stackSize);
 		}
 
+		//Save the registers used by the variables
+		for (int i = 0; i < ManagedFunction::NUM_VARIABLE_REGISTERS; i++) {
+			if (function.usesRegister(i)) {
+				assembler.move({ Registers::BP, function.registerSaveSlotOffset(i) }, VARIABLE_REGISTERS[i]);
+			}
+		}
+
 		mCallingConvention.moveArgsToStack(functionData);
 		generateZeroLocals(functionData.function, assembler);
+
+		//Load the arguments allocated to registers
+		for (std::size_t i = 0; i < function.def().numParameters(); i++) {
+			auto argumentRegister = function.getArgumentRegister(i);
+			if (argumentRegister.isAllocated()) {
+				assembler.move(
+					VARIABLE_REGISTERS[argumentRegister.registerIndex],
+					{ Registers::BP, -(int)((i + 1) * Amd64Backend::REGISTER_SIZE) });
+			}
+		}
+
+		//Count the invocations
+		if (functionData.countForTierUp) {
+			generateTierUpCheck(assembler, function, function.invocationCounter());
+		}
 	}
 
 	void CodeGenerator::generateZeroLocals(ManagedFunction& function, Amd64Assembler& assembler) {
@@ -115,37 +231,13 @@ namespace stackjit {
 		}
 	}
 
-	void CodeGenerator::pushFunc(VMState& vmState, FunctionCompilationData& functionData, int instructionIndex, Amd64Assembler& assembler) {
-		auto& function = functionData.function;
-
-		//Get the top pointer
-		auto topPtr = (BytePtr)vmState.engine().callStack().topPtr();
-		assembler.move(Registers::AX, topPtr);
-		assembler.add(Registers::AX, sizeof(CallStackEntry));
-
-		//Check if overflow
-		mExceptionHandling.addStackOverflowCheck(
-			functionData,
-			(PtrValue)(vmState.engine().callStack().start() + vmState.engine().callStack().size()));
-
-		//Store the entry
-		assembler.moveLong(Registers::CX, (PtrValue)&function);
-		assembler.move({ Registers::AX, 0 }, Registers::CX);
-		assembler.moveInt(Registers::CX, instructionIndex);
-		assembler.move({ Registers::AX, sizeof(ManagedFunction*) }, Registers::CX);
-
-		//Update the top pointer
-		assembler.move(topPtr, Registers::AX);
+	void CodeGenerator::generateStackOverflowCheck(VMState& vmState, FunctionCompilationData& functionData) {
+		mExceptionHandling.addStackOverflowCheck(functionData, vmState.engine().callStack().limitPtr());
 	}
 
-	void CodeGenerator::popFunc(VMState& vmState, Amd64Assembler& assembler) {
-		//Get the top pointer
-		auto topPtr = (BytePtr)vmState.engine().callStack().topPtr();
-		assembler.move(Registers::AX, topPtr);
-		assembler.add(Registers::AX, -(int)sizeof(CallStackEntry));
-
-		//Update the top pointer
-		assembler.move(topPtr, Registers::AX);
+	void CodeGenerator::addCallSite(FunctionCompilationData& functionData, int instructionIndex) {
+		functionData.callSites.push_back(CallSiteOffset(functionData.assembler.size(), instructionIndex));
+		functionData.function.addSafepoint(instructionIndex);
 	}
 
 	void CodeGenerator::printRegister(Amd64Assembler& assembler, IntRegister reg) {
@@ -171,46 +263,323 @@ namespace stackjit {
 		assembler.pop(Registers::AX);
 	}
 
+	void CodeGenerator::generateVirtualFunctionLoad(Amd64Assembler& assembler, const ClassType* classType, int virtualFunctionIndex) {
+		//The type of the object and then its virtual function table. The offset is the same for all classes.
+		assembler.move(Registers::CX, MemoryOperand(Registers::AX, -(int)stackjit::OBJECT_HEADER_SIZE));
+		assembler.move(Registers::CX, MemoryOperand(Registers::CX, classType->virtualFunctionTableOffset()));
+		assembler.move(
+			ExtendedRegisters::R12,
+			MemoryOperand(Registers::CX, virtualFunctionIndex * (int)sizeof(BytePtr)));
+	}
+
+	void CodeGenerator::generateVirtualCallCache(Amd64Assembler& assembler, const ClassType* classType, int virtualFunctionIndex) {
+		mVirtualCallCaches.emplace_back(virtualFunctionIndex);
+		auto& cache = mVirtualCallCaches.back();
+
+		//CX = the type of the object
+		assembler.move(Registers::CX, MemoryOperand(Registers::AX, -(int)stackjit::OBJECT_HEADER_SIZE));
+		assembler.moveLong(ExtendedRegisters::R11, (PtrValue)&cache);
+
+		//Compare the type with the cached types. Unused entries are null, which never matches.
+		std::vector<std::size_t> hitJumps;
+		for (int i = 0; i < VirtualCallCache::SIZE; i++) {
+			assembler.move(Registers::DX, MemoryOperand(ExtendedRegisters::R11, VirtualCallCache::typeOffset(i)));
+			assembler.compare(Registers::CX, Registers::DX);
+			std::size_t missJump = assembler.size();
+			assembler.jump(JumpCondition::NotEqual, 0);
+
+			assembler.move(ExtendedRegisters::R12, MemoryOperand(ExtendedRegisters::R11, VirtualCallCache::targetOffset(i)));
+			hitJumps.push_back(assembler.size());
+			assembler.jump(JumpCondition::Always, 0);
+
+			Helpers::setValue(assembler.data(), missJump + 2, (int)(assembler.size() - missJump - 6));
+		}
+
+		//When the cache is full, the function is loaded from the virtual function table
+		assembler.move(Registers::DX, MemoryOperand(ExtendedRegisters::R11, VirtualCallCache::typeOffset(VirtualCallCache::SIZE - 1)));
+		assembler.bitwiseXor(ExtendedRegisters::R10, ExtendedRegisters::R10);
+		assembler.compare(Registers::DX, ExtendedRegisters::R10);
+		std::size_t notFullJump = assembler.size();
+		assembler.jump(JumpCondition::Equal, 0);
+
+		generateVirtualFunctionLoad(assembler, classType, virtualFunctionIndex);
+		hitJumps.push_back(assembler.size());
+		assembler.jump(JumpCondition::Always, 0);
+
+		Helpers::setValue(assembler.data(), notFullJump + 2, (int)(assembler.size() - notFullJump - 6));
+
+		//The runtime resolves the function and updates the cache
+		assembler.move(RegisterCallArguments::Arg0, Registers::AX);
+		assembler.moveLong(RegisterCallArguments::Arg1, (PtrValue)&cache);
+		generateCall(assembler, (BytePtr)&Runtime::virtualCallCacheMiss);
+		assembler.move(ExtendedRegisters::R12, RegisterCallArguments::ReturnValue);
+
+		for (auto jump : hitJumps) {
+			Helpers::setValue(assembler.data(), jump + 1, (int)(assembler.size() - jump - 5));
+		}
+	}
+
+	bool CodeGenerator::useInlineAllocation(const VMState& vmState) const {
+		//The runtime prints the allocations
+		return !(vmState.config.enableDebug && vmState.config.printAllocation);
+	}
+
+	void CodeGenerator::generateCollectionCheck(VMState& vmState, Amd64Assembler& assembler) {
+		auto& generation = vmState.gc().youngGeneration();
+
+		if (vmState.config.allocationsBeforeGC >= 0) {
+			//numAllocated >= allocatedBeforeCollection
+			assembler.moveLong(Registers::AX, (PtrValue)generation.numAllocatedPtr());
+			assembler.move(Registers::DX, MemoryOperand(Registers::AX));
+			assembler.moveLong(Registers::AX, (std::int64_t)generation.allocatedBeforeCollection());
+		} else {
+			//nextAllocation >= allocationLimit
+			assembler.moveLong(Registers::AX, (PtrValue)generation.heap().nextAllocationPtr());
+			assembler.move(Registers::DX, MemoryOperand(Registers::AX));
+			assembler.moveLong(Registers::AX, (PtrValue)generation.allocationLimitPtr());
+			assembler.move(Registers::AX, MemoryOperand(Registers::AX));
+		}
+
+		assembler.compare(Registers::DX, Registers::AX);
+	}
+
+	std::vector<std::size_t> CodeGenerator::generateInlineAllocation(VMState& vmState, Amd64Assembler& assembler, const Type* type) {
+		auto& generation = vmState.gc().youngGeneration();
+		std::vector<std::size_t> slowPathJumps;
+
+		//When collecting by bytes, the allocation limit below is the collection check
+		if (!vmState.config.disableGC && vmState.config.allocationsBeforeGC >= 0) {
+			generateCollectionCheck(vmState, assembler);
+			slowPathJumps.push_back(assembler.size());
+			assembler.jump(JumpCondition::GreaterThanOrEqual, 0, true);
+		}
+
+		//CX = nextAllocation + size, which must not be after the allocation limit
+		assembler.moveLong(ExtendedRegisters::R10, (PtrValue)generation.heap().nextAllocationPtr());
+		assembler.move(Registers::AX, MemoryOperand(ExtendedRegisters::R10));
+		assembler.add(Registers::CX, Registers::AX);
+		assembler.moveLong(Registers::DX, (PtrValue)generation.allocationLimitPtr());
+		assembler.move(Registers::DX, MemoryOperand(Registers::DX));
+		assembler.compare(Registers::CX, Registers::DX);
+		slowPathJumps.push_back(assembler.size());
+		assembler.jump(JumpCondition::GreaterThan, 0, true);
+
+		//Bump the allocation pointer and count the allocation
+		assembler.move(MemoryOperand(ExtendedRegisters::R10), Registers::CX);
+		assembler.moveLong(ExtendedRegisters::R11, (PtrValue)generation.numAllocatedPtr());
+		assembler.move(Registers::DX, MemoryOperand(ExtendedRegisters::R11));
+		assembler.add(Registers::DX, 1);
+		assembler.move(MemoryOperand(ExtendedRegisters::R11), Registers::DX);
+
+		//Set the type in the header. As the heap is zeroed, so is the GC info and the data.
+		assembler.moveLong(Registers::CX, (PtrValue)type);
+		assembler.move(MemoryOperand(Registers::AX), Registers::CX);
+		assembler.add(Registers::AX, (int)stackjit::OBJECT_HEADER_SIZE);
+		return slowPathJumps;
+	}
+
 	void CodeGenerator::addCardMarking(const VMState& vmState, Amd64Assembler& assembler, Registers objectRegister) {
 		auto& generation = vmState.gc().oldGeneration();
 
 		if (generation.numCards() > 0) {
-			//First check if the object is inside the correct generation
-			BytePtr heapStart = generation.heap().start();
-			BytePtr heapEnd = generation.heap().end();
-
-			//heapStart <= AX
-			assembler.moveLong(Registers::CX, (std::int64_t)heapStart);
-			assembler.compare(Registers::CX, objectRegister);
-			std::size_t firstJump = assembler.data().size();
-			assembler.jump(JumpCondition::GreaterThan, 0, true);
-
-			//heapEnd >= AX
-			assembler.moveLong(Registers::CX, (std::int64_t)heapEnd);
-			assembler.compare(Registers::CX, objectRegister);
-			std::size_t secondJump = assembler.data().size();
-			assembler.jump(JumpCondition::LessThan, 0, true);
-
-			//Inside generation, mark
-//			assembler.move(RegisterCallArguments::Arg0, objectRegister);
-//			generateCall(generatedCode, (BytePtr)&Runtime::markObjectCard);
-
-			//Calculate the card number: AX = (AX - heapStart) / cardSize
-			assembler.moveLong(Registers::CX, (std::int64_t)heapStart);
-			assembler.sub(Registers::AX, Registers::CX);
-			assembler.moveInt(Registers::CX, (std::int32_t)generation.cardSize());
-
-			assembler.signExtend(Registers::CX, DataSize::Size64);
-			assembler.div(Registers::CX, false, true);
-
-			//Mark the card: generation.cardTable()[AX] = 1;
-			assembler.moveLong(Registers::CX, (std::int64_t)generation.cardTable());
-			assembler.add(Registers::AX, Registers::CX);
-			assembler.move(MemoryOperand(Registers::AX), 1);
-
-			//Set the jump targets
-			Helpers::setValue(assembler.data(), firstJump + 2, (int)(assembler.data().size() - firstJump - 6));
-			Helpers::setValue(assembler.data(), secondJump + 2, (int)(assembler.data().size() - secondJump - 6));
+			//The card table covers all the heaps, which means that no check is needed for which heap the object is in.
+			//The cards for the young generation are never read.
+			//Mark the card: biasedCardTable[AX >> cardShift] = 1
+			assembler.shiftRight(objectRegister, (unsigned char)generation.cardShift());
+			assembler.moveLong(Registers::CX, (std::int64_t)generation.biasedCardTable());
+			assembler.add(objectRegister, Registers::CX);
+			assembler.moveByte(MemoryOperand(objectRegister), 1);
+		}
+	}
+
+	void CodeGenerator::addPreWriteBarrier(const VMState& vmState, Amd64Assembler& assembler, Registers slotRegister) {
+		auto concurrentMarker = vmState.gc().concurrentMarker();
+		if (concurrentMarker == nullptr) {
+			return;
+		}
+
+		std::vector<std::size_t> skipJumps;
+		auto skipIf = [&](JumpCondition condition, bool unsignedComparison) {
+			skipJumps.push_back(assembler.size());
+			assembler.jump(condition, 0, unsignedComparison);
+		};
+
+		//The next entry of the log is null when not marking
+		assembler.moveLong(ExtendedRegisters::R11, (PtrValue)concurrentMarker->queue());
+		assembler.move(Registers::CX, MemoryOperand(ExtendedRegisters::R11, (int)offsetof(ConcurrentMarker::SATBQueue, next)));
+		assembler.bitwiseXor(ExtendedRegisters::R10, ExtendedRegisters::R10);
+		assembler.compare(Registers::CX, ExtendedRegisters::R10);
+		skipIf(JumpCondition::Equal, false);
+
+		//Mark the slot as modified before it is written: biasedModUnionTable[slot >> cardShift] = 1
+		assembler.move(ExtendedRegisters::R10, slotRegister);
+		assembler.shiftRight(ExtendedRegisters::R10, (unsigned char)vmState.gc().oldGeneration().cardShift());
+		assembler.move(Registers::CX, MemoryOperand(ExtendedRegisters::R11, (int)offsetof(ConcurrentMarker::SATBQueue, biasedModUnionTable)));
+		assembler.add(ExtendedRegisters::R10, Registers::CX);
+		assembler.moveByte(MemoryOperand(ExtendedRegisters::R10), 1);
+
+		//Null references are not logged
+		assembler.move(ExtendedRegisters::R10, MemoryOperand(slotRegister));
+		assembler.bitwiseXor(Registers::CX, Registers::CX);
+		assembler.compare(ExtendedRegisters::R10, Registers::CX);
+		skipIf(JumpCondition::Equal, false);
+
+		//Log the reference unless the log is full, which makes the marking start over when finished.
+		//DX holds the value to store, and is saved as another register is needed.
+		assembler.move(Registers::CX, MemoryOperand(ExtendedRegisters::R11, (int)offsetof(ConcurrentMarker::SATBQueue, next)));
+		assembler.push(Registers::DX);
+		assembler.move(Registers::DX, MemoryOperand(ExtendedRegisters::R11, (int)offsetof(ConcurrentMarker::SATBQueue, end)));
+		assembler.compare(Registers::CX, Registers::DX);
+		assembler.pop(Registers::DX);
+		skipIf(JumpCondition::GreaterThanOrEqual, true);
+
+		assembler.move(MemoryOperand(Registers::CX), ExtendedRegisters::R10);
+		assembler.add(Registers::CX, (int)sizeof(PtrValue));
+		assembler.move(MemoryOperand(ExtendedRegisters::R11, (int)offsetof(ConcurrentMarker::SATBQueue, next)), Registers::CX);
+
+		for (auto jump : skipJumps) {
+			Helpers::setValue(assembler.data(), jump + 2, (int)(assembler.size() - jump - 6));
+		}
+	}
+
+	void CodeGenerator::generateFunctionCall(VMState& vmState,
+											 FunctionCompilationData& functionData,
+											 const Instruction& instruction,
+											 int instructionIndex) {
+		auto& function = functionData.function;
+		auto& operandStack = functionData.operandStack;
+		auto& assembler = functionData.assembler;
+
+		//The called function may inspect the stack frame
+		operandStack.spillAll();
+
+		std::string calledSignature = "";
+
+		if (!instruction.isCallInstance()) {
+			calledSignature = FunctionSignature::function(
+				instruction.stringValue,
+				instruction.parameters).str();
+		} else {
+			calledSignature = FunctionSignature::memberFunction(
+				instruction.classType,
+				instruction.stringValue,
+				instruction.parameters).str();
+		}
+
+		const auto& funcToCall = vmState.binder().getFunction(calledSignature);
+
+		if (mMacros.count(calledSignature) == 0) {
+			bool needsToCompile = compileAtRuntime(vmState, funcToCall, calledSignature);
+			std::size_t callIndex = 0;
+			std::size_t checkStart = assembler.size();
+			std::size_t checkEnd = assembler.size();
+
+			//Check if the called function needs to be compiled
+			if (needsToCompile && !funcToCall.isVirtual()) {
+				callIndex = generateCompileCall(assembler, function, funcToCall);
+				checkEnd = assembler.size();
+			}
+
+			//Check that the stack has room for the called function
+			generateStackOverflowCheck(vmState, functionData);
+
+			MemoryOperand firstArgOffset(
+				Registers::BP,
+				operandStack.getStackOperandOffset(operandStack.topIndex() - (int)funcToCall.numParameters() + 1));
+
+			//Add null check
+			if (instruction.isCallInstance()) {
+				assembler.move(Registers::AX, firstArgOffset);
+				mExceptionHandling.addNullCheck(functionData, Registers::AX);
+			}
+
+			//Get the address of the function to call
+			BytePtr funcAddress = nullptr;
+
+			//Handle virtual calls
+			if (funcToCall.isManaged() && funcToCall.isVirtual()) {
+				auto index = funcToCall.classType()->metadata()->getVirtualFunctionIndex(funcToCall);
+
+				if (vmState.config.cacheVirtualCalls) {
+					generateVirtualCallCache(assembler, funcToCall.classType(), index);
+				} else {
+					generateVirtualFunctionLoad(assembler, funcToCall.classType(), index);
+				}
+			}
+
+			//Align the stack
+			int stackAlignment = mCallingConvention.calculateStackAlignment(functionData, funcToCall);
+			if (stackAlignment > 0) {
+				assembler.add(Registers::SP, -stackAlignment);
+			}
+
+			//Set the function arguments
+			mCallingConvention.callFunctionArguments(functionData, funcToCall);
+
+			//Shadow stack size may be needed
+			int shadowStack = mCallingConvention.calculateShadowStackSize();
+			if (shadowStack > 0) {
+				assembler.sub(Registers::SP, shadowStack);
+			}
+
+			if (funcToCall.isManaged() && !funcToCall.isVirtual()) {
+				if (!needsToCompile) {
+					//Mark that the function call needs to be patched with the entry point later
+					functionData.unresolvedCalls.push_back(
+						UnresolvedFunctionCall(
+							FunctionCallType::Relative,
+							assembler.size(),
+							funcToCall));
+				} else {
+					Helpers::setValue(assembler.data(), callIndex, (int)assembler.size());
+
+					if (functionData.countForTierUp) {
+						functionData.lazyCalls.push_back(LazyFunctionCall(assembler.size(), checkStart, checkEnd, funcToCall));
+					}
+				}
+
+				//Make the call
+				assembler.call(0);
+				addCallSite(functionData, instructionIndex);
+			} else if (funcToCall.isManaged() && funcToCall.isVirtual()) {
+				//Make the virtual call
+				assembler.call(ExtendedRegisters::R12);
+				addCallSite(functionData, instructionIndex);
+			} else {
+				//Unmanaged functions are located beyond one int, direct addressing must be used.
+				//Check if the function entry point is defined yet
+				if (funcToCall.entryPoint() != 0) {
+					funcAddress = funcToCall.entryPoint();
+				} else {
+					//Mark that the function call needs to be patched with the entry point later
+					functionData.unresolvedCalls.push_back(
+						UnresolvedFunctionCall(
+							FunctionCallType::Absolute,
+							assembler.size(),
+							funcToCall));
+				}
+
+				//Make the call
+				generateCall(assembler, funcAddress, Registers::AX, false);
+			}
+
+			//Unalign the stack
+			if (stackAlignment + shadowStack > 0) {
+				assembler.add(Registers::SP, stackAlignment + shadowStack);
+			}
+
+			//Push the result
+			mCallingConvention.handleReturnValue(functionData, funcToCall);
+		} else {
+			//Invoke the macro function
+			mMacros[calledSignature]({
+				vmState,
+				mCallingConvention,
+				mExceptionHandling,
+				functionData,
+				instruction,
+				instructionIndex
+			});
 		}
 	}
 
@@ -223,9 +592,28 @@ namespace stackjit {
 		auto& assembler = functionData.assembler;
 		const int stackOffset = 1; //The offset for variables allocated on the stack
 
+		//Branch targets expect all operands to be in the stack frame
+		if (functionData.branchTargets.count(instructionIndex) > 0) {
+			operandStack.spillAll();
+		}
+
+		//Initialize the locals that are allocated to registers. The only way to enter a live interval is at its start.
+		for (std::size_t i = 0; i < function.numLocals(); i++) {
+			auto localRegister = function.getLocalRegister(i);
+			if (localRegister.isAllocated() && localRegister.start == instructionIndex) {
+				auto reg = VARIABLE_REGISTERS[localRegister.registerIndex];
+				assembler.bitwiseXor(reg, reg);
+			}
+		}
+
 		//Make the mapping
 		functionData.instructionNumMapping.push_back((int)assembler.size());
 
+		//Count the loop iterations. The operands are in the stack frame as loop headers are branch targets.
+		if (functionData.countForTierUp && functionData.loopHeaders.count(instructionIndex) > 0) {
+			generateTierUpCheck(assembler, function, function.backedgeCounter(), instructionIndex);
+		}
+
 		switch (instruction.opCode()) {
 			case OpCodes::NOP:
 				assembler.data().push_back(0x90); //nop
@@ -262,8 +650,8 @@ namespace stackjit {
 					operandStack.popReg(Registers::CX);
 					operandStack.popReg(Registers::AX);
 				} else if (floatOp) {
-					operandStack.popReg(FloatRegisters::XMM0);
 					operandStack.popReg(FloatRegisters::XMM1);
+					operandStack.popReg(FloatRegisters::XMM0);
 				}
 
 				//Apply the operator
@@ -346,7 +734,7 @@ namespace stackjit {
 				break;
 			case OpCodes::CONVERT_INT_TO_FLOAT:
 				operandStack.popReg(Registers::AX);
-				assembler.convert(FloatRegisters::XMM0, Registers::AX);
+				assembler.convert(FloatRegisters::XMM0, Registers::AX, true);
 				operandStack.pushReg(FloatRegisters::XMM0);
 				break;
 			case OpCodes::CONVERT_FLOAT_TO_INT:
@@ -432,9 +820,17 @@ namespace stackjit {
 			case OpCodes::STORE_LOCAL: {
 				int localOffset = (stackOffset + instruction.intValue + (int)function.def().numParameters())
 								  * -Amd64Backend::REGISTER_SIZE;
-				if (instruction.opCode() == OpCodes::LOAD_LOCAL) {
-					assembler.move(Registers::AX, { Registers::BP, localOffset });
-					operandStack.pushReg(Registers::AX);
+				auto localRegister = function.getLocalRegister((std::size_t)instruction.intValue);
+
+				if (localRegister.isAllocated()) {
+					auto reg = VARIABLE_REGISTERS[localRegister.registerIndex];
+					if (instruction.opCode() == OpCodes::LOAD_LOCAL) {
+						operandStack.pushReg(reg);
+					} else {
+						operandStack.popReg(reg);
+					}
+				} else if (instruction.opCode() == OpCodes::LOAD_LOCAL) {
+					operandStack.pushMemory({ Registers::BP, localOffset });
 				} else {
 					operandStack.popReg(Registers::AX);
 					assembler.move({ Registers::BP, localOffset }, Registers::AX);
@@ -444,130 +840,14 @@ namespace stackjit {
 			case OpCodes::CALL:
 			case OpCodes::CALL_INSTANCE:
 			case OpCodes::CALL_VIRTUAL: {
-				std::string calledSignature = "";
-
-				if (!instruction.isCallInstance()) {
-					calledSignature = FunctionSignature::function(
-						instruction.stringValue,
-						instruction.parameters).str();
-				} else {
-					calledSignature = FunctionSignature::memberFunction(
-						instruction.classType,
-						instruction.stringValue,
-						instruction.parameters).str();
-				}
-
-				const auto& funcToCall = vmState.binder().getFunction(calledSignature);
-
-				if (mMacros.count(calledSignature) == 0) {
-					bool needsToCompile = compileAtRuntime(vmState, funcToCall, calledSignature);
-					std::size_t callIndex = 0;
-
-					//Check if the called function needs to be compiled
-					if (needsToCompile && !funcToCall.isVirtual()) {
-						callIndex = generateCompileCall(assembler, function, funcToCall);
-					}
-
-					//Push the call
-					pushFunc(vmState, functionData, instructionIndex, assembler);
-
-					MemoryOperand firstArgOffset(
-						Registers::BP,
-						operandStack.getStackOperandOffset(operandStack.topIndex() - (int)funcToCall.numParameters() + 1));
-
-					//Add null check
-					if (instruction.isCallInstance()) {
-						assembler.move(Registers::AX, firstArgOffset);
-						mExceptionHandling.addNullCheck(functionData, Registers::AX);
-					}
-
-					//Get the address of the function to call
-					BytePtr funcAddress = nullptr;
-
-					//Handle virtual calls
-					if (funcToCall.isManaged() && funcToCall.isVirtual()) {
-						assembler.move(RegisterCallArguments::Arg0, firstArgOffset);
-						assembler.moveInt(RegisterCallArguments::Arg1, funcToCall.classType()->metadata()->getVirtualFunctionIndex(funcToCall));
-						generateCall(assembler, (BytePtr)&Runtime::getVirtualFunctionAddress);
-						assembler.move(ExtendedRegisters::R12, RegisterCallArguments::ReturnValue);
-					}
-
-					//Align the stack
-					int stackAlignment = mCallingConvention.calculateStackAlignment(functionData, funcToCall);
-					if (stackAlignment > 0) {
-						assembler.add(Registers::SP, -stackAlignment);
-					}
-
-					//Set the function arguments
-					mCallingConvention.callFunctionArguments(functionData, funcToCall);
-
-					//Shadow stack size may be needed
-					int shadowStack = mCallingConvention.calculateShadowStackSize();
-					if (shadowStack > 0) {
-						assembler.sub(Registers::SP, shadowStack);
-					}
-
-					if (funcToCall.isManaged() && !funcToCall.isVirtual()) {
-						if (!needsToCompile) {
-							//Mark that the function call needs to be patched with the entry point later
-							functionData.unresolvedCalls.push_back(
-								UnresolvedFunctionCall(
-									FunctionCallType::Relative,
-									assembler.size(),
-									funcToCall));
-						} else {
-							Helpers::setValue(assembler.data(), callIndex, (int)assembler.size());
-						}
-
-						//Make the call
-						assembler.call(0);
-					} else if (funcToCall.isManaged() && funcToCall.isVirtual()) {
-						//Make the virtual call
-						assembler.call(ExtendedRegisters::R12);
-					} else {
-						//Unmanaged functions are located beyond one int, direct addressing must be used.
-						//Check if the function entry point is defined yet
-						if (funcToCall.entryPoint() != 0) {
-							funcAddress = funcToCall.entryPoint();
-						} else {
-							//Mark that the function call needs to be patched with the entry point later
-							functionData.unresolvedCalls.push_back(
-								UnresolvedFunctionCall(
-									FunctionCallType::Absolute,
-									assembler.size(),
-									funcToCall));
-						}
-
-						//Make the call
-						generateCall(assembler, funcAddress, Registers::AX, false);
-					}
-
-					//Unalign the stack
-					if (stackAlignment + shadowStack > 0) {
-						assembler.add(Registers::SP, stackAlignment + shadowStack);
-					}
-
-					//Push the result
-					mCallingConvention.handleReturnValue(functionData, funcToCall);
-
-					//Pop the call
-					popFunc(vmState, assembler);
-				} else {
-					//Invoke the macro function
-					mMacros[calledSignature]({
-						vmState,
-						mCallingConvention,
-						mExceptionHandling,
-						functionData,
-						instruction,
-						instructionIndex
-					});
-				}
+				generateFunctionCall(vmState, functionData, instruction, instructionIndex);
 				break;
 			}
 			case OpCodes::RET: {
 				//If debug is enabled, print the stack frame before return
 				if (vmState.config.enableDebug && vmState.config.printStackFrame) {
+					operandStack.spillAll();
+					moveVariableRegisters(assembler, function, instructionIndex, true);
 					assembler.move(RegisterCallArguments::Arg0, Registers::BP);
 					assembler.moveLong(RegisterCallArguments::Arg1, (PtrValue)&function);
 					generateCall(assembler, (BytePtr)&Runtime::printStackFrame);
@@ -575,6 +855,13 @@ namespace stackjit {
 
 				mCallingConvention.makeReturnValue(functionData);
 
+				//Restore the registers used by the variables
+				for (int i = 0; i < ManagedFunction::NUM_VARIABLE_REGISTERS; i++) {
+					if (function.usesRegister(i)) {
+						assembler.move(VARIABLE_REGISTERS[i], { Registers::BP, function.registerSaveSlotOffset(i) });
+					}
+				}
+
 				//Restore the base pointer
 				assembler.move(Registers::SP, Registers::BP);
 				assembler.pop(Registers::BP);
@@ -584,16 +871,17 @@ namespace stackjit {
 				break;
 			}
 			case OpCodes::LOAD_ARG: {
-				//Load rax with the argument
-				assembler.move(
-					Registers::AX,
-					{ Registers::BP, (instruction.intValue + stackOffset) * -Amd64Backend::REGISTER_SIZE });
-
-				//Push the loaded value
-				operandStack.pushReg(Registers::AX);
+				//Push the argument
+				auto argumentRegister = function.getArgumentRegister((std::size_t)instruction.intValue);
+				if (argumentRegister.isAllocated()) {
+					operandStack.pushReg(VARIABLE_REGISTERS[argumentRegister.registerIndex]);
+				} else {
+					operandStack.pushMemory({ Registers::BP, (instruction.intValue + stackOffset) * -Amd64Backend::REGISTER_SIZE });
+				}
 				break;
 			}
 			case OpCodes::BRANCH: {
+				operandStack.spillAll();
 				assembler.jump(JumpCondition::Always, 0);
 
 				//As the exact target in native instructions isn't known, defer to later.
@@ -626,6 +914,9 @@ namespace stackjit {
 					unsignedComparison = true;
 				}
 
+				//Moves do not modify the flags, so the operands can be spilled after the comparison
+				operandStack.spillAll();
+
 				JumpCondition condition = JumpCondition::Always;
 				switch (instruction.opCode()) {
 					case OpCodes::BRANCH_EQUAL:
@@ -667,6 +958,47 @@ namespace stackjit {
 				auto arrayType = static_cast<const ArrayType*>(
 						vmState.typeProvider().getType(TypeSystem::arrayTypeName(elementType)));
 
+				//The GC scans the stack frame
+				operandStack.spillAll();
+
+				std::vector<std::size_t> slowPathJumps;
+				std::size_t fastPathJump = 0;
+				if (useInlineAllocation(vmState)) {
+					//CX = header + length field + length * elementSize. Negative lengths are larger than the heap.
+					assembler.move(
+						Registers::CX,
+						MemoryOperand(Registers::BP, operandStack.getStackOperandOffset(operandStack.topIndex())),
+						DataSize::Size32);
+					assembler.mult(Registers::CX, (int)TypeSystem::sizeOfType(elementType));
+					assembler.add(Registers::CX, (int)(stackjit::OBJECT_HEADER_SIZE + stackjit::ARRAY_LENGTH_SIZE));
+
+					//Large arrays are allocated in the large object space by the runtime
+					std::vector<std::size_t> largeObjectJumps;
+					if (vmState.config.largeObjectSize > 0 && !elementType->isReference()) {
+						assembler.moveLong(Registers::DX, (std::int64_t)vmState.config.largeObjectSize);
+						assembler.compare(Registers::CX, Registers::DX);
+						largeObjectJumps.push_back(assembler.size());
+						assembler.jump(JumpCondition::GreaterThan, 0, true);
+					}
+
+					slowPathJumps = generateInlineAllocation(vmState, assembler, arrayType);
+					slowPathJumps.insert(slowPathJumps.end(), largeObjectJumps.begin(), largeObjectJumps.end());
+
+					//Set the length
+					assembler.move(
+						Registers::CX,
+						MemoryOperand(Registers::BP, operandStack.getStackOperandOffset(operandStack.topIndex())),
+						DataSize::Size32);
+					assembler.move(MemoryOperand(Registers::AX), Registers::CX, DataSize::Size32);
+
+					fastPathJump = assembler.size();
+					assembler.jump(JumpCondition::Always, 0);
+
+					for (auto jump : slowPathJumps) {
+						Helpers::setValue(assembler.data(), jump + 2, (int)(assembler.size() - jump - 6));
+					}
+				}
+
 				if (!vmState.config.disableGC) {
 					generateGCCall(assembler.data(), function, instructionIndex);
 				}
@@ -683,6 +1015,10 @@ namespace stackjit {
 				//Call the newArray runtime function
 				generateCall(assembler, (BytePtr)&Runtime::newArray);
 
+				if (!slowPathJumps.empty()) {
+					Helpers::setValue(assembler.data(), fastPathJump + 1, (int)(assembler.size() - fastPathJump - 5));
+				}
+
 				//Push the returned pointer
 				operandStack.pushReg(Registers::AX);
 				break;
@@ -704,6 +1040,10 @@ namespace stackjit {
 				assembler.add(Registers::AX, ExtendedRegisters::R10);
 				assembler.add(Registers::AX, stackjit::ARRAY_LENGTH_SIZE);
 
+				if (elementType->isReference()) {
+					addPreWriteBarrier(vmState, assembler, Registers::AX);
+				}
+
 				//Store the element
 				auto elementDataSize = sizeOf(elementType);
 				MemoryOperand elementOffset(Registers::AX);
@@ -713,7 +1053,7 @@ namespace stackjit {
 					assembler.move(elementOffset, Register8Bits::DL);
 				}
 
-				if (elementType->isReference()) {
+				if (elementType->isReference() && functionData.elidedWriteBarriers.count(instructionIndex) == 0) {
 					addCardMarking(vmState, assembler, Registers::AX);
 				}
 				break;
@@ -762,15 +1102,11 @@ namespace stackjit {
 			case OpCodes::NEW_OBJECT: {
 				auto classType = instruction.classType;
 
-				//Call the garbageCollect runtime function
-				if (!vmState.config.disableGC) {
-					generateGCCall(assembler.data(), function, instructionIndex);
-				}
-
-				//Push the call
-				pushFunc(vmState, functionData, instructionIndex, assembler);
+				//The GC scans the stack frame
+				operandStack.spillAll();
 
-				//Check if the constructor needs to be compiled
+				//Check if the constructor needs to be compiled. This is done before the allocation, as the compile call
+				//doesn't preserve the reference.
 				auto calledSignature = FunctionSignature::memberFunction(
 					instruction.classType,
 					instruction.stringValue,
@@ -778,19 +1114,56 @@ namespace stackjit {
 
 				const auto& constructorToCall = vmState.binder().getFunction(calledSignature);
 
-				bool needsToCompile = compileAtRuntime(vmState, constructorToCall, calledSignature);
+				bool needsToCompile = instruction.callConstructor
+									  && compileAtRuntime(vmState, constructorToCall, calledSignature);
 				std::size_t callIndex = 0;
 				if (needsToCompile) {
 					callIndex = generateCompileCall(assembler, function, constructorToCall);
 				}
 
+				//Allocate the object. The GC needs to be called before the constructor is pushed to the call stack.
+				std::vector<std::size_t> slowPathJumps;
+				std::size_t fastPathJump = 0;
+				if (useInlineAllocation(vmState)) {
+					assembler.moveInt(
+						Registers::CX,
+						(int)(stackjit::OBJECT_HEADER_SIZE + classType->metadata()->size()));
+
+					slowPathJumps = generateInlineAllocation(vmState, assembler, classType);
+
+					fastPathJump = assembler.size();
+					assembler.jump(JumpCondition::Always, 0);
+
+					for (auto jump : slowPathJumps) {
+						Helpers::setValue(assembler.data(), jump + 2, (int)(assembler.size() - jump - 6));
+					}
+				}
+
+				//Call the garbageCollect runtime function
+				if (!vmState.config.disableGC) {
+					generateGCCall(assembler.data(), function, instructionIndex);
+				}
+
 				//Call the newClass runtime function
 				assembler.moveLong(RegisterCallArguments::Arg0, (PtrValue)classType); //The pointer to the type
 				generateCall(assembler, (BytePtr)&Runtime::newClass);
 
+				if (!slowPathJumps.empty()) {
+					Helpers::setValue(assembler.data(), fastPathJump + 1, (int)(assembler.size() - fastPathJump - 5));
+				}
+
+				//If the constructor has been inlined, only the object is allocated
+				if (!instruction.callConstructor) {
+					operandStack.pushReg(Registers::AX);
+					break;
+				}
+
 				//Save the reference
 				assembler.move(ExtendedRegisters::R10, Registers::AX);
 
+				//Check that the stack has room for the constructor
+				generateStackOverflowCheck(vmState, functionData);
+
 				//Align the stack
 				int stackAlignment = mCallingConvention.calculateStackAlignment(functionData, constructorToCall);
 				if (stackAlignment > 0) {
@@ -798,7 +1171,7 @@ namespace stackjit {
 				}
 
 				//Set the constructor arguments
-				assembler.move(RegisterCallArguments::Arg0, Registers::AX);
+				assembler.move(RegisterCallArguments::Arg0, ExtendedRegisters::R10);
 				int numArgs = (int)constructorToCall.parameters().size() - 1;
 
 				for (int i = numArgs - 1; i >= 0; i--) {
@@ -809,9 +1182,9 @@ namespace stackjit {
 						constructorToCall);
 				}
 
-				//Push the reference to the created object
+				//Push the reference to the created object. As the arguments are in registers, it can't be cached.
 				assembler.move(Registers::AX, ExtendedRegisters::R10);
-				operandStack.pushReg(Registers::AX);
+				operandStack.pushReg(Registers::AX, false);
 
 				//Shadow stack may be needed
 				int shadowStack = mCallingConvention.calculateShadowStackSize();
@@ -832,6 +1205,7 @@ namespace stackjit {
 
 				//Call the constructor
 				assembler.call(0);
+				addCallSite(functionData, instructionIndex);
 
 				//Unalign the stack
 				if (stackAlignment + shadowStack > 0) {
@@ -840,9 +1214,6 @@ namespace stackjit {
 
 				//This is for clean up after a call, as the constructor returns nothing.
 				mCallingConvention.handleReturnValue(functionData, constructorToCall);
-
-				//Pop the call
-				popFunc(vmState, assembler);
 				break;
 			}
 			case OpCodes::LOAD_FIELD:
@@ -886,6 +1257,19 @@ namespace stackjit {
 					//Null check
 					mExceptionHandling.addNullCheck(functionData);
 
+					//The barriers need the address of the field, as it can be in another card than the start of the object
+					bool cardMarking = field.type()->isReference() && functionData.elidedWriteBarriers.count(instructionIndex) == 0;
+					bool preWriteBarrier = field.type()->isReference() && functionData.elidedPreWriteBarriers.count(instructionIndex) == 0;
+
+					if (cardMarking || (preWriteBarrier && vmState.gc().concurrentMarker() != nullptr)) {
+						assembler.add(Registers::AX, fieldOffset);
+						fieldOffset = 0;
+					}
+
+					if (preWriteBarrier) {
+						addPreWriteBarrier(vmState, assembler, Registers::AX);
+					}
+
 					//Store the field
 					MemoryOperand fieldMemoryOperand(Registers::AX, fieldOffset);
 					if (fieldDataSize != DataSize::Size8) {
@@ -895,15 +1279,30 @@ namespace stackjit {
 					}
 
 					//Card marking
-					if (field.type()->isReference()) {
+					if (cardMarking) {
 						addCardMarking(vmState, assembler, Registers::AX);
 					}
 				}
 				break;
 			}
 			case OpCodes::LOAD_STRING: {
+				//The GC scans the stack frame
+				operandStack.spillAll();
+
 				if (!vmState.config.disableGC) {
+					//The runtime is only called when a collection is due
+					std::size_t skipJump = 0;
+					if (useInlineAllocation(vmState)) {
+						generateCollectionCheck(vmState, assembler);
+						skipJump = assembler.size();
+						assembler.jump(JumpCondition::LessThan, 0, true);
+					}
+
 					generateGCCall(assembler.data(), function, instructionIndex);
+
+					if (useInlineAllocation(vmState)) {
+						Helpers::setValue(assembler.data(), skipJump + 2, (int)(assembler.size() - skipJump - 6));
+					}
 				}
 
 				//The pointer to the string as the first arg
@@ -3,9 +3,12 @@
 #include "../../core/function.h"
 #include "../binder.h"
 #include "amd64assembler.h"
+#include "../../runtime/inlinecache.h"
 #include <string>
 #include <functional>
 #include <unordered_map>
+#include <deque>
+#include <vector>
 
 namespace stackjit {
 	struct FunctionCompilationData;
@@ -16,6 +19,9 @@ namespace stackjit {
 	class ManagedFunction;
 	class ExceptionHandling;
 	class FunctionDefinition;
+	class Type;
+	class ClassMetadata;
+	class ClassType;
 
 	//Represents context for a macro function
 	struct MacroFunctionContext {
@@ -46,6 +52,7 @@ namespace stackjit {
 		const CallingConvention& mCallingConvention;
 		const ExceptionHandling& mExceptionHandling;
 		std::unordered_map<std::string, MacroFunction> mMacros;
+		std::deque<VirtualCallCache> mVirtualCallCaches;
 
 		//Indicates if the given function needs to be compiled at runtime
 		bool compileAtRuntime(const VMState& vmState, const FunctionDefinition& funcToCall, std::string funcSignature);
@@ -59,18 +66,54 @@ namespace stackjit {
 		//Zeroes the locals
 		void generateZeroLocals(ManagedFunction& function, Amd64Assembler& assembler);
 
-		//Pushes a function to the call stack
-		void pushFunc(VMState& vmState, FunctionCompilationData& functionData, int instructionIndex, Amd64Assembler& assembler);
+		//Generates a check that the stack has not overflowed before a call
+		void generateStackOverflowCheck(VMState& vmState, FunctionCompilationData& functionData);
 
-		//Pops a function from the call stack
-		void popFunc(VMState& vmState, Amd64Assembler& assembler);
+		//Adds a call site for the call instruction that was just generated, which lets the stack walker find the caller.
+		//The instruction also becomes a safepoint.
+		void addCallSite(FunctionCompilationData& functionData, int instructionIndex);
 
 		//Prints the given register
 		void printRegister(Amd64Assembler& assembler, IntRegister reg);
 
-		//Adds card marking
+		//Moves the live variables allocated to registers to the stack frame (or back), and the registers not used
+		//by the function to the register save area (or back). This makes the values visible to the GC.
+		void moveVariableRegisters(Amd64Assembler& assembler, const ManagedFunction& function, int instructionIndex, bool toStackFrame);
+
+		//Decrements the given tier up counter, and calls the runtime to recompile the function when it reaches zero.
+		//At loop headers, the execution continues in the optimized code by on-stack replacement.
+		void generateTierUpCheck(Amd64Assembler& assembler, ManagedFunction& function, int& counter, int loopHeader = -1);
+
+		//Generates a load of the given virtual function from the virtual function table of the object in the AX register.
+		//The address of the function to call is in the R12 register.
+		void generateVirtualFunctionLoad(Amd64Assembler& assembler, const ClassType* classType, int virtualFunctionIndex);
+
+		//Generates a lookup in a new inline cache for the virtual function called with the object in the AX register.
+		//When the cache is full, the function is loaded from the virtual function table.
+		//The address of the function to call is in the R12 register.
+		void generateVirtualCallCache(Amd64Assembler& assembler, const ClassType* classType, int virtualFunctionIndex);
+
+		//Indicates if objects are allocated in the generated code
+		bool useInlineAllocation(const VMState& vmState) const;
+
+		//Compares the number of allocations in the young generation with the number of allocations before a collection
+		void generateCollectionCheck(VMState& vmState, Amd64Assembler& assembler);
+
+		//Generates an allocation of an object of the given type in the young generation, where the size of
+		//the object (including the header) is in the CX register. The pointer to the object data is in the AX register.
+		//Returns the offsets of the jumps to the slow path, which are taken if the generation is full or needs to be collected.
+		std::vector<std::size_t> generateInlineAllocation(VMState& vmState, Amd64Assembler& assembler, const Type* type);
+
+		//Marks the card for the reference stored at the address in the given register, which is overwritten
 		void addCardMarking(const VMState& vmState, Amd64Assembler& assembler, Registers objectRegister);
+
+		//Logs the reference that is about to be overwritten at the address in the given register when the old generation
+		//is being marked concurrently. Must be added before the store. Only overwrites CX, R10 and R11.
+		void addPreWriteBarrier(const VMState& vmState, Amd64Assembler& assembler, Registers slotRegister);
 	public:
+		//The size of the area at the start of functions that can tier up, where the jump to the optimized code is written
+		static const int TIER_UP_JUMP_SIZE = 12;
+
 		//Creates a new code generator
 		CodeGenerator(const CallingConvention& callingConvention, const ExceptionHandling& exceptionHandling);
 
@@ -80,9 +123,23 @@ namespace stackjit {
 		//Generates a call to the garbage collect runtime function
 		void generateGCCall(CodeGen& generatedCode, ManagedFunction& function, int instructionIndex, int generation = 0);
 
+		//Generates a stub for the given entry of the virtual function table of the given class. When called,
+		//the stub compiles the function, binds it in the table and jumps to it with the arguments of the call.
+		void generateVirtualFunctionStub(CodeGen& generatedCode, const ClassMetadata* metadata, int index);
+
 		//Generates the instructions for initializing the given function
 		void generateInitializeFunction(FunctionCompilationData& functionData);
 
+		//Replaces the entry of the given baseline code with a jump to the given optimized code
+		void patchTierUpJump(BytePtr baselineCode, BytePtr optimizedCode);
+
+		//Generates a call to the function called by the given instruction.
+		//The arguments are popped from the operand stack, and the return value is pushed.
+		void generateFunctionCall(VMState& vmState,
+								  FunctionCompilationData& functionData,
+								  const Instruction& instruction,
+								  int instructionIndex);
+
 		//Generates native instructions for the given VM instruction
 		void generateInstruction(VMState& vmState,
 								 FunctionCompilationData& functionData,
@@ -1,6 +1,7 @@
 #include "compilationdata.h"
 #include "../../core/function.h"
 #include "../../helpers.h"
+#include "../callingconvention.h"
 
 namespace stackjit {
 	BranchTarget::BranchTarget(unsigned int target, unsigned int instructionSize)
@@ -15,22 +16,54 @@ namespace stackjit {
 
 	}
 
+	LazyFunctionCall::LazyFunctionCall(std::size_t callOffset,
+									   std::size_t checkStart,
+									   std::size_t checkEnd,
+									   const FunctionDefinition& funcToCall)
+		: callOffset(callOffset), checkStart(checkStart), checkEnd(checkEnd), funcToCall(funcToCall) {
+
+	}
+
+	CallSiteOffset::CallSiteOffset(std::size_t returnOffset, int instructionIndex)
+		: returnOffset(returnOffset), instructionIndex(instructionIndex) {
+
+	}
+
 	FunctionCompilationData::FunctionCompilationData(ManagedFunction& function)
 		: function(function), operandStack(function), assembler(function.generatedCode()) {
 
 	}
 
+	OperandEntry::OperandEntry()
+		: location(OperandLocation::Memory), constant(0) {
+
+	}
+
+	OperandEntry::OperandEntry(HardwareRegister hardwareRegister)
+		: location(OperandLocation::Register), hardwareRegister(hardwareRegister), constant(0) {
+
+	}
+
+	OperandEntry::OperandEntry(int constant)
+		: location(OperandLocation::Constant), constant(constant) {
+
+	}
+
 	OperandStack::OperandStack(ManagedFunction& function)
 		: mFunction(function), mAssembler(function.generatedCode()) {
 
 	}
 
+	void OperandStack::enableCache(bool enable) {
+		mEnableCache = enable;
+	}
+
 	int OperandStack::topIndex() const {
-		return mTopIndex;
+		return (int)mEntries.size() - 1;
 	}
 
 	void OperandStack::assertNotEmpty() {
-		if (mTopIndex <= -1) {
+		if (mEntries.empty()) {
 			throw std::runtime_error("The operand stack is empty");
 		}
 	}
@@ -40,56 +73,254 @@ namespace stackjit {
 					  (1 + mFunction.def().numParameters() + mFunction.numLocals() + operandIndex));
 	}
 
+	int OperandStack::findCachedEntry(HardwareRegister hardwareRegister) const {
+		for (int i = 0; i < (int)mEntries.size(); i++) {
+			auto& entry = mEntries[i];
+			if (entry.location == OperandLocation::Register && entry.hardwareRegister == hardwareRegister) {
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	void OperandStack::spill(int operandIndex) {
+		auto& entry = mEntries[operandIndex];
+		MemoryOperand stackOperand(Registers::BP, getStackOperandOffset(operandIndex));
+
+		switch (entry.location) {
+			case OperandLocation::Register:
+				if (entry.hardwareRegister.type() == HardwareRegisterTypes::Int) {
+					mAssembler.move(stackOperand, entry.hardwareRegister.intRegister());
+				} else {
+					mAssembler.move(stackOperand, entry.hardwareRegister.floatRegister());
+				}
+				break;
+			case OperandLocation::Constant:
+				mAssembler.move(stackOperand, entry.constant);
+				break;
+			case OperandLocation::Memory:
+				break;
+		}
+
+		entry = OperandEntry();
+	}
+
+	void OperandStack::evict(HardwareRegister hardwareRegister) {
+		int index = findCachedEntry(hardwareRegister);
+		if (index != -1) {
+			spill(index);
+		}
+	}
+
+	bool OperandStack::isCacheRegister(HardwareRegister hardwareRegister) const {
+		if (hardwareRegister.type() == HardwareRegisterTypes::Int) {
+			for (auto reg : OperandStackCacheRegisters::Int) {
+				if (reg == hardwareRegister.intRegister()) {
+					return true;
+				}
+			}
+		} else {
+			for (auto reg : OperandStackCacheRegisters::Float) {
+				if (reg == hardwareRegister.floatRegister()) {
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	HardwareRegister OperandStack::allocateRegister(HardwareRegisterTypes type) {
+		if (type == HardwareRegisterTypes::Int) {
+			for (auto reg : OperandStackCacheRegisters::Int) {
+				if (findCachedEntry(reg) == -1) {
+					return reg;
+				}
+			}
+		} else {
+			for (auto reg : OperandStackCacheRegisters::Float) {
+				if (findCachedEntry(reg) == -1) {
+					return reg;
+				}
+			}
+		}
+
+		//All registers are used, spill the bottom-most entry of the same type
+		for (int i = 0; i < (int)mEntries.size(); i++) {
+			auto& entry = mEntries[i];
+			if (entry.location == OperandLocation::Register && entry.hardwareRegister.type() == type) {
+				auto reg = entry.hardwareRegister;
+				spill(i);
+				return reg;
+			}
+		}
+
+		throw std::runtime_error("No cache register available");
+	}
+
+	void OperandStack::spillAll() {
+		for (int i = 0; i < (int)mEntries.size(); i++) {
+			spill(i);
+		}
+	}
+
 	void OperandStack::reserveSpace() {
-		mTopIndex++;
+		mEntries.push_back(OperandEntry());
 	}
 
 	void OperandStack::duplicate() {
 		assertNotEmpty();
+		auto top = mEntries.back();
+
+		if (top.location == OperandLocation::Constant) {
+			mEntries.push_back(top);
+		} else if (top.location == OperandLocation::Register) {
+			//As there are at least two cache registers of each type, the top is never spilled here
+			auto reg = allocateRegister(top.hardwareRegister.type());
+
+			if (reg.type() == HardwareRegisterTypes::Int) {
+				mAssembler.move(reg.intRegister(), top.hardwareRegister.intRegister());
+			} else {
+				mAssembler.move(reg.floatRegister(), top.hardwareRegister.floatRegister());
+			}
+
+			mEntries.push_back(OperandEntry(reg));
+		} else {
+			int stackOffset = getStackOperandOffset(topIndex());
 
-		int stackOffset1 = getStackOperandOffset(mTopIndex);
-		int stackOffset2 = getStackOperandOffset(mTopIndex + 1);
-		mAssembler.move(Registers::AX, { Registers::BP, stackOffset1 });
-		mAssembler.move({ Registers::BP, stackOffset2 }, Registers::AX);
-		mTopIndex++;
+			if (mEnableCache) {
+				auto reg = allocateRegister(HardwareRegisterTypes::Int);
+				mAssembler.move(reg.intRegister(), { Registers::BP, stackOffset });
+				mEntries.push_back(OperandEntry(reg));
+			} else {
+				int stackOffset2 = getStackOperandOffset(topIndex() + 1);
+				mAssembler.move(Registers::AX, { Registers::BP, stackOffset });
+				mAssembler.move({ Registers::BP, stackOffset2 }, Registers::AX);
+				mEntries.push_back(OperandEntry());
+			}
+		}
 	}
 
 	void OperandStack::popReg(IntRegister reg) {
 		assertNotEmpty();
+		auto top = mEntries.back();
+		mEntries.pop_back();
 
-		int stackOffset = getStackOperandOffset(mTopIndex);
-		mAssembler.move(reg, { Registers::BP, stackOffset });
-		mTopIndex--;
+		switch (top.location) {
+			case OperandLocation::Memory:
+				evict(reg);
+				mAssembler.move(reg, { Registers::BP, getStackOperandOffset(topIndex() + 1) });
+				break;
+			case OperandLocation::Register:
+				if (top.hardwareRegister.type() == HardwareRegisterTypes::Int) {
+					if (top.hardwareRegister.intRegister() != reg) {
+						evict(reg);
+						mAssembler.move(reg, top.hardwareRegister.intRegister());
+					}
+				} else {
+					evict(reg);
+					mAssembler.move(reg, top.hardwareRegister.floatRegister());
+				}
+				break;
+			case OperandLocation::Constant:
+				evict(reg);
+				mAssembler.moveInt(reg, top.constant);
+				break;
+		}
 	}
 
 	void OperandStack::popReg(FloatRegisters reg) {
 		assertNotEmpty();
+		auto top = mEntries.back();
+		mEntries.pop_back();
+		int stackOffset = getStackOperandOffset(topIndex() + 1);
 
-		int stackOffset = getStackOperandOffset(mTopIndex);
-		mAssembler.move(reg, { Registers::BP, stackOffset });
-		mTopIndex--;
+		switch (top.location) {
+			case OperandLocation::Memory:
+				evict(reg);
+				mAssembler.move(reg, { Registers::BP, stackOffset });
+				break;
+			case OperandLocation::Register:
+				if (top.hardwareRegister.type() == HardwareRegisterTypes::Float) {
+					if (top.hardwareRegister.floatRegister() != reg) {
+						evict(reg);
+						mAssembler.move(reg, top.hardwareRegister.floatRegister());
+					}
+				} else {
+					evict(reg);
+					mAssembler.move(reg, top.hardwareRegister.intRegister());
+				}
+				break;
+			case OperandLocation::Constant:
+				//There is no instruction for moving a constant into a float register, go through the stack frame
+				evict(reg);
+				mAssembler.move({ Registers::BP, stackOffset }, top.constant);
+				mAssembler.move(reg, { Registers::BP, stackOffset });
+				break;
+		}
 	}
 
-	void OperandStack::pushReg(IntRegister reg) {
-		mTopIndex++;
+	void OperandStack::pushRegister(HardwareRegister hardwareRegister, bool allowCache) {
+		if (!mEnableCache || !allowCache) {
+			mEntries.push_back(OperandEntry());
+			MemoryOperand stackOperand(Registers::BP, getStackOperandOffset(topIndex()));
+
+			if (hardwareRegister.type() == HardwareRegisterTypes::Int) {
+				mAssembler.move(stackOperand, hardwareRegister.intRegister());
+			} else {
+				mAssembler.move(stackOperand, hardwareRegister.floatRegister());
+			}
+			return;
+		}
+
+		//If the register can be used for caching and it's not used, just claim it
+		if (isCacheRegister(hardwareRegister) && findCachedEntry(hardwareRegister) == -1) {
+			mEntries.push_back(OperandEntry(hardwareRegister));
+			return;
+		}
 
-		int stackOffset = getStackOperandOffset(mTopIndex);
-		mAssembler.move({ Registers::BP, stackOffset }, reg);
+		auto reg = allocateRegister(hardwareRegister.type());
+		if (reg.type() == HardwareRegisterTypes::Int) {
+			mAssembler.move(reg.intRegister(), hardwareRegister.intRegister());
+		} else {
+			mAssembler.move(reg.floatRegister(), hardwareRegister.floatRegister());
+		}
+
+		mEntries.push_back(OperandEntry(reg));
 	}
 
-	void OperandStack::pushReg(FloatRegisters reg) {
-		mTopIndex++;
+	void OperandStack::pushReg(IntRegister reg, bool allowCache) {
+		pushRegister(reg, allowCache);
+	}
 
-		int stackOffset = getStackOperandOffset(mTopIndex);
-		mAssembler.move({ Registers::BP, stackOffset }, reg);
+	void OperandStack::pushReg(FloatRegisters reg, bool allowCache) {
+		pushRegister(reg, allowCache);
+	}
+
+	void OperandStack::pushMemory(MemoryOperand source) {
+		if (!mEnableCache) {
+			mAssembler.move(Registers::AX, source);
+			pushReg(Registers::AX, false);
+			return;
+		}
+
+		auto reg = allocateRegister(HardwareRegisterTypes::Int);
+		mAssembler.move(reg.intRegister(), source);
+		mEntries.push_back(OperandEntry(reg));
 	}
 
 	void OperandStack::pushInt(int value, bool increaseStack) {
 		if (increaseStack) {
-			mTopIndex++;
+			if (mEnableCache) {
+				mEntries.push_back(OperandEntry(value));
+				return;
+			}
+
+			mEntries.push_back(OperandEntry());
 		}
 
-		int stackOffset = getStackOperandOffset(mTopIndex);
+		int stackOffset = getStackOperandOffset(topIndex());
 		mAssembler.move({ Registers::BP, stackOffset }, value);
 	}
 }
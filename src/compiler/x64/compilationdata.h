@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "amd64.h"
 #include "amd64assembler.h"
 
@@ -35,19 +37,94 @@ namespace stackjit {
 		UnresolvedFunctionCall(FunctionCallType type, std::size_t callOffset, const FunctionDefinition& funcToCall);
 	};
 
-	//Manages the operand stack
+	//Represents a call where the called function is compiled at runtime
+	struct LazyFunctionCall {
+		//The offset for the call instruction
+		const std::size_t callOffset;
+
+		//The start and end of the check that compiles the function
+		const std::size_t checkStart;
+		const std::size_t checkEnd;
+
+		//The function to call
+		const FunctionDefinition& funcToCall;
+
+		//Creates a new lazy function call
+		LazyFunctionCall(std::size_t callOffset, std::size_t checkStart, std::size_t checkEnd, const FunctionDefinition& funcToCall);
+	};
+
+	//Represents a call to a managed function
+	struct CallSiteOffset {
+		//The offset of the instruction after the call, which is the return address
+		const std::size_t returnOffset;
+
+		//The index of the call instruction
+		const int instructionIndex;
+
+		//Creates a new call site offset
+		CallSiteOffset(std::size_t returnOffset, int instructionIndex);
+	};
+
+	//The location of an operand stack entry
+	enum class OperandLocation : unsigned char {
+		Memory,
+		Register,
+		Constant
+	};
+
+	//Represents an entry on the operand stack
+	struct OperandEntry {
+		OperandLocation location;
+		HardwareRegister hardwareRegister;
+		int constant;
+
+		//Creates a new entry stored in memory
+		OperandEntry();
+
+		//Creates a new entry cached in a register
+		OperandEntry(HardwareRegister hardwareRegister);
+
+		//Creates a new entry holding a constant
+		OperandEntry(int constant);
+	};
+
+	//Manages the operand stack.
+	//The top entries can be cached in registers or kept as constants, the cache is written
+	//back to the stack frame when spilled.
 	class OperandStack {
 	private:
 		ManagedFunction& mFunction;
 		Amd64Assembler mAssembler;
-		int mTopIndex = -1;
+		std::vector<OperandEntry> mEntries;
+		bool mEnableCache = false;
 
 		//Asserts that the stack is not empty
 		void assertNotEmpty();
+
+		//Returns the index of the entry cached in the given register, or -1 if not cached
+		int findCachedEntry(HardwareRegister hardwareRegister) const;
+
+		//Writes the given entry to the stack frame
+		void spill(int operandIndex);
+
+		//Spills the entry (if any) that is cached in the given register
+		void evict(HardwareRegister hardwareRegister);
+
+		//Returns a free cache register of the given type, spilling the bottom-most cached entry if none is free
+		HardwareRegister allocateRegister(HardwareRegisterTypes type);
+
+		//Indicates if the given register can be used for caching
+		bool isCacheRegister(HardwareRegister hardwareRegister) const;
+
+		//Pushes the given register to the operand stack
+		void pushRegister(HardwareRegister hardwareRegister, bool allowCache);
 	public:
 		//Creates a new operand stack for the given function
 		OperandStack(ManagedFunction& function);
 
+		//Enables or disables caching of operands
+		void enableCache(bool enable);
+
 		//Returns the index of the top
 		int topIndex() const;
 
@@ -60,13 +137,19 @@ namespace stackjit {
 		//Duplicates the top operand
 		void duplicate();
 
+		//Writes all the cached operands to the stack frame
+		void spillAll();
+
 		//Pops an operand from the operand stack to the given register
 		void popReg(IntRegister reg);
 		void popReg(FloatRegisters reg);
 
-		//Pushes the given register to the operand stack
-		void pushReg(IntRegister reg);
-		void pushReg(FloatRegisters reg);
+		//Pushes the given register to the operand stack. If allowCache is false, the operand is written to the stack frame.
+		void pushReg(IntRegister reg, bool allowCache = true);
+		void pushReg(FloatRegisters reg, bool allowCache = true);
+
+		//Pushes the value of the given memory operand to the operand stack
+		void pushMemory(MemoryOperand source);
 
 		//Pushes the given value to the operand stack
 		void pushInt(int value, bool increaseStack = true);
@@ -90,6 +173,31 @@ namespace stackjit {
 		//Unresolved function calls
 		std::vector<UnresolvedFunctionCall> unresolvedCalls;
 
+		//The calls to managed functions
+		std::vector<CallSiteOffset> callSites;
+
+		//The instructions that are targets of branches
+		std::unordered_set<int> branchTargets;
+
+		//The stores of references that don't need to mark a card, as the stored value is null or the object is young
+		std::unordered_set<int> elidedWriteBarriers;
+
+		//The stores of references that don't need to log the overwritten reference for the concurrent marking,
+		//as the object was allocated after the marking started
+		std::unordered_set<int> elidedPreWriteBarriers;
+
+		//Indicates if the function counts invocations and loop iterations to be recompiled by the optimizing tier
+		bool countForTierUp = false;
+
+		//The instructions that are targets of backward branches
+		std::unordered_set<int> loopHeaders;
+
+		//The lazy calls, which needs to be resolved before the function is recompiled
+		std::vector<LazyFunctionCall> lazyCalls;
+
+		//The offsets of the entries used for on-stack replacement at the loop headers of optimized code
+		std::unordered_map<int, std::size_t> osrEntries;
+
 		//Holds compilation data for the given function
 		FunctionCompilationData(ManagedFunction& function);
 	};
@@ -85,18 +85,19 @@ namespace stackjit {
 		function.unresolvedNativeBranches.insert({ codeGen.size() - 6, (PtrValue)mArrayCreationCheckHandler });
 	}
 
-	void ExceptionHandling::addStackOverflowCheck(FunctionCompilationData& function, PtrValue callStackEnd) const {
+	void ExceptionHandling::addStackOverflowCheck(FunctionCompilationData& function, BytePtr* stackLimitPtr) const {
 		auto& codeGen = function.function.generatedCode();
 		Amd64Assembler assembler(codeGen);
 
-		//Move the end of the call stack to register
-		assembler.moveLong(Registers::CX, callStackEnd);
+		//Move the limit of the stack to register. It is read at runtime, as it depends on the thread running the code.
+		assembler.moveLong(Registers::CX, (PtrValue)stackLimitPtr);
+		assembler.move(Registers::CX, MemoryOperand(Registers::CX));
 
-		//Compare the top and the end of the stack
-		assembler.compare(Registers::AX, Registers::CX);
+		//Compare the stack pointer and the limit
+		assembler.compare(Registers::SP, Registers::CX);
 
 		//Jump to handler if overflow
-		assembler.jump(JumpCondition::GreaterThanOrEqual, 0);
+		assembler.jump(JumpCondition::LessThan, 0);
 		function.unresolvedNativeBranches.insert({ codeGen.size() - 6, (PtrValue)mStackOverflowCheckHandler });
 	}
 }
@@ -32,7 +32,7 @@ namespace stackjit {
 		//Adds an array creation check
 		void addArrayCreationCheck(FunctionCompilationData& function) const;
 
-		//Adds a stack overflow check
-		void addStackOverflowCheck(FunctionCompilationData& function, PtrValue callStackEnd) const;
+		//Adds a check that the stack pointer is above the limit stored at the given address
+		void addStackOverflowCheck(FunctionCompilationData& function, BytePtr* stackLimitPtr) const;
 	};
 }
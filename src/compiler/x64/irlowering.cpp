@@ -0,0 +1,809 @@
+#include "irlowering.h"
+#include "codegenerator.h"
+#include "compilationdata.h"
+#include "amd64assembler.h"
+#include "../callingconvention.h"
+#include "../../vmstate.h"
+#include "../../helpers.h"
+#include "../../core/function.h"
+#include <algorithm>
+#include <climits>
+
+namespace stackjit {
+	namespace {
+		//The types of locations for values
+		enum class LocationType {
+			None,
+			Register,
+			Stack,
+			Constant
+		};
+
+		//Represents the location of a value
+		struct Location {
+			LocationType type = LocationType::None;
+			HardwareRegister hardwareRegister;
+
+			//The offset in the stack frame or the value of a constant
+			int value = 0;
+
+			static Location makeRegister(HardwareRegister hardwareRegister) {
+				Location location;
+				location.type = LocationType::Register;
+				location.hardwareRegister = hardwareRegister;
+				return location;
+			}
+
+			static Location makeStack(int offset) {
+				Location location;
+				location.type = LocationType::Stack;
+				location.value = offset;
+				return location;
+			}
+
+			static Location makeConstant(int value) {
+				Location location;
+				location.type = LocationType::Constant;
+				location.value = value;
+				return location;
+			}
+
+			bool operator==(const Location& rhs) const {
+				if (type != rhs.type) {
+					return false;
+				}
+
+				if (type == LocationType::Register) {
+					return hardwareRegister == rhs.hardwareRegister;
+				}
+
+				return value == rhs.value;
+			}
+		};
+
+		//Represents a move between two locations
+		struct Move {
+			Location destination;
+			Location source;
+		};
+
+		//Represents the live interval of a value
+		struct LiveInterval {
+			const IR::Instruction* value;
+			int start;
+			int end;
+		};
+
+		//Represents a jump that needs to be patched with the address of a block
+		struct BlockJump {
+			std::size_t offset;
+			std::size_t size;
+			const IR::BasicBlock* target;
+		};
+
+		//Represents the moves for an edge that are made after a conditional jump
+		struct EdgeStub {
+			std::size_t jumpOffset;
+			const IR::BasicBlock* from;
+			const IR::BasicBlock* to;
+		};
+
+		//Returns the jump condition for the given condition
+		JumpCondition getJumpCondition(IR::Condition condition) {
+			switch (condition) {
+				case IR::Condition::Equal:
+					return JumpCondition::Equal;
+				case IR::Condition::NotEqual:
+					return JumpCondition::NotEqual;
+				case IR::Condition::GreaterThan:
+					return JumpCondition::GreaterThan;
+				case IR::Condition::GreaterThanOrEqual:
+					return JumpCondition::GreaterThanOrEqual;
+				case IR::Condition::LessThan:
+					return JumpCondition::LessThan;
+				case IR::Condition::LessThanOrEqual:
+					return JumpCondition::LessThanOrEqual;
+			}
+
+			return JumpCondition::Always;
+		}
+
+		//Indicates if the given instruction defines a value that needs a location
+		bool needsLocation(const IR::Instruction* instruction) {
+			return instruction->hasValue() && instruction->opCode() != IR::OpCode::Constant;
+		}
+
+		//Moves the given location to a register
+		void moveToRegister(Amd64Assembler& assembler, HardwareRegister destination, Location source) {
+			bool isFloat = destination.type() == HardwareRegisterTypes::Float;
+
+			switch (source.type) {
+				case LocationType::Constant:
+					if (isFloat) {
+						assembler.moveInt(Registers::AX, source.value);
+						assembler.move(destination.floatRegister(), Registers::AX);
+					} else {
+						assembler.moveInt(destination.intRegister(), source.value);
+					}
+					break;
+				case LocationType::Register: {
+					auto sourceRegister = source.hardwareRegister;
+					if (isFloat) {
+						if (sourceRegister.type() == HardwareRegisterTypes::Float) {
+							assembler.move(destination.floatRegister(), sourceRegister.floatRegister());
+						} else {
+							assembler.move(destination.floatRegister(), sourceRegister.intRegister());
+						}
+					} else {
+						if (sourceRegister.type() == HardwareRegisterTypes::Float) {
+							assembler.move(destination.intRegister(), sourceRegister.floatRegister());
+						} else {
+							assembler.move(destination.intRegister(), sourceRegister.intRegister());
+						}
+					}
+					break;
+				}
+				case LocationType::Stack:
+					if (isFloat) {
+						assembler.move(destination.floatRegister(), MemoryOperand(Registers::BP, source.value));
+					} else {
+						assembler.move(destination.intRegister(), MemoryOperand(Registers::BP, source.value));
+					}
+					break;
+				case LocationType::None:
+					break;
+			}
+		}
+
+		//Moves the given location to the given location
+		void moveLocation(Amd64Assembler& assembler, Location destination, Location source) {
+			if (destination == source) {
+				return;
+			}
+
+			if (destination.type == LocationType::Register) {
+				moveToRegister(assembler, destination.hardwareRegister, source);
+				return;
+			}
+
+			MemoryOperand destinationOperand(Registers::BP, destination.value);
+
+			switch (source.type) {
+				case LocationType::Constant:
+					assembler.move(destinationOperand, source.value);
+					break;
+				case LocationType::Register:
+					if (source.hardwareRegister.type() == HardwareRegisterTypes::Float) {
+						assembler.move(destinationOperand, source.hardwareRegister.floatRegister());
+					} else {
+						assembler.move(destinationOperand, source.hardwareRegister.intRegister());
+					}
+					break;
+				case LocationType::Stack:
+					assembler.move(Registers::AX, MemoryOperand(Registers::BP, source.value));
+					assembler.move(destinationOperand, Registers::AX);
+					break;
+				case LocationType::None:
+					break;
+			}
+		}
+
+		//Performs the given moves as if they were made at the same time
+		void parallelMove(Amd64Assembler& assembler, std::vector<Move> moves) {
+			moves.erase(
+				std::remove_if(moves.begin(), moves.end(), [](const Move& move) {
+					return move.destination == move.source;
+				}),
+				moves.end());
+
+			while (!moves.empty()) {
+				bool madeMove = false;
+
+				for (std::size_t i = 0; i < moves.size(); i++) {
+					bool isBlocked = false;
+					for (std::size_t j = 0; j < moves.size(); j++) {
+						if (i != j && moves[j].source == moves[i].destination) {
+							isBlocked = true;
+							break;
+						}
+					}
+
+					if (!isBlocked) {
+						moveLocation(assembler, moves[i].destination, moves[i].source);
+						moves.erase(moves.begin() + i);
+						madeMove = true;
+						break;
+					}
+				}
+
+				//The remaining moves form cycles. Break one by saving a destination in a temporary register.
+				if (!madeMove) {
+					auto blocked = moves.front().destination;
+					auto temporary = Location::makeRegister(IntRegister(ExtendedRegisters::R11));
+					moveLocation(assembler, temporary, blocked);
+
+					for (auto& move : moves) {
+						if (move.source == blocked) {
+							move.source = temporary;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	IRLowering::IRLowering(const CallingConvention& callingConvention, CodeGenerator& codeGenerator)
+		: mCallingConvention(callingConvention), mCodeGenerator(codeGenerator) {
+
+	}
+
+	void IRLowering::generateFunction(VMState& vmState, FunctionCompilationData& functionData, const IR::Function& irFunction) {
+		auto& function = functionData.function;
+		auto& assembler = functionData.assembler;
+		auto& operandStack = functionData.operandStack;
+		auto& blocks = irFunction.blocks();
+		auto numValues = irFunction.numInstructions();
+
+		//Number the instructions. Each block has a position at the start where the phi functions are defined,
+		//and a position at the end where the moves for the phi functions in the successors are made.
+		std::vector<int> positions(numValues, -1);
+		std::vector<int> blockStart(blocks.size());
+		std::vector<int> blockEnd(blocks.size());
+		std::vector<int> callPositions;
+
+		int position = 0;
+		for (auto block : blocks) {
+			blockStart[block->orderIndex] = position;
+			position += 2;
+
+			for (auto instruction : block->instructions) {
+				if (instruction->opCode() == IR::OpCode::Phi) {
+					positions[instruction->id()] = blockStart[block->orderIndex];
+				} else {
+					positions[instruction->id()] = position;
+
+					if (instruction->opCode() == IR::OpCode::Call) {
+						callPositions.push_back(position);
+					}
+
+					position += 2;
+				}
+			}
+
+			blockEnd[block->orderIndex] = position;
+			position += 2;
+		}
+
+		//Compute the values that are live at the start and end of each block
+		std::vector<std::vector<bool>> liveIn(blocks.size(), std::vector<bool>(numValues, false));
+		std::vector<std::vector<bool>> liveOut(blocks.size(), std::vector<bool>(numValues, false));
+
+		bool changed = true;
+		while (changed) {
+			changed = false;
+
+			for (auto blockIterator = blocks.rbegin(); blockIterator != blocks.rend(); ++blockIterator) {
+				auto block = *blockIterator;
+				std::vector<bool> live(numValues, false);
+
+				for (auto successor : block->successors) {
+					auto& successorLiveIn = liveIn[successor->orderIndex];
+					for (std::size_t i = 0; i < numValues; i++) {
+						if (successorLiveIn[i]) {
+							live[i] = true;
+						}
+					}
+
+					//The operands of phi functions are used at the end of the predecessor
+					auto predecessorIndex = successor->predecessorIndex(block);
+					for (auto instruction : successor->instructions) {
+						if (instruction->opCode() == IR::OpCode::Phi) {
+							auto operand = instruction->operands[predecessorIndex];
+							if (needsLocation(operand)) {
+								live[operand->id()] = true;
+							}
+						}
+					}
+				}
+
+				liveOut[block->orderIndex] = live;
+
+				for (auto instructionIterator = block->instructions.rbegin();
+					 instructionIterator != block->instructions.rend();
+					 ++instructionIterator) {
+					auto instruction = *instructionIterator;
+					live[instruction->id()] = false;
+
+					if (instruction->opCode() != IR::OpCode::Phi) {
+						for (auto operand : instruction->operands) {
+							if (needsLocation(operand)) {
+								live[operand->id()] = true;
+							}
+						}
+					}
+				}
+
+				if (live != liveIn[block->orderIndex]) {
+					liveIn[block->orderIndex] = live;
+					changed = true;
+				}
+			}
+		}
+
+		//Compute the live intervals
+		std::vector<int> intervalStart(numValues, INT_MAX);
+		std::vector<int> intervalEnd(numValues, -1);
+
+		for (auto block : blocks) {
+			auto index = block->orderIndex;
+
+			for (std::size_t i = 0; i < numValues; i++) {
+				if (liveIn[index][i]) {
+					intervalStart[i] = std::min(intervalStart[i], blockStart[index]);
+					intervalEnd[i] = std::max(intervalEnd[i], blockStart[index]);
+				}
+
+				if (liveOut[index][i]) {
+					intervalEnd[i] = std::max(intervalEnd[i], blockEnd[index]);
+				}
+			}
+
+			for (auto instruction : block->instructions) {
+				auto instructionPosition = positions[instruction->id()];
+
+				if (needsLocation(instruction)) {
+					intervalStart[instruction->id()] = std::min(intervalStart[instruction->id()], instructionPosition);
+					intervalEnd[instruction->id()] = std::max(intervalEnd[instruction->id()], instructionPosition);
+				}
+
+				if (instruction->opCode() != IR::OpCode::Phi) {
+					for (auto operand : instruction->operands) {
+						if (needsLocation(operand)) {
+							intervalEnd[operand->id()] = std::max(intervalEnd[operand->id()], instructionPosition);
+						}
+					}
+				}
+			}
+		}
+
+		std::vector<LiveInterval> intervals;
+		for (auto block : blocks) {
+			for (auto instruction : block->instructions) {
+				if (needsLocation(instruction)) {
+					intervals.push_back({ instruction, intervalStart[instruction->id()], intervalEnd[instruction->id()] });
+				}
+			}
+		}
+
+		std::stable_sort(intervals.begin(), intervals.end(), [](const LiveInterval& x, const LiveInterval& y) {
+			return x.start < y.start;
+		});
+
+		//Allocate the values to registers using linear scan. The registers are the same as used by the operand stack cache,
+		//and as they are caller saved, values that are live across calls are stored in the stack frame.
+		std::vector<Location> locations(numValues);
+		std::size_t baseStackSize = function.def().numParameters() + function.numLocals() + function.operandStackSize();
+		if (function.hasRegisterSaveArea()) {
+			baseStackSize += ManagedFunction::NUM_VARIABLE_REGISTERS;
+		}
+		int numSpillSlots = 0;
+
+		auto allocateStackSlot = [&](const IR::Instruction* value) {
+			//The arguments already have a slot in the stack frame
+			if (value->opCode() == IR::OpCode::Argument) {
+				return Location::makeStack(-(1 + value->intValue) * Amd64Backend::REGISTER_SIZE);
+			}
+
+			auto slot = (int)baseStackSize + numSpillSlots;
+			numSpillSlots++;
+			return Location::makeStack(-(1 + slot) * Amd64Backend::REGISTER_SIZE);
+		};
+
+		std::vector<HardwareRegister> freeIntRegisters;
+		for (auto reg : OperandStackCacheRegisters::Int) {
+			freeIntRegisters.push_back(reg);
+		}
+
+		std::vector<HardwareRegister> freeFloatRegisters;
+		for (auto reg : OperandStackCacheRegisters::Float) {
+			freeFloatRegisters.push_back(reg);
+		}
+
+		std::vector<LiveInterval*> active;
+		for (auto& interval : intervals) {
+			auto value = interval.value;
+			auto& freeRegisters = value->isFloat() ? freeFloatRegisters : freeIntRegisters;
+
+			//The operands of an instruction are read before its value is defined
+			active.erase(
+				std::remove_if(active.begin(), active.end(), [&](LiveInterval* activeInterval) {
+					if (activeInterval->end <= interval.start) {
+						auto reg = locations[activeInterval->value->id()].hardwareRegister;
+						(activeInterval->value->isFloat() ? freeFloatRegisters : freeIntRegisters).push_back(reg);
+						return true;
+					}
+
+					return false;
+				}),
+				active.end());
+
+			bool crossesCall = std::any_of(callPositions.begin(), callPositions.end(), [&](int callPosition) {
+				return interval.start < callPosition && callPosition < interval.end;
+			});
+
+			if (crossesCall) {
+				locations[value->id()] = allocateStackSlot(value);
+				continue;
+			}
+
+			if (!freeRegisters.empty()) {
+				locations[value->id()] = Location::makeRegister(freeRegisters.front());
+				freeRegisters.erase(freeRegisters.begin());
+				active.push_back(&interval);
+				continue;
+			}
+
+			//Spill the interval that ends last
+			LiveInterval* spillInterval = nullptr;
+			for (auto activeInterval : active) {
+				if (activeInterval->value->isFloat() == value->isFloat()
+					&& (spillInterval == nullptr || activeInterval->end > spillInterval->end)) {
+					spillInterval = activeInterval;
+				}
+			}
+
+			if (spillInterval != nullptr && spillInterval->end > interval.end) {
+				locations[value->id()] = locations[spillInterval->value->id()];
+				locations[spillInterval->value->id()] = allocateStackSlot(spillInterval->value);
+				std::replace(active.begin(), active.end(), spillInterval, &interval);
+			} else {
+				locations[value->id()] = allocateStackSlot(value);
+			}
+		}
+
+		auto locationOf = [&](const IR::Instruction* value) {
+			if (value->opCode() == IR::OpCode::Constant) {
+				return Location::makeConstant(value->intValue);
+			}
+
+			return locations[value->id()];
+		};
+
+		auto load = [&](HardwareRegister reg, const IR::Instruction* value) {
+			moveToRegister(assembler, reg, locationOf(value));
+		};
+
+		auto store = [&](const IR::Instruction* value, HardwareRegister reg) {
+			moveLocation(assembler, locations[value->id()], Location::makeRegister(reg));
+		};
+
+		//The moves for the phi functions along the given edge
+		auto edgeMoves = [&](const IR::BasicBlock* from, const IR::BasicBlock* to) {
+			std::vector<Move> moves;
+			auto predecessorIndex = to->predecessorIndex(from);
+
+			for (auto instruction : to->instructions) {
+				if (instruction->opCode() == IR::OpCode::Phi) {
+					moves.push_back({ locations[instruction->id()], locationOf(instruction->operands[predecessorIndex]) });
+				}
+			}
+
+			return moves;
+		};
+
+		std::vector<BlockJump> blockJumps;
+		std::vector<EdgeStub> edgeStubs;
+		std::vector<std::size_t> blockOffsets(blocks.size());
+
+		auto jumpToBlock = [&](const IR::BasicBlock* target) {
+			assembler.jump(JumpCondition::Always, 0);
+			blockJumps.push_back({ assembler.size() - 5, 5, target });
+		};
+
+		//Compares the operands of the given instruction. Returns true if the flags are set by an unsigned comparison.
+		auto generateCompare = [&](const IR::Instruction* instruction) {
+			auto left = instruction->operands[0];
+			auto right = instruction->operands[1];
+
+			if (left->isFloat()) {
+				load(FloatRegisters::XMM0, left);
+				load(FloatRegisters::XMM1, right);
+				assembler.compare(FloatRegisters::XMM0, FloatRegisters::XMM1);
+				return true;
+			}
+
+			//The subtraction sets the same flags as a 32-bits comparison
+			load(IntRegister(Registers::AX), left);
+			if (right->opCode() == IR::OpCode::Constant) {
+				assembler.sub(Registers::AX, right->intValue, true);
+			} else {
+				load(IntRegister(Registers::CX), right);
+				assembler.sub(Registers::AX, Registers::CX, true);
+			}
+
+			return false;
+		};
+
+		//Calculate the size of the stack aligned to 16 bytes
+		std::size_t neededStackSize = (baseStackSize + numSpillSlots) * Amd64Backend::REGISTER_SIZE;
+		std::size_t stackSize = ((neededStackSize + 15) / 16) * 16;
+
+		//Save the base pointer
+		assembler.push(Registers::BP);
+		assembler.move(Registers::BP, Registers::SP);
+
+		//Make room for the values on the stack
+		if (stackSize > 0) {
+			assembler.sub(Registers::SP, (int)stackSize);
+		}
+
+		mCallingConvention.moveArgsToStack(functionData);
+
+		for (auto block : blocks) {
+			blockOffsets[block->orderIndex] = assembler.size();
+			const IR::BasicBlock* nextBlock = nullptr;
+			if (block->orderIndex + 1 < (int)blocks.size()) {
+				nextBlock = blocks[block->orderIndex + 1];
+			}
+
+			for (auto instruction : block->instructions) {
+				auto& operands = instruction->operands;
+
+				switch (instruction->opCode()) {
+					case IR::OpCode::Constant:
+					case IR::OpCode::Phi:
+						break;
+					case IR::OpCode::Argument:
+						moveLocation(
+							assembler,
+							locations[instruction->id()],
+							Location::makeStack(-(1 + instruction->intValue) * Amd64Backend::REGISTER_SIZE));
+						break;
+					case IR::OpCode::Add:
+					case IR::OpCode::Sub:
+					case IR::OpCode::Mul:
+					case IR::OpCode::Div: {
+						auto opCode = instruction->opCode();
+
+						if (instruction->isFloat()) {
+							load(FloatRegisters::XMM0, operands[0]);
+							load(FloatRegisters::XMM1, operands[1]);
+
+							if (opCode == IR::OpCode::Add) {
+								assembler.add(FloatRegisters::XMM0, FloatRegisters::XMM1);
+							} else if (opCode == IR::OpCode::Sub) {
+								assembler.sub(FloatRegisters::XMM0, FloatRegisters::XMM1);
+							} else if (opCode == IR::OpCode::Mul) {
+								assembler.mult(FloatRegisters::XMM0, FloatRegisters::XMM1);
+							} else {
+								assembler.div(FloatRegisters::XMM0, FloatRegisters::XMM1);
+							}
+
+							store(instruction, FloatRegisters::XMM0);
+							break;
+						}
+
+						load(IntRegister(Registers::AX), operands[0]);
+
+						bool isConstant = operands[1]->opCode() == IR::OpCode::Constant;
+						if (opCode == IR::OpCode::Div || !isConstant) {
+							load(IntRegister(Registers::CX), operands[1]);
+						}
+
+						if (opCode == IR::OpCode::Add) {
+							if (isConstant) {
+								assembler.add(Registers::AX, operands[1]->intValue, true);
+							} else {
+								assembler.add(Registers::AX, Registers::CX, true);
+							}
+						} else if (opCode == IR::OpCode::Sub) {
+							if (isConstant) {
+								assembler.sub(Registers::AX, operands[1]->intValue, true);
+							} else {
+								assembler.sub(Registers::AX, Registers::CX, true);
+							}
+						} else if (opCode == IR::OpCode::Mul) {
+							if (isConstant) {
+								assembler.mult(Registers::AX, operands[1]->intValue, true);
+							} else {
+								assembler.mult(Registers::AX, Registers::CX, true);
+							}
+						} else {
+							assembler.signExtend(Registers::AX, DataSize::Size32); //cdq
+							assembler.div(Registers::CX, true); //idiv eax, ecx
+						}
+
+						store(instruction, IntRegister(Registers::AX));
+						break;
+					}
+					case IR::OpCode::And:
+					case IR::OpCode::Or:
+						load(IntRegister(Registers::AX), operands[0]);
+						load(IntRegister(Registers::CX), operands[1]);
+
+						if (instruction->opCode() == IR::OpCode::And) {
+							assembler.bitwiseAnd(Registers::AX, Registers::CX);
+						} else {
+							assembler.bitwiseOr(Registers::AX, Registers::CX);
+						}
+
+						store(instruction, IntRegister(Registers::AX));
+						break;
+					case IR::OpCode::Not:
+						load(IntRegister(Registers::AX), operands[0]);
+						assembler.bitwiseNot(Registers::AX);
+						assembler.bitwiseAnd(Registers::AX, 1); //Clear the other bits, so that the value is either 0 or 1.
+						store(instruction, IntRegister(Registers::AX));
+						break;
+					case IR::OpCode::ConvertIntToFloat:
+						load(IntRegister(Registers::AX), operands[0]);
+						assembler.convert(FloatRegisters::XMM0, Registers::AX, true);
+						store(instruction, FloatRegisters::XMM0);
+						break;
+					case IR::OpCode::ConvertFloatToInt:
+						load(FloatRegisters::XMM0, operands[0]);
+						assembler.convert(Registers::AX, FloatRegisters::XMM0);
+						store(instruction, IntRegister(Registers::AX));
+						break;
+					case IR::OpCode::Compare: {
+						bool unsignedComparison = generateCompare(instruction);
+
+						//Moves do not modify the flags
+						assembler.moveInt(Registers::AX, 1);
+						std::size_t compareJump = assembler.size();
+						assembler.jump(getJumpCondition(instruction->condition), 0, unsignedComparison);
+						std::size_t falseStart = assembler.size();
+						assembler.moveInt(Registers::AX, 0);
+						Helpers::setValue(assembler.data(), compareJump + 2, (int)(assembler.size() - falseStart));
+
+						store(instruction, IntRegister(Registers::AX));
+						break;
+					}
+					case IR::OpCode::Call: {
+						//The arguments are passed via the operand stack
+						for (auto operand : operands) {
+							if (operand->isFloat()) {
+								load(FloatRegisters::XMM0, operand);
+								operandStack.pushReg(FloatRegisters::XMM0, false);
+							} else {
+								load(IntRegister(Registers::AX), operand);
+								operandStack.pushReg(Registers::AX, false);
+							}
+						}
+
+						mCodeGenerator.generateFunctionCall(
+							vmState,
+							functionData,
+							function.instructions()[instruction->sourceIndex],
+							instruction->sourceIndex);
+
+						if (instruction->hasValue()) {
+							if (instruction->isFloat()) {
+								operandStack.popReg(FloatRegisters::XMM0);
+								store(instruction, FloatRegisters::XMM0);
+							} else {
+								operandStack.popReg(Registers::AX);
+								store(instruction, IntRegister(Registers::AX));
+							}
+						}
+						break;
+					}
+					case IR::OpCode::Branch: {
+						auto target = block->successors[0];
+						parallelMove(assembler, edgeMoves(block, target));
+
+						if (target != nextBlock) {
+							jumpToBlock(target);
+						}
+						break;
+					}
+					case IR::OpCode::ConditionalBranch: {
+						auto target = block->successors[0];
+						auto fallthrough = block->successors[1];
+						bool unsignedComparison = generateCompare(instruction);
+
+						assembler.jump(getJumpCondition(instruction->condition), 0, unsignedComparison);
+						auto jumpOffset = assembler.size() - 6;
+
+						//If moves are needed for the phi functions in the target, they are made in a stub after the function
+						if (edgeMoves(block, target).empty()) {
+							blockJumps.push_back({ jumpOffset, 6, target });
+						} else {
+							edgeStubs.push_back({ jumpOffset, block, target });
+						}
+
+						parallelMove(assembler, edgeMoves(block, fallthrough));
+						if (fallthrough != nextBlock) {
+							jumpToBlock(fallthrough);
+						}
+						break;
+					}
+					case IR::OpCode::Return: {
+						if (!operands.empty()) {
+							if (operands[0]->isFloat()) {
+								load(FloatRegisterCallArguments::ReturnValue, operands[0]);
+							} else {
+								load(IntRegister(RegisterCallArguments::ReturnValue), operands[0]);
+							}
+						}
+
+						//Restore the base pointer
+						assembler.move(Registers::SP, Registers::BP);
+						assembler.pop(Registers::BP);
+
+						//Make the return
+						assembler.ret();
+						break;
+					}
+				}
+			}
+		}
+
+		for (auto& edgeStub : edgeStubs) {
+			Helpers::setValue(assembler.data(), edgeStub.jumpOffset + 2, (int)(assembler.size() - edgeStub.jumpOffset - 6));
+			parallelMove(assembler, edgeMoves(edgeStub.from, edgeStub.to));
+			jumpToBlock(edgeStub.to);
+		}
+
+		//The entries for on-stack replacement load the values at the loop headers from the baseline stack frame,
+		//which stores the arguments, locals and operand stack entries in the same slots as the variables in the IR.
+		for (auto block : blocks) {
+			if (block->variableValues.empty()) {
+				continue;
+			}
+
+			auto& blockLiveIn = liveIn[block->orderIndex];
+			std::vector<bool> isLoaded(numValues, false);
+			std::vector<Move> moves;
+
+			for (std::size_t variable = 0; variable < block->variableValues.size(); variable++) {
+				auto value = block->variableValues[variable];
+				//Phi functions that have been removed as dead code have no location
+				if (value == nullptr
+					|| !needsLocation(value)
+					|| isLoaded[value->id()]
+					|| locations[value->id()].type == LocationType::None) {
+					continue;
+				}
+
+				if (blockLiveIn[value->id()] || (value->opCode() == IR::OpCode::Phi && value->block == block)) {
+					isLoaded[value->id()] = true;
+					moves.push_back({
+						locations[value->id()],
+						Location::makeStack(-(1 + (int)variable) * Amd64Backend::REGISTER_SIZE)
+					});
+				}
+			}
+
+			//All the live values must be stored in the baseline stack frame
+			bool canEnter = true;
+			for (std::size_t i = 0; i < numValues; i++) {
+				if (blockLiveIn[i] && !isLoaded[i]) {
+					canEnter = false;
+					break;
+				}
+			}
+
+			if (!canEnter) {
+				continue;
+			}
+
+			functionData.osrEntries[block->startIndex()] = assembler.size();
+
+			//The stack frame of the baseline code has a different size
+			assembler.move(Registers::SP, Registers::BP);
+			if (stackSize > 0) {
+				assembler.sub(Registers::SP, (int)stackSize);
+			}
+
+			parallelMove(assembler, moves);
+			jumpToBlock(block);
+		}
+
+		//Patch the jumps with the native targets
+		for (auto& blockJump : blockJumps) {
+			auto target = (int)blockOffsets[blockJump.target->orderIndex] - (int)(blockJump.offset + blockJump.size);
+			Helpers::setValue(assembler.data(), blockJump.offset + blockJump.size - sizeof(int), target);
+		}
+	}
+}
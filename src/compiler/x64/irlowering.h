@@ -0,0 +1,24 @@
+#pragma once
+#include "../ir/ir.h"
+
+namespace stackjit {
+	struct FunctionCompilationData;
+	class VMState;
+	class CallingConvention;
+	class CodeGenerator;
+
+	//Lowers functions in the IR to native instructions.
+	//The SSA values are allocated to the caller saved registers using linear scan,
+	//and values that are live across calls are stored in the stack frame.
+	class IRLowering {
+	private:
+		const CallingConvention& mCallingConvention;
+		CodeGenerator& mCodeGenerator;
+	public:
+		//Creates a new lowering pass
+		IRLowering(const CallingConvention& callingConvention, CodeGenerator& codeGenerator);
+
+		//Generates native instructions for the given function
+		void generateFunction(VMState& vmState, FunctionCompilationData& functionData, const IR::Function& irFunction);
+	};
+}
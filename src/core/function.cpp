@@ -1,10 +1,15 @@
 #include "function.h"
 #include "../helpers.h"
+#include "../type/type.h"
 
 namespace stackjit {
 	ManagedFunction::ManagedFunction(const FunctionDefinition& definition)
 		: mDefinition(definition),
-		  mOperandStackSize(0) {
+		  mOperandStackSize(0),
+		  mHasRegisterSaveArea(false),
+		  mJitTier(JitTier::Default),
+		  mInvocationCounter(0),
+		  mBackedgeCounter(0) {
 
 	}
 
@@ -52,6 +57,112 @@ namespace stackjit {
 	    mOperandStackSize = size;
 	}
 
+	JitTier ManagedFunction::jitTier() const {
+		return mJitTier;
+	}
+
+	void ManagedFunction::setJitTier(JitTier jitTier) {
+		mJitTier = jitTier;
+	}
+
+	int& ManagedFunction::invocationCounter() {
+		return mInvocationCounter;
+	}
+
+	int& ManagedFunction::backedgeCounter() {
+		return mBackedgeCounter;
+	}
+
+	std::vector<InlinedFunction>& ManagedFunction::inlinedFunctions() {
+		return mInlinedFunctions;
+	}
+
+	const std::vector<InlinedFunction>& ManagedFunction::inlinedFunctions() const {
+		return mInlinedFunctions;
+	}
+
+	void ManagedFunction::setVariableRegisters(std::vector<VariableRegister> variableRegisters) {
+		mVariableRegisters = variableRegisters;
+		mHasRegisterSaveArea = true;
+	}
+
+	bool ManagedFunction::hasRegisterSaveArea() const {
+		return mHasRegisterSaveArea;
+	}
+
+	VariableRegister ManagedFunction::getVariableRegister(std::size_t index) const {
+		if (index < mVariableRegisters.size()) {
+			return mVariableRegisters[index];
+		}
+
+		return VariableRegister();
+	}
+
+	VariableRegister ManagedFunction::getArgumentRegister(std::size_t index) const {
+		return getVariableRegister(index);
+	}
+
+	VariableRegister ManagedFunction::getLocalRegister(std::size_t index) const {
+		return getVariableRegister(def().numParameters() + index);
+	}
+
+	bool ManagedFunction::usesRegister(int registerIndex) const {
+		for (auto& variable : mVariableRegisters) {
+			if (variable.registerIndex == registerIndex) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	int ManagedFunction::registerSaveSlotOffset(int registerIndex) const {
+		//The save area is located after the operand stack
+		return -(int)(sizeof(RegisterValue) * (1 + def().numParameters() + numLocals() + operandStackSize() + registerIndex));
+	}
+
+	const StackMap& ManagedFunction::stackMap() const {
+		return mStackMap;
+	}
+
+	void ManagedFunction::addSafepoint(int instructionIndex) {
+		auto& operandTypes = mInstructions[instructionIndex].operandTypes();
+		std::vector<bool> references;
+
+		for (auto parameter : def().parameters()) {
+			references.push_back(parameter->isReference());
+		}
+
+		for (auto local : mLocalTypes) {
+			references.push_back(local->isReference());
+		}
+
+		//The operand types are ordered from the top of the stack
+		for (auto operand = operandTypes.rbegin(); operand != operandTypes.rend(); ++operand) {
+			references.push_back((*operand)->isReference());
+		}
+
+		mStackMap.addSafepoint(instructionIndex, operandTypes.size(), references);
+	}
+
+	void ManagedFunction::clearOperandTypes() {
+		for (auto& instruction : mInstructions) {
+			instruction.clearOperandTypes();
+		}
+	}
+
+	bool InlinedFunction::contains(int instructionIndex) const {
+		return instructionIndex >= (int)start && instructionIndex < (int)end;
+	}
+
+	bool VariableRegister::isAllocated() const {
+		return registerIndex != -1;
+	}
+
+	bool VariableRegister::isLive(int instructionIndex) const {
+		return instructionIndex >= start && instructionIndex <= end;
+	}
+
 	FunctionDefinition::FunctionDefinition(
 	    std::string name,
 	    std::vector<const Type*> parameters,
@@ -1,5 +1,6 @@
 #pragma once
 #include "instruction.h"
+#include "stackmap.h"
 #include "../type/classmetadata.h"
 #include "../stackjit.h"
 #include <vector>
@@ -98,6 +99,48 @@ namespace stackjit {
 		BytePtr entryPoint() const;
 	};
 
+	//The tiers of the JIT compiler
+	enum class JitTier : unsigned char {
+		//Uses the tier given by the configuration
+		Default,
+		//Generates native code directly from the bytecode
+		Baseline,
+		//Generates native code from the optimized SSA IR
+		Optimizing
+	};
+
+	//Represents the register that a variable (argument or local) has been allocated to
+	struct VariableRegister {
+		//The index of the register, -1 if the variable is stored in the stack frame
+		int registerIndex = -1;
+
+		//The first and last instruction where the variable is live
+		int start = 0;
+		int end = -1;
+
+		//Indicates if the variable is allocated to a register
+		bool isAllocated() const;
+
+		//Indicates if the variable is live at the given instruction
+		bool isLive(int instructionIndex) const;
+	};
+
+	//Represents a function whose instructions have been inlined into another function
+	struct InlinedFunction {
+		//The inlined function
+		const FunctionDefinition* function = nullptr;
+
+		//The range of the inlined instructions, where the end is exclusive
+		std::size_t start = 0;
+		std::size_t end = 0;
+
+		//The first local in the caller used by the inlined function. The arguments are followed by the locals.
+		std::size_t firstLocal = 0;
+
+		//Indicates if the given instruction belongs to the inlined function
+		bool contains(int instructionIndex) const;
+	};
+
 	//Represents a function defined in managed code
 	class ManagedFunction {
 	private:
@@ -106,7 +149,17 @@ namespace stackjit {
 		std::size_t mOperandStackSize;
 		std::vector<Instruction> mInstructions;
 		std::vector<unsigned char> mGeneratedCode;
+		std::vector<VariableRegister> mVariableRegisters;
+		std::vector<InlinedFunction> mInlinedFunctions;
+		StackMap mStackMap;
+		bool mHasRegisterSaveArea;
+		JitTier mJitTier;
+		int mInvocationCounter;
+		int mBackedgeCounter;
 	public:
+		//The number of registers that variables can be allocated to
+		static const int NUM_VARIABLE_REGISTERS = 4;
+
 		//Creates a new managed function
 		ManagedFunction(const FunctionDefinition& definition);
 
@@ -138,5 +191,51 @@ namespace stackjit {
 
 		//Sets the size of the operand stack
 		void setOperandStackSize(std::size_t size);
+
+		//Returns the tier that the function is compiled with
+		JitTier jitTier() const;
+
+		//Sets the tier that the function is compiled with
+		void setJitTier(JitTier jitTier);
+
+		//The counters decremented by the baseline code at invocations and loop iterations.
+		//The function is recompiled by the optimizing tier when a counter reaches zero.
+		int& invocationCounter();
+		int& backedgeCounter();
+
+		//Returns the functions that have been inlined into the function. Outer functions are before the inner.
+		std::vector<InlinedFunction>& inlinedFunctions();
+		const std::vector<InlinedFunction>& inlinedFunctions() const;
+
+		//Sets the registers that the arguments and locals (in that order) are allocated to.
+		//This also makes the function have a register save area in its stack frame.
+		void setVariableRegisters(std::vector<VariableRegister> variableRegisters);
+
+		//Indicates if the function has a register save area
+		bool hasRegisterSaveArea() const;
+
+		//Returns the register allocation for the given variable, where the arguments are followed by the locals
+		VariableRegister getVariableRegister(std::size_t index) const;
+
+		//Returns the register allocation for the given argument
+		VariableRegister getArgumentRegister(std::size_t index) const;
+
+		//Returns the register allocation for the given local
+		VariableRegister getLocalRegister(std::size_t index) const;
+
+		//Indicates if the given register is used by any variable
+		bool usesRegister(int registerIndex) const;
+
+		//Returns the offset in the stack frame for the save slot of the given register
+		int registerSaveSlotOffset(int registerIndex) const;
+
+		//Returns the map of the references in the stack frame at the safepoints
+		const StackMap& stackMap() const;
+
+		//Makes the given instruction a safepoint. The operand types of the instruction must be available.
+		void addSafepoint(int instructionIndex);
+
+		//Frees the operand types of the instructions. The stack map is used to find the references instead.
+		void clearOperandTypes();
 	};
 }
@@ -2,12 +2,12 @@
 
 namespace stackjit {
 	Instruction::Instruction()
-	    : mOpCode(OpCodes::NOP), floatValue(0), intValue(0), charValue(0) {
+	    : mOpCode(OpCodes::NOP), floatValue(0), intValue(0), charValue(0), classType(nullptr), callConstructor(true) {
 
 	}
 
 	Instruction::Instruction(OpCodes opCode)
-	    : mOpCode(opCode), floatValue(0), intValue(0), charValue(0) {
+	    : mOpCode(opCode), floatValue(0), intValue(0), charValue(0), classType(nullptr), callConstructor(true) {
 
 	}
 
@@ -26,4 +26,8 @@ namespace stackjit {
 	void Instruction::setOperandTypes(const std::vector<const Type*>& operandTypes) {
 		mOperandTypes = operandTypes;
 	}
+
+	void Instruction::clearOperandTypes() {
+		std::vector<const Type*>().swap(mOperandTypes);
+	}
 }
@@ -25,6 +25,9 @@ namespace stackjit {
 	    //Used by object instructions
 	    const ClassType* classType;
 
+	    //Indicates if a new object instruction calls the constructor. Not called when the constructor has been inlined.
+	    bool callConstructor;
+
 	    //Creates a new instruction
 	    Instruction();
 	    Instruction(OpCodes opCode);
@@ -40,5 +43,8 @@ namespace stackjit {
 
 	    //Sets the operand types
 	    void setOperandTypes(const std::vector<const Type*>& operandTypes);
+
+	    //Frees the operand types
+	    void clearOperandTypes();
 	};
 }
@@ -0,0 +1,39 @@
+#include "stackmap.h"
+#include <algorithm>
+
+namespace stackjit {
+	namespace {
+		//Orders safepoints by the instruction index
+		bool compareSafepoint(const Safepoint& safepoint, int instructionIndex) {
+			return safepoint.instructionIndex < instructionIndex;
+		}
+	}
+
+	Safepoint::Safepoint(int instructionIndex, std::size_t operandStackSize, std::size_t start)
+		: instructionIndex(instructionIndex), operandStackSize(operandStackSize), start(start) {
+
+	}
+
+	void StackMap::addSafepoint(int instructionIndex, std::size_t operandStackSize, const std::vector<bool>& references) {
+		auto position = std::lower_bound(mSafepoints.begin(), mSafepoints.end(), instructionIndex, compareSafepoint);
+		if (position != mSafepoints.end() && position->instructionIndex == instructionIndex) {
+			return;
+		}
+
+		mSafepoints.insert(position, Safepoint(instructionIndex, operandStackSize, mReferences.size()));
+		mReferences.insert(mReferences.end(), references.begin(), references.end());
+	}
+
+	const Safepoint* StackMap::getSafepoint(int instructionIndex) const {
+		auto position = std::lower_bound(mSafepoints.begin(), mSafepoints.end(), instructionIndex, compareSafepoint);
+		if (position == mSafepoints.end() || position->instructionIndex != instructionIndex) {
+			return nullptr;
+		}
+
+		return &(*position);
+	}
+
+	bool StackMap::isReference(const Safepoint& safepoint, std::size_t entryIndex) const {
+		return mReferences[safepoint.start + entryIndex];
+	}
+}
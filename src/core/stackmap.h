@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace stackjit {
+	//Represents a safepoint, which is an instruction where the stack frame can be inspected
+	struct Safepoint {
+		//The index of the instruction
+		int instructionIndex;
+
+		//The size of the operand stack at the instruction
+		std::size_t operandStackSize;
+
+		//The index of the first bit of the safepoint in the stack map
+		std::size_t start;
+
+		//Creates a new safepoint
+		Safepoint(int instructionIndex, std::size_t operandStackSize, std::size_t start);
+	};
+
+	//Describes which entries of the stack frames of a function hold references. The map is only defined at the
+	//safepoints (calls and GC calls), where there is one bit for each argument, local and operand (in that order).
+	//The operands are ordered from the bottom of the stack.
+	class StackMap {
+	private:
+		std::vector<Safepoint> mSafepoints;
+		std::vector<bool> mReferences;
+	public:
+		//Adds a safepoint at the given instruction, where the given entries are references.
+		//Does nothing if the instruction already is a safepoint.
+		void addSafepoint(int instructionIndex, std::size_t operandStackSize, const std::vector<bool>& references);
+
+		//Returns the safepoint at the given instruction, or null if the instruction is not a safepoint
+		const Safepoint* getSafepoint(int instructionIndex) const;
+
+		//Indicates if the given entry is a reference at the given safepoint
+		bool isReference(const Safepoint& safepoint, std::size_t entryIndex) const;
+	};
+}
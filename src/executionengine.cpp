@@ -16,10 +16,13 @@ namespace stackjit {
 	ExecutionEngine::ExecutionEngine(VMState& vmState)
 		: mVMState(vmState),
 		  mJIT(vmState),
-		  mCallStack(2000),
+		  mCallStack(512 * 1024),
 		  mVerifier(vmState),
 		  mFunctionLoader(vmState),
-		  mClassLoader(vmState) {
+		  mClassLoader(vmState),
+		  mInliner(vmState, mVerifier, [this](const std::string& signature) {
+			  return loadInlineCandidate(signature);
+		  }) {
 
 	}
 
@@ -27,6 +30,10 @@ namespace stackjit {
 		for (auto func : mLoadedFunctions) {
 			delete func.second;
 		}
+
+		for (auto func : mInlineCandidates) {
+			delete func.second;
+		}
 	}
 
 	JITCompiler& ExecutionEngine::jitCompiler() {
@@ -193,12 +200,45 @@ namespace stackjit {
 
 		//Create virtual function tables
 		mVMState.classProvider().createVirtualFunctionTables(mVMState);
+		mVMState.typeProvider().bindVirtualFunctionTables();
+		mJIT.createVirtualFunctionStubs(mVMState.classProvider());
+	}
+
+	const ManagedFunction* ExecutionEngine::loadInlineCandidate(const std::string& signature) {
+		if (mInlineCandidates.count(signature) > 0) {
+			return mInlineCandidates[signature];
+		}
+
+		ManagedFunction* function = nullptr;
+		auto funcImage = mImageContainer.getFunction(signature);
+
+		if (funcImage != nullptr && !funcImage->isExternal()) {
+			auto& funcDef = mVMState.binder().getFunction(signature);
+			mImageContainer.loadFunctionBody(signature);
+			function = mFunctionLoader.loadManaged(*funcImage, funcDef);
+
+			//Invalid functions are reported when they are compiled
+			try {
+				mVerifier.verifyFunction(*function);
+			} catch (std::runtime_error&) {
+				delete function;
+				function = nullptr;
+			}
+		}
+
+		mInlineCandidates.insert({ signature, function });
+		return function;
 	}
 
 	JitFunction ExecutionEngine::compileFunction(ManagedFunction* function, bool resolveSymbols) {
 		//Type check the function
 		mVerifier.verifyFunction(*function);
 
+		//Inline small functions
+		if (mVMState.config.inlineFunctions) {
+			mInliner.inlineCalls(*function);
+		}
+
 		//Compile it
 		auto funcPtr = mJIT.compileFunction(function);
 
@@ -253,6 +293,19 @@ namespace stackjit {
 		return compileFunction(signature, entryPoint);
 	}
 
+	void ExecutionEngine::tierUpFunction(ManagedFunction* function) {
+		auto signature = FunctionSignature::from(function->def()).str();
+		auto& funcDef = mVMState.binder().getFunction(signature);
+		auto baselineCode = funcDef.entryPoint();
+
+		auto funcPtr = mJIT.recompileFunction(function, JitTier::Optimizing);
+		funcDef.setEntryPoint((BytePtr)funcPtr);
+		mJIT.resolveSymbols(signature);
+
+		//Calls to the baseline code are redirected to the new code
+		mJIT.patchTierUpJump(baselineCode, (BytePtr)funcPtr);
+	}
+
 	void ExecutionEngine::generateCode() {
 		//Generate instructions for all functions
 		for (auto& image : mImageContainer.images()) {
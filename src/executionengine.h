@@ -1,6 +1,7 @@
 #pragma once
 #include "compiler/binder.h"
 #include "compiler/jit.h"
+#include "compiler/inliner.h"
 #include "loader/loader.h"
 #include "loader/functionloader.h"
 #include "loader/classloader.h"
@@ -44,9 +45,11 @@ namespace stackjit {
 
 		FunctionLoader mFunctionLoader;
 		ClassLoader mClassLoader;
+		Inliner mInliner;
 
 		ImageContainer mImageContainer;
 		std::unordered_map<std::string, ManagedFunction*> mLoadedFunctions;
+		std::unordered_map<std::string, ManagedFunction*> mInlineCandidates;
 		bool mHasMainInitialized = false;
 
 		//Generates code for loaded functions
@@ -61,6 +64,9 @@ namespace stackjit {
 		//Loads the given image from the given stream
 		void loadImage(std::ifstream& stream, AssemblyType assemblyType);
 
+		//Loads and verifies the function with the given signature for inlining. Returns null if not a managed function.
+		const ManagedFunction* loadInlineCandidate(const std::string& signature);
+
 		//Compiles the given function
 		JitFunction compileFunction(ManagedFunction* function, bool resolveSymbols = false);
 	public:
@@ -95,6 +101,9 @@ namespace stackjit {
 		bool compileFunction(const std::string& signature, JitFunction& entryPoint);
 		bool compileFunction(const std::string& signature);
 
+		//Recompiles the given function with the optimizing tier. The baseline code jumps to the new code.
+		void tierUpFunction(ManagedFunction* function);
+
 		//Loads and compiles all functions
 		void loadAndCompileAll();
 
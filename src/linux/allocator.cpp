@@ -26,5 +26,25 @@ namespace stackjit {
 	bool Allocator::makeExecutable(void* memory, std::size_t size) {
 		return mprotect(memory, size, PROT_EXEC | PROT_READ) == 0;
 	}
+
+	void* Allocator::reserve(std::size_t size) {
+		void *mem = mmap(
+			nullptr,
+			size,
+			PROT_NONE,
+			MAP_ANON | MAP_PRIVATE | MAP_NORESERVE,
+			-1,
+			0);
+
+		if (mem == MAP_FAILED) {
+			return nullptr;
+		} else {
+			return mem;
+		}
+	}
+
+	bool Allocator::commit(void* memory, std::size_t size) {
+		return mprotect(memory, size, PROT_WRITE | PROT_READ) == 0;
+	}
 }
 #endif
@@ -26,5 +26,52 @@ namespace stackjit {
 		Helpers::setValue(assembler.data(), checkEndIndex, (int)assembler.data().size());
 		return callIndex;
 	}
+
+	void CodeGenerator::generateVirtualFunctionStub(CodeGen& generatedCode, const ClassMetadata* metadata, int index) {
+		Amd64Assembler assembler(generatedCode);
+		const IntRegister intArgs[] = {
+			RegisterCallArguments::Arg0, RegisterCallArguments::Arg1, RegisterCallArguments::Arg2,
+			RegisterCallArguments::Arg3, RegisterCallArguments::Arg4, RegisterCallArguments::Arg5
+		};
+
+		const FloatRegisters floatArgs[] = {
+			FloatRegisterCallArguments::Arg0, FloatRegisterCallArguments::Arg1,
+			FloatRegisterCallArguments::Arg2, FloatRegisterCallArguments::Arg3,
+			FloatRegisterCallArguments::Arg4, FloatRegisterCallArguments::Arg5,
+			FloatRegisterCallArguments::Arg6, FloatRegisterCallArguments::Arg7
+		};
+
+		//Save the arguments. The stack is aligned after the int arguments have been pushed.
+		assembler.push(Registers::BP);
+		assembler.move(Registers::BP, Registers::SP);
+
+		for (auto reg : intArgs) {
+			assembler.push(reg);
+		}
+
+		assembler.sub(Registers::SP, 8 * 8);
+		for (int i = 0; i < 8; i++) {
+			assembler.move(MemoryOperand(Registers::BP, -(6 + i + 1) * 8), floatArgs[i]);
+		}
+
+		//Compile the function
+		assembler.moveLong(RegisterCallArguments::Arg0, (PtrValue)metadata);
+		assembler.moveInt(RegisterCallArguments::Arg1, index);
+		assembler.moveLong(Registers::AX, (PtrValue)&Runtime::compileVirtualFunction);
+		assembler.call(Registers::AX);
+
+		//Restore the arguments and jump to the function
+		for (int i = 0; i < 8; i++) {
+			assembler.move(floatArgs[i], MemoryOperand(Registers::BP, -(6 + i + 1) * 8));
+		}
+
+		assembler.add(Registers::SP, 8 * 8);
+		for (int i = 5; i >= 0; i--) {
+			assembler.pop(intArgs[i]);
+		}
+
+		assembler.pop(Registers::BP);
+		assembler.jump(Registers::AX);
+	}
 }
 #endif
\ No newline at end of file
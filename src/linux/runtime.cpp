@@ -1,5 +1,7 @@
 #ifdef __unix__
+#include "../runtime/runtime.h"
 #include <unistd.h>
+#include <pthread.h>
 #include <iostream>
 #include <fstream>
 
@@ -23,6 +25,26 @@ namespace stackjit {
 			buffer[bytes - 8] = '\0';
 			return std::string(buffer);
 		}
+
+		bool getThreadStackBounds(BytePtr& low, BytePtr& high) {
+			pthread_attr_t attributes;
+			if (pthread_getattr_np(pthread_self(), &attributes) != 0) {
+				return false;
+			}
+
+			void* stackAddress = nullptr;
+			std::size_t stackSize = 0;
+			int result = pthread_attr_getstack(&attributes, &stackAddress, &stackSize);
+			pthread_attr_destroy(&attributes);
+
+			if (result != 0) {
+				return false;
+			}
+
+			low = (BytePtr)stackAddress;
+			high = low + stackSize;
+			return true;
+		}
 	}
 }
 #endif
\ No newline at end of file
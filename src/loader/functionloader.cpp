@@ -90,6 +90,7 @@ namespace stackjit {
 		}
 
 		auto loadedFunc = new ManagedFunction(functionDefinition);
+		loadedFunc->setJitTier(LoaderHelpers::getJitTier(function.attributes()));
 
 		//Locals
 		loadedFunc->setNumLocals(function.localTypes().size());
@@ -56,4 +56,23 @@ namespace stackjit {
 		return isVirtual;
 	}
 
-}
\ No newline at end of file
+	JitTier LoaderHelpers::getJitTier(const Loader::AttributeContainer& attributeContainer) {
+		JitTier jitTier = JitTier::Default;
+
+		if (attributeContainer.count("JIT") > 0) {
+			auto& attribute = attributeContainer.at("JIT");
+			if (attribute.values().count("tier") > 0) {
+				auto value = attribute.values().at("tier");
+				if (value == "baseline") {
+					jitTier = JitTier::Baseline;
+				} else if (value == "opt") {
+					jitTier = JitTier::Optimizing;
+				} else {
+					throw std::runtime_error("'" + value + "' is not valid tier for the attribute 'JIT'.");
+				}
+			}
+		}
+
+		return jitTier;
+	}
+}
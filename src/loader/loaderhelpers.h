@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include "../type/classmetadata.h"
+#include "../core/function.h"
 #include "loader.h"
 
 namespace stackjit {
@@ -21,5 +22,8 @@ namespace stackjit {
 
 		//Indicates if the given function is virtual
 		bool getIsVirtual(const Loader::AttributeContainer& attributeContainer);
+
+		//Returns the JIT tier for the given function or the default tier
+		JitTier getJitTier(const Loader::AttributeContainer& attributeContainer);
 	}
 }
\ No newline at end of file
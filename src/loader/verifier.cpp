@@ -853,7 +853,8 @@ namespace stackjit {
 
 				auto calledFunc = mVMState.binder().getFunction(signature);
 
-				auto calledFuncNumArgs = calledFunc.parameters().size();
+				//If the constructor has been inlined, the arguments are handled by the inlined code
+				auto calledFuncNumArgs = instruction.callConstructor ? calledFunc.parameters().size() : 1;
 				assertOperandCount(functionSignature, index, operandStack, calledFuncNumArgs - 1);
 
 				//Check the arguments
@@ -1,62 +1,52 @@
 #include "callstack.h"
-#include <stdexcept>
+#include "runtime.h"
+#include <algorithm>
 
 namespace stackjit {
-	CallStackEntry::CallStackEntry(ManagedFunction* function, int callPoint)
-		: function(function), callPoint(callPoint) {
-
-	}
-
-	CallStackEntry::CallStackEntry()
-		: function(nullptr), callPoint(0) {
-
+	namespace {
+		//Stacks without a size limit are limited to this size, instead of growing until the memory runs out
+		const std::size_t MAX_STACK_SIZE = 64 * 1024 * 1024;
 	}
 
-	CallStack::CallStack(std::size_t size)
-		: mSize(size), mStart(new CallStackEntry[size]), mTop(mStart) {
+	CallSite::CallSite(const ManagedFunction* function, int callPoint)
+		: function(function), callPoint(callPoint) {
 
 	}
 
-	CallStack::~CallStack() {
-		delete[] mStart;
+	CallStack::CallStack(std::size_t reservedSize)
+		: mReservedSize(reservedSize), mLimit(nullptr) {
+		enterThread();
 	}
 
-	void CallStack::push(ManagedFunction* function, int callPoint) {
-		if (mTop + 1 < mStart + mSize) {
-			mTop++;
-			*mTop = CallStackEntry(function, callPoint);
+	void CallStack::enterThread() {
+		//The stack grows downwards towards its lowest address
+		BytePtr low = nullptr;
+		BytePtr high = nullptr;
+		if (Runtime::getThreadStackBounds(low, high)) {
+			mLimit = high - std::min((std::size_t)(high - low), MAX_STACK_SIZE) + mReservedSize;
 		} else {
-			throw std::runtime_error("Stack overflow.");
+			mLimit = nullptr;
 		}
 	}
 
-	CallStackEntry CallStack::pop() {
-		if (mTop == mStart) {
-			throw std::runtime_error("Stack underflow.");
-		}
-
-		auto top = *mTop;
-		mTop--;
-		return top;
-	}
-
-	std::size_t CallStack::size() const {
-		return mSize;
+	BytePtr CallStack::limit() const {
+		return mLimit;
 	}
 
-	CallStackEntry* CallStack::start() {
-		return mStart;
+	BytePtr* CallStack::limitPtr() {
+		return &mLimit;
 	}
 
-	CallStackEntry* const CallStack::start() const {
-		return mStart;
+	void CallStack::addCallSite(BytePtr returnAddress, const ManagedFunction* function, int callPoint) {
+		mCallSites.insert({ returnAddress, CallSite(function, callPoint) });
 	}
 
-	CallStackEntry* CallStack::top() {
-		return mTop;
-	}
+	const CallSite* CallStack::getCallSite(BytePtr returnAddress) const {
+		auto callSite = mCallSites.find(returnAddress);
+		if (callSite == mCallSites.end()) {
+			return nullptr;
+		}
 
-	CallStackEntry** CallStack::topPtr() {
-		return &mTop;
+		return &callSite->second;
 	}
 }
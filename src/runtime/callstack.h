@@ -1,46 +1,45 @@
 #pragma once
 #include <cstdlib>
+#include <unordered_map>
+#include "../stackjit.h"
 
 namespace stackjit {
 	class ManagedFunction;
 
-	//Represents a call stack entry
-	struct CallStackEntry {
-		ManagedFunction* function;
+	//Represents a call made by managed code
+	struct CallSite {
+		const ManagedFunction* function;
 		int callPoint;
 
-		CallStackEntry(ManagedFunction* function, int callPoint);
-		CallStackEntry();
+		CallSite(const ManagedFunction* function, int callPoint);
 	};
 
-	//Manages the call stack
+	//Describes the native call stack used by managed code.
+	//The frames are linked by their base pointers, and the return address of a frame identifies the calling
+	//function and instruction. A return address that is not a call site belongs to the caller of the entry point.
 	class CallStack {
 	private:
-		const std::size_t mSize;
-		CallStackEntry* mStart;
-		CallStackEntry* mTop;
+		std::size_t mReservedSize;
+		BytePtr mLimit;
+		std::unordered_map<BytePtr, CallSite> mCallSites;
 	public:
-		//Creates a new call stack of the given size
-		CallStack(std::size_t size);
-		~CallStack();
+		//Creates a new call stack, where the given number of bytes at the end of the stack are left for native code
+		CallStack(std::size_t reservedSize);
 
-		//Pushes the given function to the stack
-		void push(ManagedFunction* function, int callPoint);
+		//Sets the limit from the stack of the current thread, which is the thread that runs the managed code
+		void enterThread();
 
-		//Pops the top entry
-		CallStackEntry pop();
+		//Returns the lowest address that the stack pointer can have before a stack overflow.
+		//Null if the stack of the thread is unknown, in which case stack overflows are not detected.
+		BytePtr limit() const;
 
-		//Returns the size of the stack
-		std::size_t size() const;
+		//Returns a pointer to the limit, which the generated code reads
+		BytePtr* limitPtr();
 
-		//Returns the start of the stack
-		CallStackEntry* start();
-		CallStackEntry* const start() const;
+		//Adds a call site with the given return address
+		void addCallSite(BytePtr returnAddress, const ManagedFunction* function, int callPoint);
 
-		//Returns top of the stack
-		CallStackEntry* top();
-
-		//Returns a pointer to the top variable
-		CallStackEntry** topPtr();
+		//Returns the call site with the given return address, or null if there is no such call site
+		const CallSite* getCallSite(BytePtr returnAddress) const;
 	};
 }
@@ -0,0 +1,263 @@
+#include "concurrentmarker.h"
+#include "gcgeneration.h"
+#include "heapmemory.h"
+#include "../type/type.h"
+#include "../type/classmetadata.h"
+#include <atomic>
+#include <cstring>
+
+namespace stackjit {
+	namespace {
+		//The number of objects marked between the checks for a pause
+		const int MARK_BATCH_SIZE = 1024;
+	}
+
+	ConcurrentMarker::ConcurrentMarker(const CollectorGeneration& oldGeneration, const HeapMemory& heapMemory, std::size_t satbBufferSize)
+		: mOldGeneration(oldGeneration),
+		  mHeapMemory(heapMemory),
+		  mSATBBuffer(new PtrValue[satbBufferSize]),
+		  mSATBBufferSize(satbBufferSize),
+		  mDrained(nullptr),
+		  mModUnionTable(new unsigned char[oldGeneration.numCoveredCards()]()) {
+		mSATBQueue.next = nullptr;
+		mSATBQueue.end = nullptr;
+		mSATBQueue.biasedModUnionTable =
+			(PtrValue)mModUnionTable.get() - ((PtrValue)oldGeneration.heap().data() >> oldGeneration.cardShift());
+	}
+
+	ConcurrentMarker::~ConcurrentMarker() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+
+		mCondition.notify_all();
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+	}
+
+	ConcurrentMarker::SATBQueue* ConcurrentMarker::queue() {
+		return &mSATBQueue;
+	}
+
+	bool ConcurrentMarker::isMarking() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mMarking;
+	}
+
+	bool ConcurrentMarker::isDone() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mMarking && !mWorking;
+	}
+
+	BytePtr ConcurrentMarker::snapshotEnd() const {
+		return mSnapshotEnd;
+	}
+
+	void ConcurrentMarker::push(RawObjectRef objPtr) {
+		if (objPtr == nullptr) {
+			return;
+		}
+
+		auto fullPtr = objPtr - stackjit::OBJECT_HEADER_SIZE;
+		if (mOldGeneration.heap().inside(fullPtr)) {
+			if (fullPtr < mSnapshotEnd) {
+				mMarkStack.push_back(objPtr);
+			}
+		} else if (!mHeapMemory.inside(fullPtr)) {
+			//The large objects allocated while marking are already marked
+			ObjectRef(objPtr).mark();
+		}
+	}
+
+	void ConcurrentMarker::drainQueue() {
+		//The generated code writes the entry before it moves the next pointer
+		auto next = reinterpret_cast<std::atomic<PtrValue*>*>(&mSATBQueue.next)->load(std::memory_order_acquire);
+		while (mDrained < next) {
+			push((RawObjectRef)*mDrained);
+			mDrained++;
+		}
+	}
+
+	bool ConcurrentMarker::isModified(const PtrValue* referencePtr) const {
+		auto cardPtr = (unsigned char*)(mSATBQueue.biasedModUnionTable + ((PtrValue)referencePtr >> mOldGeneration.cardShift()));
+		return reinterpret_cast<std::atomic<unsigned char>*>(cardPtr)->load(std::memory_order_relaxed) != 0;
+	}
+
+	void ConcurrentMarker::markObject(RawObjectRef objPtr, bool concurrent) {
+		ObjectRef objRef(objPtr);
+		if (objRef.isMarked()) {
+			return;
+		}
+
+		objRef.mark();
+		visitReferences(objPtr, concurrent);
+	}
+
+	void ConcurrentMarker::visitReferences(RawObjectRef objPtr, bool concurrent) {
+		ObjectRef objRef(objPtr);
+		bool deferred = false;
+
+		auto visitSlot = [&](PtrValue* referencePtr) {
+			if (concurrent) {
+				//The barrier marks the card before the slot is written, so a slot read that might be torn is detected.
+				//The object is then scanned again when the marking is finished.
+				auto value = reinterpret_cast<std::atomic<PtrValue>*>(referencePtr)->load(std::memory_order_acquire);
+				if (!isModified(referencePtr)) {
+					push((RawObjectRef)value);
+				} else if (!deferred) {
+					mDeferred.push_back(objPtr);
+					deferred = true;
+				}
+			} else {
+				push((RawObjectRef)*referencePtr);
+			}
+		};
+
+		if (objRef.type()->isArray()) {
+			auto arrayType = static_cast<const ArrayType*>(objRef.type());
+			if (arrayType->elementType()->isReference()) {
+				ArrayRef<PtrValue> arrayRef(objRef.dataPtr());
+				for (int i = arrayRef.length() - 1; i >= 0; i--) {
+					visitSlot(arrayRef.elementsPtr() + i);
+				}
+			}
+		} else if (objRef.type()->isClass()) {
+			auto classType = static_cast<const ClassType*>(objRef.type());
+			for (auto fieldOffset : classType->metadata()->referenceFieldOffsets()) {
+				visitSlot((PtrValue*)(objRef.dataPtr() + fieldOffset));
+			}
+		}
+	}
+
+	bool ConcurrentMarker::markBatch(bool concurrent) {
+		drainQueue();
+
+		for (int i = 0; i < MARK_BATCH_SIZE && !mMarkStack.empty(); i++) {
+			auto objPtr = mMarkStack.back();
+			mMarkStack.pop_back();
+			markObject(objPtr, concurrent);
+		}
+
+		drainQueue();
+		return !mMarkStack.empty();
+	}
+
+	void ConcurrentMarker::markerLoop() {
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		while (true) {
+			mCondition.wait(lock, [this]() {
+				return mStop || (mWorking && !mPauseRequested);
+			});
+
+			if (mStop) {
+				return;
+			}
+
+			mInBatch = true;
+			lock.unlock();
+			bool hasMore = markBatch(true);
+			lock.lock();
+			mInBatch = false;
+
+			if (!hasMore) {
+				mWorking = false;
+			}
+
+			mCondition.notify_all();
+		}
+	}
+
+	void ConcurrentMarker::start(const std::vector<RawObjectRef>& roots) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mSnapshotEnd = mOldGeneration.heap().nextAllocation();
+			std::memset(mModUnionTable.get(), 0, mOldGeneration.numCoveredCards());
+
+			mMarkStack.clear();
+			mDeferred.clear();
+			for (auto objPtr : roots) {
+				push(objPtr);
+			}
+
+			mSATBQueue.next = mSATBBuffer.get();
+			mSATBQueue.end = mSATBBuffer.get() + mSATBBufferSize;
+			mDrained = mSATBQueue.next;
+
+			mMarking = true;
+			mWorking = true;
+			mPauseRequested = false;
+
+			if (!mThread.joinable()) {
+				mThread = std::thread([this]() {
+					markerLoop();
+				});
+			}
+		}
+
+		mCondition.notify_all();
+	}
+
+	void ConcurrentMarker::pause() {
+		std::unique_lock<std::mutex> lock(mMutex);
+		mPauseRequested = true;
+		mCondition.wait(lock, [this]() {
+			return !mInBatch;
+		});
+	}
+
+	void ConcurrentMarker::resume() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mPauseRequested = false;
+
+			//The program is stopped, so the log can be emptied
+			if (mMarking) {
+				bool isFull = mSATBQueue.next == mSATBQueue.end;
+				drainQueue();
+
+				if (!isFull) {
+					mSATBQueue.next = mSATBBuffer.get();
+					mDrained = mSATBQueue.next;
+				}
+
+				if (!mMarkStack.empty()) {
+					mWorking = true;
+				}
+			}
+		}
+
+		mCondition.notify_all();
+	}
+
+	bool ConcurrentMarker::finish() {
+		pause();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		bool isFull = mSATBQueue.next == mSATBQueue.end;
+
+		//The slots that were skipped are read now, which also keeps the objects written to them alive
+		drainQueue();
+		for (auto objPtr : mDeferred) {
+			visitReferences(objPtr, false);
+		}
+
+		bool hasMore = true;
+		while (hasMore) {
+			hasMore = markBatch(false);
+		}
+
+		mSATBQueue.next = nullptr;
+		mSATBQueue.end = nullptr;
+		mDrained = nullptr;
+		mMarkStack.clear();
+		mDeferred.clear();
+
+		mMarking = false;
+		mWorking = false;
+		mPauseRequested = false;
+		return !isFull;
+	}
+}
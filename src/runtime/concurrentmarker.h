@@ -0,0 +1,115 @@
+#pragma once
+#include "../type/objectref.h"
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace stackjit {
+	class CollectorGeneration;
+	class HeapMemory;
+
+	//Marks the old generation on a background thread while the program runs. The marking finds the objects that were
+	//alive when it started (snapshot-at-the-beginning): the write barrier logs the references that are overwritten while
+	//marking, and the objects allocated in the old generation after the start are considered alive.
+	//The young objects are not traced, as they are moved by the young collections. Instead, all of them are roots.
+	//The objects outside the heaps are large objects, which are marked without being traced.
+	class ConcurrentMarker {
+	public:
+		//The log of overwritten references, written by the write barrier in the generated code.
+		//The next entry is null when not marking, and equal to the end when the log is full.
+		struct SATBQueue {
+			PtrValue* next;
+			PtrValue* end;
+
+			//The table of the cards modified while marking, biased as the card table of the old generation
+			PtrValue biasedModUnionTable;
+		};
+	private:
+		const CollectorGeneration& mOldGeneration;
+		const HeapMemory& mHeapMemory;
+
+		std::unique_ptr<PtrValue[]> mSATBBuffer;
+		const std::size_t mSATBBufferSize;
+		SATBQueue mSATBQueue;
+		PtrValue* mDrained;
+
+		//Marks the cards that had a reference written while marking. Such a slot can't be read by the marker, as the
+		//write might not be atomic. The overwritten reference has been logged instead.
+		std::unique_ptr<unsigned char[]> mModUnionTable;
+
+		//The objects at or after this address were allocated during the marking
+		BytePtr mSnapshotEnd = nullptr;
+		std::vector<RawObjectRef> mMarkStack;
+
+		//The marked objects with slots that were skipped, as they had been written while marking
+		std::vector<RawObjectRef> mDeferred;
+
+		std::thread mThread;
+		std::mutex mMutex;
+		std::condition_variable mCondition;
+		bool mMarking = false;
+		bool mWorking = false;
+		bool mInBatch = false;
+		bool mPauseRequested = false;
+		bool mStop = false;
+
+		//The loop run by the marker thread
+		void markerLoop();
+
+		//Pushes the given object to the mark stack if it is an old object that existed when the marking started.
+		//Large objects are marked directly.
+		void push(RawObjectRef objPtr);
+
+		//Pushes the references logged by the write barrier
+		void drainQueue();
+
+		//Indicates if the given reference slot has been written while marking
+		bool isModified(const PtrValue* referencePtr) const;
+
+		//Pushes the objects that the given object refers to. If concurrent, the slots written while marking are skipped
+		//and the object is deferred to the end of the marking.
+		void visitReferences(RawObjectRef objPtr, bool concurrent);
+
+		//Marks the given object and pushes the objects it refers to
+		void markObject(RawObjectRef objPtr, bool concurrent);
+
+		//Marks a limited number of objects. Returns false when out of objects.
+		bool markBatch(bool concurrent);
+	public:
+		//Creates a new marker for the given old generation, where the log holds the given number of references.
+		//The given memory holds the heaps of the generations.
+		ConcurrentMarker(const CollectorGeneration& oldGeneration, const HeapMemory& heapMemory, std::size_t satbBufferSize);
+		~ConcurrentMarker();
+
+		//Prevent the marker from being copied
+		ConcurrentMarker(const ConcurrentMarker&) = delete;
+		ConcurrentMarker& operator=(const ConcurrentMarker&) = delete;
+
+		//Returns the log of overwritten references
+		SATBQueue* queue();
+
+		//Indicates if a marking has been started and not finished
+		bool isMarking();
+
+		//Indicates if the marker thread has run out of objects. The marking can then be finished with a short pause.
+		bool isDone();
+
+		//Starts marking from the given roots. The old objects and the large objects must be unmarked.
+		void start(const std::vector<RawObjectRef>& roots);
+
+		//Pauses the marker thread, which must be done before the heaps are changed by a collection
+		void pause();
+
+		//Resumes the marker thread. The logged references are moved to the mark stack, which empties the log.
+		void resume();
+
+		//Returns the end of the old generation when the marking started. The objects after it were allocated while marking.
+		BytePtr snapshotEnd() const;
+
+		//Finishes the marking on the calling thread. Returns false if the log was full, in which case references might
+		//have been lost and the objects must be marked again.
+		bool finish();
+	};
+}
@@ -0,0 +1,59 @@
+#include "forwardingtable.h"
+#include "managedheap.h"
+#include <stdexcept>
+
+namespace stackjit {
+	ForwardingTable::ForwardingTable(const ManagedHeap& heap)
+		: mHeap(heap),
+		  mNextHeap(nullptr),
+		  mEntries(heap.size() / GRANULE_SIZE + 1, 0) {
+
+	}
+
+	std::size_t ForwardingTable::entryIndex(BytePtr objPtr) const {
+		return (std::size_t)(objPtr - mHeap.start()) / GRANULE_SIZE;
+	}
+
+	void ForwardingTable::resize() {
+		mEntries.resize(mHeap.size() / GRANULE_SIZE + 1, 0);
+	}
+
+	void ForwardingTable::setNextHeap(const ManagedHeap* nextHeap) {
+		mNextHeap = nextHeap;
+	}
+
+	bool ForwardingTable::inside(BytePtr objPtr) const {
+		return mHeap.inside(objPtr);
+	}
+
+	void ForwardingTable::set(BytePtr objPtr, BytePtr newObjPtr) {
+		std::uint64_t entry;
+		if (mHeap.inside(newObjPtr)) {
+			entry = (std::uint64_t)(newObjPtr - mHeap.start() + 1) << 1;
+		} else if (mNextHeap != nullptr && mNextHeap->inside(newObjPtr)) {
+			entry = ((std::uint64_t)(newObjPtr - mNextHeap->start() + 1) << 1) | 1;
+		} else {
+			throw std::runtime_error("The new location of the object is outside the heaps.");
+		}
+
+		if (entry > UINT32_MAX) {
+			throw std::runtime_error("The heap is too large for the forwarding table.");
+		}
+
+		mEntries[entryIndex(objPtr)] = (std::uint32_t)entry;
+	}
+
+	void ForwardingTable::clear(BytePtr objPtr) {
+		mEntries[entryIndex(objPtr)] = 0;
+	}
+
+	BytePtr ForwardingTable::get(BytePtr objPtr) const {
+		auto entry = mEntries[entryIndex(objPtr)];
+		if (entry == 0) {
+			return nullptr;
+		}
+
+		auto heapStart = (entry & 1) == 0 ? mHeap.start() : mNextHeap->start();
+		return heapStart + (entry >> 1) - 1;
+	}
+}
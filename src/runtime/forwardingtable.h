@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../stackjit.h"
+
+namespace stackjit {
+	class ManagedHeap;
+
+	//Holds the new locations of the objects in a heap while it is compacted. An object is either moved within
+	//the heap, or promoted to the heap of the next generation. There is one entry for each 8 bytes of the heap,
+	//which means that objects never share an entry, as the header alone is larger than 8 bytes.
+	class ForwardingTable {
+	private:
+		static const std::size_t GRANULE_SIZE = 8;
+
+		const ManagedHeap& mHeap;
+		const ManagedHeap* mNextHeap;
+
+		//The entries hold the offset (plus one) of the new location in the upper bits, and if the new location
+		//is in the next heap in the lowest bit. Zero means that the object has no new location.
+		std::vector<std::uint32_t> mEntries;
+
+		//Returns the entry for the given object
+		std::size_t entryIndex(BytePtr objPtr) const;
+	public:
+		//Creates a new forwarding table for the given heap
+		ForwardingTable(const ManagedHeap& heap);
+
+		//Resizes the table to the size of the heap, after the heap has grown
+		void resize();
+
+		//Sets the heap that promoted objects are moved to
+		void setNextHeap(const ManagedHeap* nextHeap);
+
+		//Indicates if the given object is in the heap of the table
+		bool inside(BytePtr objPtr) const;
+
+		//Sets the new location of the given object. The new location must be in the heap or in the next heap.
+		void set(BytePtr objPtr, BytePtr newObjPtr);
+
+		//Removes the new location of the given object
+		void clear(BytePtr objPtr);
+
+		//Returns the new location of the given object, or null if it has none
+		BytePtr get(BytePtr objPtr) const;
+	};
+}
@@ -0,0 +1,131 @@
+#include "freelists.h"
+#include "managedheap.h"
+#include <cstring>
+#include <algorithm>
+
+namespace stackjit {
+	namespace {
+		//The number of size classes, which covers blocks up to the largest heap
+		const std::size_t NUM_SIZE_CLASSES = 48;
+
+		//Smaller blocks are not added to the lists, as few objects fit in them
+		const std::size_t MIN_BLOCK_SIZE = 32;
+
+		//The number of blocks searched in a class that can hold too small blocks
+		const std::size_t MAX_SEARCH = 8;
+
+		//The blocks that are smaller are counted as fragmented
+		const std::size_t FRAGMENT_SIZE = 4096;
+	}
+
+	FreeLists::FreeLists()
+		: mLists(NUM_SIZE_CLASSES), mClassBytes(NUM_SIZE_CLASSES) {
+
+	}
+
+	std::size_t FreeLists::sizeClass(std::size_t size) {
+		std::size_t sizeClass = 0;
+		while (size > 1) {
+			size >>= 1;
+			sizeClass++;
+		}
+
+		return sizeClass;
+	}
+
+	void FreeLists::fill(BytePtr start, std::size_t size) {
+		ManagedHeap::makeDeadObject(start, size);
+	}
+
+	std::size_t FreeLists::freeBytes() const {
+		return mFreeBytes;
+	}
+
+	std::size_t FreeLists::unlistedBytes() const {
+		return mUnlistedBytes;
+	}
+
+	std::size_t FreeLists::fragmentedBytes() const {
+		auto fragmentedBytes = mUnlistedBytes;
+		for (std::size_t sizeClass = 0; sizeClass < FreeLists::sizeClass(FRAGMENT_SIZE); sizeClass++) {
+			fragmentedBytes += mClassBytes[sizeClass];
+		}
+
+		return fragmentedBytes;
+	}
+
+	void FreeLists::clear() {
+		for (auto& list : mLists) {
+			list.clear();
+		}
+
+		std::fill(mClassBytes.begin(), mClassBytes.end(), 0);
+		mFreeBytes = 0;
+		mUnlistedBytes = 0;
+	}
+
+	void FreeLists::add(BytePtr start, std::size_t size) {
+		fill(start, size);
+
+		if (size >= MIN_BLOCK_SIZE) {
+			auto blockClass = sizeClass(size);
+			mLists[blockClass].push_back(start);
+			mClassBytes[blockClass] += size;
+			mFreeBytes += size;
+		} else {
+			mUnlistedBytes += size;
+		}
+	}
+
+	BytePtr FreeLists::takeBlock(std::size_t blockClass, std::size_t index, std::size_t size) {
+		auto& list = mLists[blockClass];
+		auto blockPtr = list[index];
+		auto blockSize = *(std::size_t*)blockPtr;
+		list[index] = list.back();
+		list.pop_back();
+		mClassBytes[blockClass] -= blockSize;
+		mFreeBytes -= blockSize;
+
+		//The end of the block is allocated, which means that the rest of it keeps its start
+		auto restSize = blockSize - size;
+		if (restSize > 0) {
+			add(blockPtr, restSize);
+		}
+
+		auto objPtr = blockPtr + restSize;
+		std::memset(objPtr, 0, size);
+		return objPtr;
+	}
+
+	BytePtr FreeLists::allocate(std::size_t size) {
+		//The rest of the block must either be empty, or large enough for a dead object
+		auto minSize = size + stackjit::OBJECT_HEADER_SIZE;
+		auto fits = [&](BytePtr blockPtr) {
+			auto blockSize = *(std::size_t*)blockPtr;
+			return blockSize == size || blockSize >= minSize;
+		};
+
+		//The classes that can hold blocks that are too small are searched for a bounded number of blocks
+		auto firstFitClass = FreeLists::sizeClass(minSize) + 1;
+		for (auto sizeClass = FreeLists::sizeClass(size); sizeClass < firstFitClass; sizeClass++) {
+			auto& list = mLists[sizeClass];
+			auto searchEnd = list.size() > MAX_SEARCH ? list.size() - MAX_SEARCH : 0;
+
+			for (auto i = list.size(); i > searchEnd; i--) {
+				if (fits(list[i - 1])) {
+					return takeBlock(sizeClass, i - 1, size);
+				}
+			}
+		}
+
+		//Any block in the later classes fits
+		for (auto sizeClass = firstFitClass; sizeClass < NUM_SIZE_CLASSES; sizeClass++) {
+			auto& list = mLists[sizeClass];
+			if (!list.empty()) {
+				return takeBlock(sizeClass, list.size() - 1, size);
+			}
+		}
+
+		return nullptr;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "../type/objectref.h"
+#include <vector>
+
+namespace stackjit {
+	//Holds the free memory blocks of a heap that is swept instead of compacted. The blocks are kept in lists by size class,
+	//where a class holds the blocks with sizes between two powers of two. The free blocks are covered by dead objects,
+	//which keeps the whole heap walkable.
+	class FreeLists {
+	private:
+		std::vector<std::vector<BytePtr>> mLists;
+		std::vector<std::size_t> mClassBytes;
+		std::size_t mFreeBytes = 0;
+		std::size_t mUnlistedBytes = 0;
+
+		//Returns the size class of the given size. Every block in a class is at least the size of the class.
+		static std::size_t sizeClass(std::size_t size);
+
+		//Covers the given memory with a dead object
+		static void fill(BytePtr start, std::size_t size);
+
+		//Allocates the given size from the end of the block at the given index in the list of the given class
+		BytePtr takeBlock(std::size_t blockClass, std::size_t index, std::size_t size);
+	public:
+		//Creates empty lists
+		FreeLists();
+
+		//Returns the number of bytes in the lists
+		std::size_t freeBytes() const;
+
+		//Returns the number of bytes in the blocks too small to be in the lists
+		std::size_t unlistedBytes() const;
+
+		//Returns the number of bytes in the small blocks, including those too small to be in the lists
+		std::size_t fragmentedBytes() const;
+
+		//Removes all the blocks
+		void clear();
+
+		//Adds the given memory block. Blocks too small to be allocated in are only covered by a dead object.
+		void add(BytePtr start, std::size_t size);
+
+		//Allocates a zeroed memory block of the given size. The last blocks in the classes that can fit it are tried first,
+		//then the smallest class that is certain to fit it. The rest of the free block is added back to the lists,
+		//and keeps the start of the block.
+		//Returns nullptr if not allocated.
+		BytePtr allocate(std::size_t size);
+	};
+}
@@ -1,5 +1,7 @@
 #include "gc.h"
 #include "../type/type.h"
+#include "../core/function.h"
+#include "../core/instruction.h"
 #include "../vmstate.h"
 #include "../compiler/x64/amd64.h"
 #include "../stackjit.h"
@@ -10,15 +12,140 @@
 #include <sstream>
 #include <string.h>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 namespace stackjit {
 	namespace {
+		const std::size_t CARD_SIZE = 1024;
+
+		//The heap is divided into more compaction regions than workers, as the regions differ in the number of alive objects
+		const std::size_t REGIONS_PER_WORKER = 4;
+		const std::size_t MIN_REGION_SIZE = 64 * 1024;
+
+		//The size of the regions when the old generation is divided into regions
+		const std::size_t HEAP_REGION_SIZE = 256 * 1024;
+
+		//Regions with more alive objects than this (in percent of the region) are not worth evacuating
+		const std::size_t MAX_EVACUATED_LIVE_PERCENT = 85;
+
+		//The evacuation rate (bytes per millisecond) assumed before the first evacuation has been measured
+		const double INITIAL_EVACUATION_RATE = 256 * 1024;
+
+		//The number of overwritten references that can be logged between two collections while marking concurrently
+		const std::size_t SATB_BUFFER_SIZE = 256 * 1024;
+
+		//The GC info of an object in the from-space of the copying collector that has been copied. The type in the header is
+		//replaced by the new location. Young objects are promoted long before their survival count gives this GC info.
+		const unsigned char FORWARDED_OBJECT = 0xFE;
+
+		//When collecting by bytes, the old generation is collected when this much of it (in percent) is used
+		const std::size_t OLD_OCCUPANCY_PERCENT = 80;
+
+		//The old generation grows to make this much of it (in percent) used, when still above the occupancy after a collection
+		const std::size_t EXPANDED_OCCUPANCY_PERCENT = 60;
+
+		//The number of collections that a young object survives before it is promoted, unless adapted
+		const int PROMOTION_AGE = 5;
+
+		//The smallest size that the adaptive sizing shrinks the young generation to
+		const std::size_t MIN_YOUNG_GENERATION_SIZE = 256 * 1024;
+
+		//The swept old generation is compacted when the small free blocks hold this much (in percent) of its free memory
+		const std::size_t FRAGMENTATION_PERCENT = 50;
+
+		//The offsets in the forwarding table are 31 bits, and the offsets in the crossing map 32 bits.
+		//This also limits the size of the young generation, which has a forwarding table too.
+		const std::size_t MAX_OLD_GENERATION_SIZE = (std::size_t)1 << 31;
+
+		//Rounds the given size up to a multiple of the region size. The sizes of the generations are multiples of it.
+		std::size_t roundUpToRegionSize(std::size_t size) {
+			return (size + HEAP_REGION_SIZE - 1) & ~(HEAP_REGION_SIZE - 1);
+		}
+
+		//Returns the size of the memory used by the young generation
+		std::size_t youngGenerationMemorySize(const VMStateConfig& config) {
+			return config.youngGenerationSize * (config.copyingYoungCollector ? 2 : 1);
+		}
+
+		//Returns the size that the old generation can grow to
+		std::size_t maxOldGenerationSize(const VMStateConfig& config) {
+			if (config.youngGenerationSize == 0 || config.oldGenerationSize == 0
+				|| config.youngGenerationSize % HEAP_REGION_SIZE != 0 || config.oldGenerationSize % HEAP_REGION_SIZE != 0) {
+				throw std::runtime_error("The sizes of the generations must be non-zero multiples of 256 KB.");
+			}
+
+			if (config.youngGenerationSize >= MAX_OLD_GENERATION_SIZE || config.oldGenerationSize >= MAX_OLD_GENERATION_SIZE) {
+				throw std::runtime_error("The sizes of the generations must be less than 2 GB.");
+			}
+
+			auto youngSize = youngGenerationMemorySize(config);
+			if (config.maxHeapSize < youngSize + config.oldGenerationSize) {
+				throw std::runtime_error("The maximum heap size must be at least the size of the generations.");
+			}
+
+			auto maxOldSize = std::min(
+				(config.maxHeapSize - youngSize) & ~(HEAP_REGION_SIZE - 1),
+				MAX_OLD_GENERATION_SIZE - HEAP_REGION_SIZE);
+			return std::max(maxOldSize, config.oldGenerationSize);
+		}
+
 		void printTimes(char c, int times) {
 			for (int i = 0; i < times; i++) {
 				std::cout << c;
 			}
 		}
 
+		//Prefetches the header of the given object
+		inline void prefetchObject(RawObjectRef objPtr) {
+		#if defined(__GNUC__)
+			__builtin_prefetch(objPtr - stackjit::OBJECT_HEADER_SIZE);
+		#elif defined(_MSC_VER)
+			_mm_prefetch((const char*)(objPtr - stackjit::OBJECT_HEADER_SIZE), _MM_HINT_T0);
+		#endif
+		}
+
+		//Visits the reference slots of the given object that are inside the given memory range.
+		//For large arrays, only the elements inside the range are visited.
+		template<typename Fn>
+		void visitReferenceSlots(ObjectRef objRef, BytePtr start, BytePtr end, Fn fn) {
+			if (objRef.type()->isArray()) {
+				auto arrayType = static_cast<const ArrayType*>(objRef.type());
+				if (arrayType->elementType()->isReference()) {
+					ArrayRef<PtrValue> arrayRef(objRef.dataPtr());
+					auto elements = (BytePtr)arrayRef.elementsPtr();
+					auto elementSize = (std::ptrdiff_t)sizeof(PtrValue);
+
+					std::ptrdiff_t first = 0;
+					if (start > elements) {
+						first = (start - elements + elementSize - 1) / elementSize;
+					}
+
+					std::ptrdiff_t last = 0;
+					if (end > elements) {
+						last = std::min((std::ptrdiff_t)arrayRef.length(), (end - elements + elementSize - 1) / elementSize);
+					}
+
+					for (auto i = first; i < last; i++) {
+						fn(arrayRef.elementsPtr() + i);
+					}
+				}
+			} else if (objRef.type()->isClass()) {
+				auto classType = static_cast<const ClassType*>(objRef.type());
+				for (auto fieldOffset : classType->metadata()->referenceFieldOffsets()) {
+					auto fieldPtr = objRef.dataPtr() + fieldOffset;
+					if (fieldPtr >= start && fieldPtr < end) {
+						fn((PtrValue*)fieldPtr);
+					}
+				}
+			}
+		}
+
 		std::string ptrToString(BytePtr ptr) {
 			std::stringstream stringstream;
 			stringstream << std::hex << "0x" << (std::size_t)ptr << std::dec;
@@ -33,9 +160,58 @@ namespace stackjit {
 
 	GarbageCollector::GarbageCollector(VMState& vmState)
 			: mVMState(vmState),
-			  mYoungGeneration(4 * 1024 * 1024, (std::size_t)vmState.config.allocationsBeforeGC, 5),
-			  mOldGeneration(8 * 1024 * 1024, (std::size_t)vmState.config.allocationsBeforeGC, -1, 1024) {
+			  mMaxOldGenerationSize(maxOldGenerationSize(vmState.config)),
+			  mHeapMemory(mMaxOldGenerationSize + youngGenerationMemorySize(vmState.config)),
+			  mYoungGeneration(
+				  mHeapMemory.data() + mMaxOldGenerationSize,
+				  vmState.config.youngGenerationSize,
+				  (std::size_t)vmState.config.allocationsBeforeGC,
+				  PROMOTION_AGE),
+			  mOldGeneration(
+				  mHeapMemory.data(),
+				  vmState.config.oldGenerationSize,
+				  (std::size_t)vmState.config.allocationsBeforeGC,
+				  -1,
+				  CARD_SIZE,
+				  mHeapMemory.size() - vmState.config.oldGenerationSize),
+			  mYoungToSpace(
+				  mHeapMemory.data() + mMaxOldGenerationSize + vmState.config.youngGenerationSize,
+				  vmState.config.copyingYoungCollector ? vmState.config.youngGenerationSize : 0),
+			  mWorkers(vmState.config.gcThreads),
+			  mEvacuationRate(INITIAL_EVACUATION_RATE),
+			  mSizePolicy(
+				  MIN_YOUNG_GENERATION_SIZE,
+				  vmState.config.youngGenerationSize,
+				  vmState.config.gcPauseTarget,
+				  PROMOTION_AGE) {
+		//The memory after the old generation is committed when it grows
+		if (!mHeapMemory.commit(mOldGeneration.heap().start(), mOldGeneration.heap().size())
+			|| !mHeapMemory.commit(mYoungGeneration.heap().start(), youngGenerationMemorySize(vmState.config))) {
+			throw std::runtime_error("Could not allocate the heap.");
+		}
 
+		if (vmState.config.sweepOldGeneration) {
+			if (vmState.config.regionOldGeneration) {
+				throw std::runtime_error("The old generation can't both be swept and divided into regions.");
+			}
+
+			mOldGeneration.useFreeLists();
+		}
+
+		if (vmState.config.regionOldGeneration) {
+			//The marker considers the objects after the end of the old generation at the start of the marking to be new
+			if (vmState.config.concurrentOldMarking) {
+				throw std::runtime_error("Concurrent marking can't be used when the old generation is divided into regions.");
+			}
+
+			mOldGeneration.useRegions(HEAP_REGION_SIZE);
+		}
+
+		if (vmState.config.concurrentOldMarking) {
+			mConcurrentMarker.reset(new ConcurrentMarker(mOldGeneration, mHeapMemory, SATB_BUFFER_SIZE));
+		}
+
+		setYoungAllocationLimit();
 	}
 
 	CollectorGeneration& GarbageCollector::youngGeneration() {
@@ -54,6 +230,10 @@ namespace stackjit {
 		return mOldGeneration;
 	}
 
+	ConcurrentMarker* GarbageCollector::concurrentMarker() const {
+		return mConcurrentMarker.get();
+	}
+
 	CollectorGeneration& GarbageCollector::getGeneration(int generationNumber) {
 		switch (generationNumber) {
 			case 0:
@@ -94,23 +274,129 @@ namespace stackjit {
 		return &mOldGeneration == &generation;
 	}
 
+	bool GarbageCollector::isLargeObject(const Type* type, std::size_t size) const {
+		if (mVMState.config.largeObjectSize == 0 || size <= mVMState.config.largeObjectSize || !type->isArray()) {
+			return false;
+		}
+
+		//The large objects are not traced, which means that they can't contain references
+		return !static_cast<const ArrayType*>(type)->elementType()->isReference();
+	}
+
+	bool GarbageCollector::inLargeObjectSpace(BytePtr objPtr) const {
+		return !mHeapMemory.inside(objPtr);
+	}
+
+	std::size_t GarbageCollector::availableHeapSize() const {
+		auto usedSize = youngGenerationMemorySize(mVMState.config) + mOldGeneration.heap().size() + mLargeObjects.size();
+		if (usedSize >= mVMState.config.maxHeapSize) {
+			return 0;
+		}
+
+		return mVMState.config.maxHeapSize - usedSize;
+	}
+
+	bool GarbageCollector::growOldGeneration(std::size_t size) {
+		auto& heap = mOldGeneration.heap();
+		auto maxGrowth = std::min(mMaxOldGenerationSize - heap.size(), availableHeapSize() & ~(HEAP_REGION_SIZE - 1));
+		if (maxGrowth == 0) {
+			return false;
+		}
+
+		//The generation grows by at least half of its size, which keeps the number of times that it grows low
+		auto growth = std::min(std::max(roundUpToRegionSize(size), roundUpToRegionSize(heap.size() / 2)), maxGrowth);
+		if (!mHeapMemory.commit(heap.start() + heap.size(), growth)) {
+			return false;
+		}
+
+		mOldGeneration.grow(growth);
+
+		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+			std::cout << "Old generation grown to " << heap.size() << " bytes." << std::endl;
+		}
+
+		return true;
+	}
+
+	BytePtr GarbageCollector::allocateInOldGeneration(std::size_t size) {
+		auto objPtr = mOldGeneration.tryAllocate(size);
+		while (objPtr == nullptr && growOldGeneration(size)) {
+			objPtr = mOldGeneration.tryAllocate(size);
+		}
+
+		if (objPtr == nullptr) {
+			Runtime::outOfMemoryError();
+		}
+
+		//The objects allocated in the free blocks while marking concurrently are alive, as those allocated after the snapshot
+		if (mConcurrentMarker != nullptr && objPtr < mConcurrentMarker->snapshotEnd() && mConcurrentMarker->isMarking()) {
+			mAllocatedWhileMarking.push_back(objPtr);
+		}
+
+		return objPtr;
+	}
+
+	BytePtr GarbageCollector::allocateLargeObject(std::size_t size) {
+		BytePtr objPtr = nullptr;
+		if (LargeObjectSpace::chunkSize(size) <= availableHeapSize()) {
+			objPtr = mLargeObjects.allocate(size);
+		}
+
+		//The GC call before the allocation has made a full collection if the object didn't fit
+		if (objPtr == nullptr) {
+			Runtime::outOfMemoryError();
+		}
+
+		//The large objects are collected with the old generation, which follows the young collection requested here
+		if (needsToCollectLargeObjects()) {
+			mYoungGeneration.setAllocationLimit(mYoungGeneration.heap().start());
+		}
+
+		return objPtr;
+	}
+
 	RawObjectRef GarbageCollector::allocateObject(CollectorGeneration& generation, const Type* type, std::size_t size) {
 		auto fullSize = stackjit::OBJECT_HEADER_SIZE + size;
-		auto objPtr = generation.allocate(fullSize);
+		bool isLarge = isLargeObject(type, fullSize);
+
+		BytePtr objPtr;
+		if (isLarge) {
+			objPtr = allocateLargeObject(fullSize);
+		} else {
+			objPtr = generation.tryAllocate(fullSize);
+		}
+
+		if (objPtr == nullptr) {
+			objPtr = allocateInOldGeneration(fullSize);
 
-		std::memset(objPtr, 0, fullSize);
+			//The young generation is collected at the next allocation if it is too full for the object
+			if (fullSize <= generation.heap().size()) {
+				generation.setAllocationLimit(generation.heap().start());
+			}
+
+			//The stores into new objects can be made without marking cards, as they are assumed to be in the young generation
+			for (auto cardNumber = mOldGeneration.getCardNumber(objPtr);
+				 cardNumber <= mOldGeneration.getCardNumber(objPtr + fullSize - 1);
+				 cardNumber++) {
+				mOldGeneration.cardTable()[cardNumber] = 1;
+			}
+		}
 
-		//Set the header
+		//Set the header. As the heap is zeroed, the data of the object is already zero.
 		Helpers::setValue<std::size_t>(objPtr, 0, (PtrValue)type); //Type
 		Helpers::setValue<unsigned char>(objPtr, sizeof(PtrValue), 0); //GC info
 
+		//The large objects allocated while marking concurrently are alive, as the objects allocated in the old generation
+		if (isLarge && mConcurrentMarker != nullptr && mConcurrentMarker->isMarking()) {
+			ObjectRef(objPtr + stackjit::OBJECT_HEADER_SIZE).mark();
+		}
+
 		//The returned pointer is to the data
 		return objPtr + stackjit::OBJECT_HEADER_SIZE;
 	}
 
 	void GarbageCollector::deleteObject(ObjectRef objRef) {
-		Helpers::setValue<std::size_t>(objRef.fullPtr(), 0, objRef.fullSize());  //The amount of data to skip from the start.
-		Helpers::setValue<unsigned char>(objRef.fullPtr(), sizeof(std::size_t), 0xFF); //Indicator for dead object
+		ManagedHeap::makeDeadObject(objRef.fullPtr(), objRef.fullSize());
 	}
 
 	RawArrayRef GarbageCollector::newArray(const ArrayType* arrayType, int length) {
@@ -149,84 +435,173 @@ namespace stackjit {
 	    return classPtr;
 	}
 
-	void GarbageCollector::markObject(CollectorGeneration& generation, ObjectRef objRef) {
-		//Don't mark objects in the old generation
-		if (isYoung(generation) && !generation.heap().inside(objRef.fullPtr())) {
+	void GarbageCollector::pushMarkStack(CollectorGeneration& generation, int workerNumber, RawObjectRef objPtr) {
+		//Don't mark nulls
+		if (objPtr == nullptr) {
 			return;
 		}
 
-		if (!objRef.isMarked()) {
-			if (objRef.type()->isArray()) {
+		//Don't mark objects in other generations
+		auto fullPtr = objPtr - stackjit::OBJECT_HEADER_SIZE;
+		if (!generation.heap().inside(fullPtr)) {
+			//The large objects have no references, which means that they are done when marked
+			if (isOld(generation) && inLargeObjectSpace(fullPtr)) {
+				ObjectRef(objPtr).tryMark();
+			}
+
+			return;
+		}
+
+		//The header is read when the object is popped, which gives the memory time to load it
+		prefetchObject(objPtr);
+		mMarkStacks.push(workerNumber, objPtr);
+	}
+
+	void GarbageCollector::markObjects(CollectorGeneration& generation, int workerNumber) {
+		//The reachable objects are traversed using explicit stacks, as long chains of objects could overflow the native stack
+		bool parallel = mMarkStacks.numWorkers() > 1;
+		RawObjectRef objPtr;
+
+		while (mMarkStacks.pop(workerNumber, objPtr)) {
+			ObjectRef objRef(objPtr);
+
+			//Workers can reach the same object at the same time, but only one of them marks it
+			if (parallel) {
+				if (!objRef.tryMark()) {
+					continue;
+				}
+			} else {
+				if (objRef.isMarked()) {
+					continue;
+				}
+
 				objRef.mark();
+			}
 
+			if (objRef.type()->isArray()) {
 				//Mark ref elements
 				auto arrayType = static_cast<const ArrayType*>(objRef.type());
 				if (arrayType->elementType()->isReference()) {
 					ArrayRef<PtrValue> arrayRef(objRef.dataPtr());
-					for (int i = 0; i < arrayRef.length(); i++) {
-						markValue(generation, arrayRef.getElement(i), arrayType->elementType());
+					for (int i = arrayRef.length() - 1; i >= 0; i--) {
+						pushMarkStack(generation, workerNumber, (RawObjectRef)arrayRef.getElement(i));
 					}
 				}
 			} else if (objRef.type()->isClass()) {
-				objRef.mark();
-
 				//Mark ref fields
 				auto classType = static_cast<const ClassType*>(objRef.type());
-				for (auto fieldEntry : classType->metadata()->fields()) {
-					auto field = fieldEntry.second;
-
-					if (field.type()->isReference()) {
-						RegisterValue fieldValue = *(PtrValue*)(objRef.dataPtr() + field.offset());
-						markValue(generation, fieldValue, field.type());
-					}
+				for (auto fieldOffset : classType->metadata()->referenceFieldOffsets()) {
+					pushMarkStack(generation, workerNumber, *(RawObjectRef*)(objRef.dataPtr() + fieldOffset));
 				}
 			}
 		}
 	}
 
-	void GarbageCollector::markValue(CollectorGeneration& generation, RegisterValue value, const Type* type) {
-		if (type->isReference()) {
-			auto objPtr = (BytePtr)value;
-
-			//Don't mark nulls
-			if (objPtr == nullptr) {
-				return;
-			}
-
-			markObject(generation, ObjectRef((RawObjectRef)value));
-		}
-	}
-
-	void GarbageCollector::markAllObjects(CollectorGeneration& generation, const StackFrame& stackFrame) {
+	void GarbageCollector::findStackReferences(const StackFrame& stackFrame, StackReferences& stackReferences) {
 		if (mVMState.config.enableDebug && mVMState.config.printGCStackTrace) {
 			std::cout << "Stack trace: " << std::endl;
 		}
 
 		StackWalker stackWalker(mVMState);
-		stackWalker.visitReferences(stackFrame, [this, &generation](StackFrameEntry frameEntry) {
-			markObject(generation, ObjectRef((RawObjectRef) frameEntry.value()));
+		stackWalker.visitReferences(stackFrame, [&stackReferences](RegisterValue* referencePtr) {
+			stackReferences.push_back(referencePtr);
 		}, [this](const StackFrame& currentFrame) {
 			if (mVMState.config.enableDebug && mVMState.config.printGCStackTrace) {
-				std::cout << currentFrame.function()->def().name() << " (" << currentFrame.instructionIndex() << ")" << std::endl;
+				std::cout << currentFrame.function()->def().name() << " (" << currentFrame.instructionIndex() << ")";
+
+				for (auto inlinedFunction : currentFrame.inlinedFunctions()) {
+					std::cout << " -> " << inlinedFunction->function->name() << " (inlined)";
+				}
+
+				std::cout << std::endl;
 				Runtime::Internal::printAliveObjects(currentFrame, "\t");
 			}
 		});
+	}
 
-		//Old objects with references to young objects are also root
-		if (isYoung(generation)) {
-			mOldGeneration.heap().visitObjects([this](ObjectRef objRef) {
-				if (mOldGeneration.cardTable()[mOldGeneration.getCardNumber(objRef.dataPtr())]) {
-					markObject(mOldGeneration, objRef);
-//					std::cout << "old object " << ptrToString(objRef.dataPtr()) << std::endl;
+	void GarbageCollector::findDirtyCards() {
+		mDirtyCards.clear();
+
+		auto cardTable = mOldGeneration.cardTable();
+		for (std::size_t cardNumber = 0; cardNumber < mOldGeneration.numCards(); cardNumber++) {
+			if (cardTable[cardNumber]) {
+				mDirtyCards.push_back(cardNumber);
+			}
+		}
+	}
+
+	void GarbageCollector::visitDirtyCardReferences(BytePtr end, std::function<void (PtrValue*)> fn) {
+		for (auto cardNumber : mDirtyCards) {
+			auto cardStart = mOldGeneration.getCardStart(cardNumber);
+			auto cardEnd = std::min(cardStart + mOldGeneration.cardSize(), end);
+
+			//In a region, the objects allocated by the current collection are after the top it had at the start
+			if (mOldGeneration.regions() != nullptr) {
+				cardEnd = std::min(cardEnd, mOldGeneration.regions()->regionOf(cardStart).collectionTop);
+				if (cardEnd <= cardStart) {
+					continue;
 				}
+			}
+
+			//The card is marked for the slot that was written, so only the slots inside the card are visited
+			mOldGeneration.visitObjectsInCard(cardNumber, [&](ObjectRef objRef) {
+				visitReferenceSlots(objRef, cardStart, cardEnd, fn);
+			});
+		}
+	}
+
+	void GarbageCollector::markCardIfYoung(PtrValue* referencePtr, const ManagedHeap& youngHeap) {
+		if (*referencePtr != 0 && youngHeap.inside((BytePtr)*referencePtr - stackjit::OBJECT_HEADER_SIZE)) {
+			mOldGeneration.cardTable()[mOldGeneration.getCardNumber((BytePtr)referencePtr)] = 1;
+		}
+	}
+
+	void GarbageCollector::findRoots(CollectorGeneration& generation, const StackReferences& stackReferences) {
+		mRoots.clear();
+		for (auto referencePtr : stackReferences) {
+			mRoots.push_back((RawObjectRef)*referencePtr);
+		}
+
+		auto addRoot = [this](PtrValue* referencePtr) {
+			mRoots.push_back((RawObjectRef)*referencePtr);
+		};
+
+		if (isYoung(generation)) {
+			//References from old objects to young objects are also roots. Only the dirty cards can contain such references.
+			findDirtyCards();
+			visitDirtyCardReferences(mOldGeneration.heap().nextAllocation(), addRoot);
+		} else {
+			//The young objects are not traced, which means that all of them are roots. This keeps the old objects
+			//referenced by dead young objects alive until the next collection of the old generation.
+			mYoungGeneration.heap().visitObjects([&](ObjectRef objRef) {
+				visitReferenceSlots(objRef, objRef.fullPtr(), objRef.fullPtr() + objRef.fullSize(), addRoot);
 			});
 		}
 	}
 
-	void GarbageCollector::sweepObjects(CollectorGeneration& generation) {
+	void GarbageCollector::markAllObjects(CollectorGeneration& generation, const StackReferences& stackReferences) {
+		findRoots(generation, stackReferences);
+
+		//The roots are divided between the workers, which then balance the marking by stealing from each other
+		auto numWorkers = mWorkers.numWorkers();
+		mMarkStacks.reset(numWorkers);
+
+		mWorkers.run([&](int workerNumber) {
+			for (std::size_t i = (std::size_t)workerNumber; i < mRoots.size(); i += (std::size_t)numWorkers) {
+				pushMarkStack(generation, workerNumber, mRoots[i]);
+			}
+
+			markObjects(generation, workerNumber);
+		});
+	}
+
+	int GarbageCollector::sweepObjects(CollectorGeneration& generation) {
+		auto& heap = generation.heap();
 		int numDeallocatedObjects = 0;
 
-		generation.heap().visitObjects([&](ObjectRef objRef) {
+		//The dead objects and free blocks between two alive objects become one free block
+		auto freeStart = heap.start();
+		heap.visitObjects([&](ObjectRef objRef) {
 			if (!objRef.isMarked()) {
 				numDeallocatedObjects++;
 
@@ -235,24 +610,87 @@ namespace stackjit {
 					printObject(objRef);
 				}
 
-				deleteObject(objRef);
-			} else {
-				objRef.unmark();
+				return;
+			}
+
+			objRef.unmark();
+
+			if (objRef.fullPtr() > freeStart) {
+				generation.freeBlock(freeStart, (std::size_t)(objRef.fullPtr() - freeStart));
 			}
+
+			freeStart = objRef.fullPtr() + objRef.fullSize();
 		});
 
+		//The free memory at the end is allocated from the end again
+		heap.setNextAllocation(freeStart);
+		return numDeallocatedObjects;
+	}
+
+	bool GarbageCollector::isOldGenerationFragmented() const {
+		auto freeLists = mOldGeneration.freeLists();
+		if (freeLists == nullptr) {
+			return false;
+		}
+
+		auto& heap = mOldGeneration.heap();
+		auto freeBytes = freeLists->freeBytes() + freeLists->unlistedBytes()
+						 + (std::size_t)(heap.start() + heap.size() - heap.nextAllocation());
+		return freeLists->fragmentedBytes() * 100 >= freeBytes * FRAGMENTATION_PERCENT;
+	}
+
+	void GarbageCollector::sweepOldGeneration(const StackReferences& stackReferences) {
+		if (isOldGenerationFragmented()) {
+			mOldGeneration.freeLists()->clear();
+			compactObjects(mOldGeneration, &mOldGeneration, stackReferences);
+			return;
+		}
+
+		mOldGeneration.freeLists()->clear();
+		int numDeallocatedObjects = sweepObjects(mOldGeneration) + sweepLargeObjects();
+
 		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+			std::cout << "Swept: " << mOldGeneration.freeLists()->freeBytes() << " bytes in the free lists." << std::endl;
 			std::cout << "Deallocated: " << numDeallocatedObjects << " objects." << std::endl;
 			std::cout << "GC time: " << Helpers::getDuration(mGCStart) << " ms." << std::endl;
 		}
 	}
 
-	BytePtr GarbageCollector::computeNewLocations(CollectorGeneration& generation, ForwardingTable& forwardingAddress, std::vector<BytePtr>& promotedObjects) {
-		auto free = generation.heap().data();
-		generation.heap().visitObjects([&](ObjectRef objRef) {
+	int GarbageCollector::sweepLargeObjects() {
+		return mLargeObjects.sweep([this](ObjectRef objRef) {
+			if (mVMState.config.enableDebug && mVMState.config.printDeallocation) {
+				std::cout << "Deleted object: ";
+				printObject(objRef);
+			}
+		});
+	}
+
+	BytePtr GarbageCollector::computeNewLocations(CollectorGeneration& generation, std::vector<BytePtr>& promotedObjects) {
+		auto& forwardingTable = generation.forwardingTable();
+		auto& heap = generation.heap();
+		auto free = heap.data();
+
+		auto numWorkers = (std::size_t)mWorkers.numWorkers();
+		auto regionSize = heap.size();
+		if (numWorkers > 1) {
+			regionSize = std::max(MIN_REGION_SIZE, (heap.nextAllocation() - heap.data()) / (numWorkers * REGIONS_PER_WORKER));
+		}
+
+		mCompactionRegions.clear();
+		mCompactionRegions.push_back({ heap.data(), nullptr, free, 0 });
+
+		heap.visitObjects([&](ObjectRef objRef) {
+			if (objRef.fullPtr() >= mCompactionRegions.back().start + regionSize) {
+				mCompactionRegions.back().end = objRef.fullPtr();
+				mCompactionRegions.push_back({ objRef.fullPtr(), nullptr, free, 0 });
+			}
+
+			//The entries for dead objects are cleared, as they could remain from a previous collection
+			forwardingTable.clear(objRef.fullPtr());
+
 			if (objRef.isMarked()) {
 				if (!generation.needsToPromote(objRef.survivalCount())) {
-					forwardingAddress.insert({ objRef.fullPtr(), free });
+					forwardingTable.set(objRef.fullPtr(), free);
 					free += objRef.fullSize();
 				} else {
 					promotedObjects.push_back(objRef.fullPtr());
@@ -260,86 +698,200 @@ namespace stackjit {
 			}
 		});
 
+		mCompactionRegions.back().end = heap.nextAllocation();
 		return free;
 	}
 
-	void GarbageCollector::updateReference(ForwardingTable& forwardingAddress, PtrValue* objRef) {
+	void GarbageCollector::updateReference(const ForwardingTable& forwardingTable, PtrValue* objRef) {
 		if (*objRef != 0) {
 			auto oldAddress = ((BytePtr)*objRef) - stackjit::OBJECT_HEADER_SIZE;
 
 			//It might be that there exists no forwarding, since the object is in another generation
-			if (forwardingAddress.count(oldAddress) > 0) {
-				auto newAddress = forwardingAddress[oldAddress];
-				*objRef = (PtrValue)(newAddress + stackjit::OBJECT_HEADER_SIZE);
+			if (forwardingTable.inside(oldAddress)) {
+				auto newAddress = forwardingTable.get(oldAddress);
+				if (newAddress != nullptr) {
+					*objRef = (PtrValue)(newAddress + stackjit::OBJECT_HEADER_SIZE);
+				}
 			}
 		}
 	}
 
-	void GarbageCollector::updateHeapReferences(CollectorGeneration& generation, ForwardingTable& forwardingAddress) {
+	void GarbageCollector::updateObjectReferences(const ForwardingTable& forwardingTable, ObjectRef objRef) {
+		if (objRef.type()->isArray()) {
+			auto arrayType = static_cast<const ArrayType*>(objRef.type());
+
+			//Update ref elements
+			if (arrayType->elementType()->isReference()) {
+				ArrayRef<PtrValue> arrayRef(objRef.dataPtr());
+				for (int i = 0; i < arrayRef.length(); i++) {
+					updateReference(forwardingTable, arrayRef.elementsPtr() + i);
+				}
+			}
+		} else if (objRef.type()->isClass()) {
+			//Update ref fields
+			auto classType = static_cast<const ClassType*>(objRef.type());
+			for (auto fieldOffset : classType->metadata()->referenceFieldOffsets()) {
+				updateReference(forwardingTable, (PtrValue*)(objRef.dataPtr() + fieldOffset));
+			}
+		}
+	}
+
+	void GarbageCollector::updateHeapReferences(CollectorGeneration& generation, const ForwardingTable& forwardingTable, bool onlyMarked) {
 		generation.heap().visitObjects([&](ObjectRef objRef) {
-			if (objRef.isMarked()) {
-				if (objRef.type()->isArray()) {
-					auto arrayType = static_cast<const ArrayType*>(objRef.type());
-
-					//Update ref elements
-					if (arrayType->elementType()->isReference()) {
-						ArrayRef<PtrValue> arrayRef(objRef.dataPtr());
-						for (int i = 0; i < arrayRef.length(); i++) {
-							updateReference(forwardingAddress, arrayRef.elementsPtr() + i);
-						}
+			if (objRef.isMarked() || !onlyMarked) {
+				updateObjectReferences(forwardingTable, objRef);
+			}
+		});
+	}
+
+	void GarbageCollector::updateRegionReferences(CollectorGeneration& generation, const ForwardingTable& forwardingTable) {
+		std::atomic<std::size_t> nextRegion(0);
+
+		mWorkers.run([&](int workerNumber) {
+			std::size_t regionIndex;
+			while ((regionIndex = nextRegion++) < mCompactionRegions.size()) {
+				auto& region = mCompactionRegions[regionIndex];
+				generation.heap().visitObjects(region.start, region.end, [&](ObjectRef objRef) {
+					if (objRef.isMarked()) {
+						updateObjectReferences(forwardingTable, objRef);
 					}
-				} else if (objRef.type()->isClass()) {
-					//Update ref fields
-					auto classType = static_cast<const ClassType*>(objRef.type());
-					for (auto fieldEntry : classType->metadata()->fields()) {
-						auto field = fieldEntry.second;
-
-						if (field.type()->isReference()) {
-							updateReference(forwardingAddress, (PtrValue*)(objRef.dataPtr() + field.offset()));
-						}
+				});
+			}
+		});
+	}
+
+	void GarbageCollector::updateOldGenerationReferences(const ForwardingTable& forwardingTable,
+														 BytePtr promotedStart,
+														 const PromotedObjects& promotedObjects) {
+		auto updateSlot = [&](PtrValue* referencePtr) {
+			updateReference(forwardingTable, referencePtr);
+			markCardIfYoung(referencePtr, mYoungGeneration.heap());
+			rememberReference(referencePtr);
+		};
+
+		//The objects promoted into free blocks are before the given start, and are visited as part of the dirty cards
+		auto cardTable = mOldGeneration.cardTable();
+		bool inFreeBlocks = mOldGeneration.freeLists() != nullptr;
+		if (inFreeBlocks) {
+			for (auto oldObjPtr : promotedObjects) {
+				auto newObjPtr = forwardingTable.get(oldObjPtr);
+				if (newObjPtr >= promotedStart) {
+					continue;
+				}
+
+				ObjectRef objRef(newObjPtr + stackjit::OBJECT_HEADER_SIZE);
+				for (auto cardNumber = mOldGeneration.getCardNumber(newObjPtr);
+					 cardNumber <= mOldGeneration.getCardNumber(newObjPtr + objRef.fullSize() - 1);
+					 cardNumber++) {
+					if (!cardTable[cardNumber]) {
+						cardTable[cardNumber] = 1;
+						mDirtyCards.push_back(cardNumber);
 					}
 				}
 			}
-		});
+		}
+
+		for (auto cardNumber : mDirtyCards) {
+			cardTable[cardNumber] = 0;
+		}
+
+		//The rest of the promoted objects are visited separately
+		visitDirtyCardReferences(promotedStart, updateSlot);
+
+		for (auto oldObjPtr : promotedObjects) {
+			auto newObjPtr = forwardingTable.get(oldObjPtr);
+			if (!inFreeBlocks || newObjPtr >= promotedStart) {
+				ObjectRef objRef(newObjPtr + stackjit::OBJECT_HEADER_SIZE);
+				visitReferenceSlots(objRef, objRef.fullPtr(), objRef.fullPtr() + objRef.fullSize(), updateSlot);
+			}
+		}
 	}
 
-	void GarbageCollector::updateStackReferences(const GCRuntimeInformation& runtimeInformation, ForwardingTable& forwardingAddress) {
-		StackWalker stackWalker(mVMState);
-		stackWalker.visitReferences(
-			runtimeInformation.stackFrame,
-			[&](StackFrameEntry frameEntry) {
-				updateReference(forwardingAddress, (PtrValue*)frameEntry.valuePtr());
+	void GarbageCollector::rebuildOldGenerationCards() {
+		mOldGeneration.rebuildCrossingMap();
+		mOldGeneration.clearCardTable();
+
+		mOldGeneration.heap().visitObjects([this](ObjectRef objRef) {
+			visitReferenceSlots(objRef, objRef.fullPtr(), objRef.fullPtr() + objRef.fullSize(), [this](PtrValue* referencePtr) {
+				markCardIfYoung(referencePtr, mYoungGeneration.heap());
 			});
+		});
 	}
 
-	int GarbageCollector::moveObjects(CollectorGeneration& generation, ForwardingTable& forwardingAddress) {
-		int numDeallocatedObjects = 0;
-		generation.heap().visitObjects([&](ObjectRef objRef) {
-			if (objRef.isMarked()) {
-				objRef.unmark();
-				objRef.increaseSurvivalCount();
-				auto dest = forwardingAddress[objRef.fullPtr()];
-				std::memmove(dest, objRef.fullPtr(), objRef.fullSize());
-			} else {
-				numDeallocatedObjects++;
+	void GarbageCollector::updateStackReferences(const StackReferences& stackReferences, const ForwardingTable& forwardingTable) {
+		for (auto referencePtr : stackReferences) {
+			updateReference(forwardingTable, (PtrValue*)referencePtr);
+		}
+	}
 
-				if (mVMState.config.enableDebug && mVMState.config.printDeallocation) {
-					std::cout << "Deleted object: ";
-					printObject(objRef);
+	int GarbageCollector::moveObjects(CollectorGeneration& generation, const ForwardingTable& forwardingTable) {
+		auto numRegions = mCompactionRegions.size();
+		std::unique_ptr<std::atomic<bool>[]> moved(new std::atomic<bool>[numRegions]);
+		for (std::size_t i = 0; i < numRegions; i++) {
+			moved[i] = false;
+		}
+
+		std::atomic<std::size_t> nextRegion(0);
+		bool printDeallocation = mVMState.config.enableDebug && mVMState.config.printDeallocation;
+
+		auto moveRegions = [&](int workerNumber) {
+			std::size_t regionIndex;
+			while ((regionIndex = nextRegion++) < numRegions) {
+				auto& region = mCompactionRegions[regionIndex];
+
+				//The objects are moved towards the start of the heap, into the earlier regions. The objects there must have been
+				//moved first. As the regions are taken in order, the earlier regions are already being moved by other workers.
+				for (std::size_t previous = 0; previous < regionIndex; previous++) {
+					if (mCompactionRegions[previous].end > region.destination) {
+						while (!moved[previous].load(std::memory_order_acquire)) {
+							std::this_thread::yield();
+						}
+					}
 				}
+
+				generation.heap().visitObjects(region.start, region.end, [&](ObjectRef objRef) {
+					if (objRef.isMarked()) {
+						objRef.unmark();
+						objRef.increaseSurvivalCount();
+						auto dest = forwardingTable.get(objRef.fullPtr());
+						std::memmove(dest, objRef.fullPtr(), objRef.fullSize());
+					} else {
+						region.numDeallocatedObjects++;
+
+						if (printDeallocation) {
+							std::cout << "Deleted object: ";
+							printObject(objRef);
+						}
+					}
+				});
+
+				moved[regionIndex].store(true, std::memory_order_release);
 			}
-		});
+		};
+
+		//The deleted objects are printed in order
+		if (printDeallocation) {
+			moveRegions(0);
+		} else {
+			mWorkers.run(moveRegions);
+		}
+
+		int numDeallocatedObjects = 0;
+		for (auto& region : mCompactionRegions) {
+			numDeallocatedObjects += region.numDeallocatedObjects;
+		}
 
 		return numDeallocatedObjects;
 	}
 
-	void GarbageCollector::promoteObjects(CollectorGeneration& generation, PromotedObjects& promotedObjects, ForwardingTable& forwardingAddress) {
+	void GarbageCollector::promoteObjects(PromotedObjects& promotedObjects, ForwardingTable& forwardingTable) {
 		for (auto& oldObjPtr : promotedObjects) {
 			ObjectRef objRef(oldObjPtr + stackjit::OBJECT_HEADER_SIZE);
 
-			auto newObjPtr = generation.allocate(objRef.fullSize());
+			auto newObjPtr = allocateInOldGeneration(objRef.fullSize());
 			std::memmove(newObjPtr, objRef.fullPtr(), objRef.fullSize());
-			forwardingAddress.insert({ oldObjPtr, newObjPtr });
+			mPromotedBytes += objRef.fullSize();
+			forwardingTable.set(oldObjPtr, newObjPtr);
 
 			ObjectRef newObjRef(newObjPtr + stackjit::OBJECT_HEADER_SIZE);
 			newObjRef.resetSurvivalCount();
@@ -357,54 +909,611 @@ namespace stackjit {
 		}
 	}
 
-	void GarbageCollector::compactObjects(CollectorGeneration& generation, CollectorGeneration* nextGeneration, const GCRuntimeInformation& runtimeInformation) {
-		ForwardingTable forwardingAddress;
+	void GarbageCollector::compactObjects(CollectorGeneration& generation, CollectorGeneration* nextGeneration, const StackReferences& stackReferences) {
+		auto& forwardingTable = generation.forwardingTable();
+		forwardingTable.setNextHeap(&nextGeneration->heap());
 		PromotedObjects promotedObjects;
 
 		//Compute the new locations of the objects
-		auto free = computeNewLocations(generation, forwardingAddress, promotedObjects);
+		auto free = computeNewLocations(generation, promotedObjects);
+		auto promotedStart = nextGeneration->heap().nextAllocation();
 
 		//Promote objects to the next generation
 		if (!promotedObjects.empty()) {
-			promoteObjects(*nextGeneration, promotedObjects, forwardingAddress);
+			promoteObjects(promotedObjects, forwardingTable);
 		}
 
 		//Update the references
-		updateStackReferences(runtimeInformation, forwardingAddress);
-		updateHeapReferences(generation, forwardingAddress);
+		updateStackReferences(stackReferences, forwardingTable);
+		updateRegionReferences(generation, forwardingTable);
 
-		if (!promotedObjects.empty()) {
-			updateHeapReferences(*nextGeneration, forwardingAddress);
+		if (isYoung(generation)) {
+			updateOldGenerationReferences(forwardingTable, promotedStart, promotedObjects);
+		} else {
+			//The young objects can refer to the moved objects
+			updateHeapReferences(mYoungGeneration, forwardingTable, false);
+
+			if (!promotedObjects.empty()) {
+				updateHeapReferences(*nextGeneration, forwardingTable);
+			}
 		}
 
 		//Move the objects
-		int numDeallocatedObjects = moveObjects(generation, forwardingAddress);
+		int numDeallocatedObjects = moveObjects(generation, forwardingTable);
 		generation.heap().setNextAllocation(free);
 
+		if (isOld(generation)) {
+			rebuildOldGenerationCards();
+			numDeallocatedObjects += sweepLargeObjects();
+		}
+
 		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
 			std::cout << "Deallocated: " << numDeallocatedObjects << " objects." << std::endl;
 			std::cout << "GC time: " << Helpers::getDuration(mGCStart) << " ms." << std::endl;
 		}
 	}
 
-	bool GarbageCollector::beginGC(int generationNumber, bool forceGC) {
-		if (getGeneration(generationNumber).needsToCollect() || forceGC) {
-			if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
-				mGCStart = std::chrono::high_resolution_clock::now();
+	void GarbageCollector::copyReference(PtrValue* referencePtr) {
+		if (*referencePtr == 0) {
+			return;
+		}
+
+		//Only the objects in the from-space are copied
+		auto objPtr = (BytePtr)*referencePtr - stackjit::OBJECT_HEADER_SIZE;
+		if (!mYoungGeneration.heap().inside(objPtr)) {
+			return;
+		}
+
+		if (objPtr[sizeof(PtrValue)] != FORWARDED_OBJECT) {
+			ObjectRef objRef(objPtr + stackjit::OBJECT_HEADER_SIZE);
+			bool promote = mYoungGeneration.needsToPromote(objRef.survivalCount());
+
+			BytePtr newObjPtr;
+			if (promote) {
+				newObjPtr = allocateInOldGeneration(objRef.fullSize());
+			} else {
+				newObjPtr = mYoungToSpace.allocate(objRef.fullSize());
+			}
+
+			std::memcpy(newObjPtr, objPtr, objRef.fullSize());
+			ObjectRef newObjRef(newObjPtr + stackjit::OBJECT_HEADER_SIZE);
+
+			if (promote) {
+				newObjRef.resetSurvivalCount();
+				mPromotedObjects.push_back(newObjPtr);
+				mPromotedBytes += objRef.fullSize();
+
+				if (mVMState.config.enableDebug && mVMState.config.printGCPromotion) {
+					std::cout
+						<< "Promoted object " << ptrToString(objRef.dataPtr()) << " (" << objRef.type()->name() << ")"
+						<< " to an older generation, new address: "
+						<< ptrToString(newObjRef.dataPtr())
+						<< std::endl;
+				}
+			} else {
+				newObjRef.increaseSurvivalCount();
+			}
+
+			//Leave the new location in the old copy
+			*(BytePtr*)objPtr = newObjPtr;
+			objPtr[sizeof(PtrValue)] = FORWARDED_OBJECT;
+		}
+
+		*referencePtr = (PtrValue)(*(BytePtr*)objPtr + stackjit::OBJECT_HEADER_SIZE);
+	}
+
+	int GarbageCollector::copyYoungObjects(const StackReferences& stackReferences) {
+		auto& fromSpace = mYoungGeneration.heap();
+		auto promotedStart = mOldGeneration.heap().nextAllocation();
+		mPromotedObjects.clear();
+
+		auto copy = [this](PtrValue* referencePtr) {
+			copyReference(referencePtr);
+		};
+
+		//The promoted objects are old objects that can refer to young objects
+		auto copyAndMarkCard = [this](PtrValue* referencePtr) {
+			copyReference(referencePtr);
+			markCardIfYoung(referencePtr, mYoungToSpace);
+			rememberReference(referencePtr);
+		};
+
+		//Copy the roots. The dirty cards are marked again if they still refer to young objects.
+		for (auto referencePtr : stackReferences) {
+			copyReference((PtrValue*)referencePtr);
+		}
+
+		findDirtyCards();
+		for (auto cardNumber : mDirtyCards) {
+			mOldGeneration.cardTable()[cardNumber] = 0;
+		}
+
+		visitDirtyCardReferences(promotedStart, copyAndMarkCard);
+
+		//The objects before the scan pointers have had their references copied. The promoted objects are scanned in the
+		//order they were promoted, as they are not adjacent when the old generation is divided into regions.
+		auto scan = mYoungToSpace.start();
+		std::size_t promotedScan = 0;
+
+		while (scan < mYoungToSpace.nextAllocation() || promotedScan < mPromotedObjects.size()) {
+			while (scan < mYoungToSpace.nextAllocation()) {
+				ObjectRef objRef(scan + stackjit::OBJECT_HEADER_SIZE);
+				visitReferenceSlots(objRef, scan, scan + objRef.fullSize(), copy);
+				scan += objRef.fullSize();
+			}
+
+			while (promotedScan < mPromotedObjects.size()) {
+				auto promotedPtr = mPromotedObjects[promotedScan];
+				ObjectRef objRef(promotedPtr + stackjit::OBJECT_HEADER_SIZE);
+				visitReferenceSlots(objRef, promotedPtr, promotedPtr + objRef.fullSize(), copyAndMarkCard);
+				promotedScan++;
+			}
+		}
+
+		//The objects that were not copied are dead. Finding them requires walking the from-space, which is only done if printed.
+		int numDeallocatedObjects = 0;
+		if (mVMState.config.enableDebug && (mVMState.config.printDeallocation || mVMState.config.printGCStats)) {
+			auto current = fromSpace.start();
+			while (current < fromSpace.nextAllocation()) {
+				if (current[sizeof(PtrValue)] == FORWARDED_OBJECT) {
+					current += ObjectRef(*(BytePtr*)current + stackjit::OBJECT_HEADER_SIZE).fullSize();
+				} else {
+					ObjectRef objRef(current + stackjit::OBJECT_HEADER_SIZE);
+					numDeallocatedObjects++;
+
+					if (mVMState.config.printDeallocation) {
+						std::cout << "Deleted object: ";
+						printObject(objRef);
+					}
+
+					current += objRef.fullSize();
+				}
+			}
+		}
+
+		//The from-space becomes the to-space of the next collection. Only the allocated part needs to be zeroed.
+		fromSpace.setNextAllocation(fromSpace.start());
+		fromSpace.swap(mYoungToSpace);
+		return numDeallocatedObjects;
+	}
+
+	void GarbageCollector::rememberReference(PtrValue* referencePtr) {
+		auto regions = mOldGeneration.regions();
+		if (regions == nullptr || *referencePtr == 0) {
+			return;
+		}
+
+		auto objPtr = (BytePtr)*referencePtr - stackjit::OBJECT_HEADER_SIZE;
+		if (mOldGeneration.heap().inside(objPtr)) {
+			auto& region = regions->regionOf(objPtr);
+			if (&region != &regions->regionOf((BytePtr)referencePtr)) {
+				region.rememberedCards.insert(mOldGeneration.getCardNumber((BytePtr)referencePtr));
+			}
+		}
+	}
+
+	int GarbageCollector::sweepRegions() {
+		auto& regions = *mOldGeneration.regions();
+		int numDeallocatedObjects = 0;
+
+		for (auto& region : regions.regions()) {
+			region.liveBytes = 0;
+		}
+
+		mOldGeneration.heap().visitObjects([&](ObjectRef objRef) {
+			if (objRef.isMarked()) {
+				objRef.unmark();
+				regions.addLiveBytes(objRef.fullPtr(), objRef.fullSize());
+			} else {
+				numDeallocatedObjects++;
+
+				if (mVMState.config.enableDebug && mVMState.config.printDeallocation) {
+					std::cout << "Deleted object: ";
+					printObject(objRef);
+				}
+
+				deleteObject(objRef);
+			}
+		});
+
+		for (auto& region : regions.regions()) {
+			if (!region.isFree && region.liveBytes == 0) {
+				mOldGeneration.freeRegion(region);
+			}
+		}
+
+		return numDeallocatedObjects;
+	}
+
+	std::vector<HeapRegion*> GarbageCollector::selectCollectionSet() {
+		auto& regions = *mOldGeneration.regions();
+		auto regionSize = regions.regionSize();
+
+		//The region that is allocated in is not evacuated, as the evacuated objects are allocated in it first
+		std::vector<HeapRegion*> candidates;
+		for (auto& region : regions.regions()) {
+			if (!region.isFree
+				&& !region.isHumongous
+				&& &region != regions.allocationRegion()
+				&& region.liveBytes * 100 <= regionSize * MAX_EVACUATED_LIVE_PERCENT) {
+				candidates.push_back(&region);
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const HeapRegion* x, const HeapRegion* y) {
+			return x->liveBytes < y->liveBytes;
+		});
+
+		//The cost of a region is the copying of its alive objects and the scanning of its remembered set
+		std::vector<HeapRegion*> collectionSet;
+		auto freeBytes = regions.numFreeRegions() * regionSize;
+		if (regions.allocationRegion() != nullptr) {
+			freeBytes += (std::size_t)(regions.allocationRegion()->end - regions.allocationRegion()->top);
+		}
+
+		std::size_t evacuatedBytes = 0;
+		double estimatedTime = 0.0;
+
+		for (auto region : candidates) {
+			auto regionTime = (double)(region->liveBytes + region->rememberedCards.size() * mOldGeneration.cardSize()) / mEvacuationRate;
+			if (!collectionSet.empty() && estimatedTime + regionTime > mVMState.config.gcPauseTarget) {
+				break;
+			}
+
+			if (evacuatedBytes + region->liveBytes > freeBytes) {
+				break;
+			}
+
+			collectionSet.push_back(region);
+			evacuatedBytes += region->liveBytes;
+			estimatedTime += regionTime;
+		}
+
+		return collectionSet;
+	}
+
+	void GarbageCollector::evacuateRegions(const std::vector<HeapRegion*>& collectionSet, const StackReferences& stackReferences) {
+		auto& regions = *mOldGeneration.regions();
+		auto& heap = mOldGeneration.heap();
+		auto& forwardingTable = mOldGeneration.forwardingTable();
+		forwardingTable.setNextHeap(&heap);
+		auto evacuationStart = std::chrono::high_resolution_clock::now();
+
+		for (auto region : collectionSet) {
+			region->inCollectionSet = true;
+		}
+
+		//Copy the objects. An object that doesn't fit is left where it is, which keeps its region from being freed.
+		std::vector<BytePtr> evacuatedObjects;
+		std::size_t evacuatedBytes = 0;
+
+		for (auto region : collectionSet) {
+			heap.visitObjects(region->start, region->top, [&](ObjectRef objRef) {
+				auto newObjPtr = mOldGeneration.tryAllocate(objRef.fullSize());
+				if (newObjPtr != nullptr) {
+					std::memcpy(newObjPtr, objRef.fullPtr(), objRef.fullSize());
+					evacuatedBytes += objRef.fullSize();
+				} else {
+					newObjPtr = objRef.fullPtr();
+					region->evacuationFailed = true;
+				}
+
+				forwardingTable.set(objRef.fullPtr(), newObjPtr);
+				evacuatedObjects.push_back(newObjPtr);
+			});
+		}
+
+		//The new locations are only valid for the objects in the collection set, as the table is not cleared
+		auto forward = [&](PtrValue* referencePtr) {
+			if (*referencePtr != 0) {
+				auto objPtr = (BytePtr)*referencePtr - stackjit::OBJECT_HEADER_SIZE;
+				if (heap.inside(objPtr) && regions.regionOf(objPtr).inCollectionSet) {
+					*referencePtr = (PtrValue)(forwardingTable.get(objPtr) + stackjit::OBJECT_HEADER_SIZE);
+				}
 			}
+		};
 
+		auto forwardAndRemember = [&](PtrValue* referencePtr) {
+			forward(referencePtr);
+			rememberReference(referencePtr);
+		};
+
+		for (auto referencePtr : stackReferences) {
+			forward((PtrValue*)referencePtr);
+		}
+
+		mYoungGeneration.heap().visitObjects([&](ObjectRef objRef) {
+			visitReferenceSlots(objRef, objRef.fullPtr(), objRef.fullPtr() + objRef.fullSize(), forward);
+		});
+
+		//Only the cards in the remembered sets can refer to the objects from other regions. A card can be in multiple sets,
+		//but the references are only changed once, as the new locations are outside the collection set.
+		for (auto region : collectionSet) {
+			for (auto cardNumber : region->rememberedCards) {
+				auto cardStart = mOldGeneration.getCardStart(cardNumber);
+				auto& cardRegion = regions.regionOf(cardStart);
+				if (cardRegion.isFree || cardRegion.inCollectionSet) {
+					continue;
+				}
+
+				mOldGeneration.visitObjectsInCard(cardNumber, [&](ObjectRef objRef) {
+					visitReferenceSlots(objRef, cardStart, cardStart + mOldGeneration.cardSize(), forwardAndRemember);
+				});
+			}
+		}
+
+		//The evacuated objects refer to other objects from their new regions
+		for (auto objPtr : evacuatedObjects) {
+			ObjectRef objRef(objPtr + stackjit::OBJECT_HEADER_SIZE);
+			visitReferenceSlots(objRef, objPtr, objPtr + objRef.fullSize(), [&](PtrValue* referencePtr) {
+				forwardAndRemember(referencePtr);
+				markCardIfYoung(referencePtr, mYoungGeneration.heap());
+			});
+		}
+
+		//Free the regions. In a region where the evacuation failed, the objects that were copied are deleted.
+		for (auto region : collectionSet) {
+			if (!region->evacuationFailed) {
+				mOldGeneration.freeRegion(*region);
+			} else {
+				heap.visitObjects(region->start, region->top, [&](ObjectRef objRef) {
+					if (forwardingTable.get(objRef.fullPtr()) != objRef.fullPtr()) {
+						deleteObject(objRef);
+					}
+				});
+
+				region->inCollectionSet = false;
+				region->evacuationFailed = false;
+			}
+		}
+
+		//The estimated rate is a running average, as the time includes the updating of the references
+		auto evacuationTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - evacuationStart).count();
+		if (evacuatedBytes > 0 && evacuationTime > 0.0) {
+			mEvacuationRate = (mEvacuationRate + (double)evacuatedBytes / evacuationTime) / 2.0;
+		}
+
+		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+			std::cout << "Evacuated: " << collectionSet.size() << " regions (" << evacuatedBytes << " bytes)." << std::endl;
+		}
+	}
+
+	void GarbageCollector::collectRegions(const StackReferences& stackReferences) {
+		//The references written since the last collection are added to the remembered sets. The cards stay dirty,
+		//as they are needed by the next collection of the young generation.
+		findDirtyCards();
+		visitDirtyCardReferences(mOldGeneration.heap().nextAllocation(), [this](PtrValue* referencePtr) {
+			rememberReference(referencePtr);
+		});
+
+		markAllObjects(mOldGeneration, stackReferences);
+		int numDeallocatedObjects = sweepRegions() + sweepLargeObjects();
+		evacuateRegions(selectCollectionSet(), stackReferences);
+
+		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+			std::cout << "Deallocated: " << numDeallocatedObjects << " objects." << std::endl;
+			std::cout << "GC time: " << Helpers::getDuration(mGCStart) << " ms." << std::endl;
+		}
+	}
+
+	void GarbageCollector::startConcurrentMarking(const StackReferences& stackReferences) {
+		findRoots(mOldGeneration, stackReferences);
+		mConcurrentMarker->start(mRoots);
+
+		if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+			std::cout << "Started concurrent marking." << std::endl;
+			std::cout << "GC time: " << Helpers::getDuration(mGCStart) << " ms." << std::endl;
+		}
+	}
+
+	void GarbageCollector::finishConcurrentMarking(const StackReferences& stackReferences) {
+		//Mark the references that have been logged since the marker thread ran out of objects
+		if (mConcurrentMarker->finish()) {
+			//The objects allocated while marking are alive
+			auto& heap = mOldGeneration.heap();
+			heap.visitObjects(mConcurrentMarker->snapshotEnd(), heap.nextAllocation(), [](ObjectRef objRef) {
+				objRef.mark();
+			});
+
+			for (auto objPtr : mAllocatedWhileMarking) {
+				ObjectRef(objPtr + stackjit::OBJECT_HEADER_SIZE).mark();
+			}
+		} else {
+			//The log was full, which means that references might have been lost. Mark again without the program running.
+			auto unmark = [](ObjectRef objRef) {
+				objRef.unmark();
+			};
+
+			mOldGeneration.heap().visitObjects(unmark);
+			mLargeObjects.visitObjects(unmark);
+
+			markAllObjects(mOldGeneration, stackReferences);
+		}
+
+		mAllocatedWhileMarking.clear();
+
+		if (mOldGeneration.freeLists() != nullptr) {
+			sweepOldGeneration(stackReferences);
+		} else {
+			compactObjects(mOldGeneration, &mOldGeneration, stackReferences);
+		}
+	}
+
+	bool GarbageCollector::collectsByBytes() const {
+		return mVMState.config.allocationsBeforeGC < 0;
+	}
+
+	bool GarbageCollector::needsToCollect(const CollectorGeneration& generation) const {
+		if (generation.needsToCollect()) {
+			return true;
+		}
+
+		if (isOld(generation) && collectsByBytes()) {
+			return generation.usedBytes() * 100 >= generation.heap().size() * OLD_OCCUPANCY_PERCENT
+				   || needsToCollectLargeObjects();
+		}
+
+		return false;
+	}
+
+	bool GarbageCollector::isLargeObjectSpaceFull() const {
+		auto allocated = mLargeObjects.allocatedSinceSweep();
+		return allocated > 0 && availableHeapSize() < allocated;
+	}
+
+	bool GarbageCollector::needsToCollectLargeObjects() const {
+		auto allocated = mLargeObjects.allocatedSinceSweep();
+		auto survived = mLargeObjects.size() - allocated;
+		return (allocated > 0 && allocated >= std::max(survived, mOldGeneration.heap().size())) || isLargeObjectSpaceFull();
+	}
+
+	std::size_t GarbageCollector::largeObjectAllocationSize(const StackFrame& stackFrame) const {
+		auto& instruction = stackFrame.function()->instructions()[stackFrame.instructionIndex()];
+		if (instruction.opCode() != OpCodes::NEW_ARRAY) {
+			return 0;
+		}
+
+		//The length is the top operand, which has been stored in the frame for the GC call
+		auto length = (int)stackFrame.getStackOperand(stackFrame.operandStackSize() - 1).value();
+		if (length < 0) {
+			return 0;
+		}
+
+		auto elementType = mVMState.typeProvider().getType(instruction.stringValue);
+		auto arrayType = mVMState.typeProvider().getType(TypeSystem::arrayTypeName(elementType));
+		auto size = stackjit::OBJECT_HEADER_SIZE + stackjit::ARRAY_LENGTH_SIZE + length * TypeSystem::sizeOfType(elementType);
+		return isLargeObject(arrayType, size) ? size : 0;
+	}
+
+	void GarbageCollector::setYoungAllocationLimit() {
+		auto& heap = mYoungGeneration.heap();
+
+		if (collectsByBytes()) {
+			auto maxAllocation = (std::size_t)(heap.end() - heap.nextAllocation());
+			mYoungGeneration.setAllocationLimit(heap.nextAllocation() + std::min(mSizePolicy.youngSize(), maxAllocation));
+		} else {
+			mYoungGeneration.setAllocationLimit(heap.end());
+		}
+	}
+
+	void GarbageCollector::expandOldGeneration() {
+		//The old generation grows when it is still mostly used after a collection, instead of being collected again soon
+		auto& heap = mOldGeneration.heap();
+		auto usedBytes = mOldGeneration.usedBytes();
+		if (usedBytes * 100 >= heap.size() * OLD_OCCUPANCY_PERCENT) {
+			growOldGeneration(usedBytes * 100 / EXPANDED_OCCUPANCY_PERCENT - heap.size());
+		}
+	}
+
+	bool GarbageCollector::beginGC(int generationNumber, bool forceGC) {
+		if (needsToCollect(getGeneration(generationNumber)) || forceGC) {
+			mGCStart = std::chrono::high_resolution_clock::now();
 			return true;
 		} else {
 			return false;
 		}
 	}
 
+	void GarbageCollector::collectGeneration(CollectorGeneration& generation, const StackReferences& stackReferences, bool finishMarking) {
+		auto youngUsedBytes = mYoungGeneration.usedBytes();
+		mPromotedBytes = 0;
+
+		if (mOldGeneration.regions() != nullptr) {
+			mOldGeneration.regions()->recordTops();
+		}
+
+		if (isOld(generation) && mConcurrentMarker != nullptr) {
+			if (finishMarking) {
+				finishConcurrentMarking(stackReferences);
+				generation.collected();
+
+				if (collectsByBytes()) {
+					expandOldGeneration();
+				}
+			} else {
+				startConcurrentMarking(stackReferences);
+			}
+		} else {
+			//The marker thread can't run while the heaps are changed
+			if (mConcurrentMarker != nullptr) {
+				mConcurrentMarker->pause();
+			}
+
+			if (isYoung(generation) && mVMState.config.copyingYoungCollector) {
+				//Copy the alive objects
+				int numDeallocatedObjects = copyYoungObjects(stackReferences);
+
+				if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+					std::cout << "Deallocated: " << numDeallocatedObjects << " objects." << std::endl;
+					std::cout << "GC time: " << Helpers::getDuration(mGCStart) << " ms." << std::endl;
+				}
+			} else if (isOld(generation) && mOldGeneration.regions() != nullptr) {
+				//Evacuate the regions with the most garbage
+				collectRegions(stackReferences);
+			} else if (isOld(generation) && mOldGeneration.freeLists() != nullptr) {
+				//Mark all objects, and sweep them in place
+				markAllObjects(generation, stackReferences);
+				sweepOldGeneration(stackReferences);
+			} else {
+				//Mark all objects
+				markAllObjects(generation, stackReferences);
+
+				//Compact objects
+				compactObjects(generation, &mOldGeneration, stackReferences);
+			}
+
+			generation.collected();
+			bool oldCollected = isOld(generation);
+
+			//A finished concurrent marking is completed at the first collection after it
+			if (mConcurrentMarker != nullptr) {
+				mConcurrentMarker->resume();
+
+				if (mConcurrentMarker->isDone()) {
+					finishConcurrentMarking(stackReferences);
+					mOldGeneration.collected();
+					oldCollected = true;
+				}
+			}
+
+			if (oldCollected && collectsByBytes()) {
+				expandOldGeneration();
+			}
+		}
+
+		if (isYoung(generation)) {
+			if (collectsByBytes() && mVMState.config.adaptiveGC) {
+				auto pauseTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - mGCStart).count();
+				auto survivedBytes = mYoungGeneration.usedBytes();
+				mSizePolicy.youngCollected(youngUsedBytes - mYoungSurvivedBytes, survivedBytes, mPromotedBytes, pauseTime);
+				mYoungGeneration.setSurvivedCollectionsBeforePromote(mSizePolicy.promotionAge());
+				mYoungSurvivedBytes = survivedBytes;
+
+				if (mVMState.config.enableDebug && mVMState.config.printGCStats) {
+					std::cout
+						<< "Young generation size: " << mSizePolicy.youngSize() << " bytes, "
+						<< "promotion age: " << mSizePolicy.promotionAge() << "."
+						<< std::endl;
+				}
+			}
+
+			setYoungAllocationLimit();
+		}
+	}
+
 	void GarbageCollector::collect(const GCRuntimeInformation& runtimeInformation, int generationNumber, bool forceGC) {
 		auto func = runtimeInformation.stackFrame.function();
 		auto instIndex = runtimeInformation.stackFrame.instructionIndex();
 		auto& generation = getGeneration(generationNumber);
 
-		if (beginGC(generationNumber, forceGC)) {
+		//A started concurrent marking is finished by the next collection of the old generation, even if it is not due
+		bool finishMarking = isOld(generation) && mConcurrentMarker != nullptr && mConcurrentMarker->isMarking();
+
+		//A large object that doesn't fit in the heap is allocated after a full collection, before running out of memory
+		auto largeObjectSize = isYoung(generation) ? largeObjectAllocationSize(runtimeInformation.stackFrame) : 0;
+		bool fullCollection = largeObjectSize > 0 && LargeObjectSpace::chunkSize(largeObjectSize) > availableHeapSize();
+
+		if (beginGC(generationNumber, forceGC || finishMarking || fullCollection)) {
 			std::size_t startStrLength = 0;
 
 			if (mVMState.config.enableDebug && mVMState.config.printGCPeriod) {
@@ -425,16 +1534,28 @@ namespace stackjit {
 				std::cout << std::endl;
 			}
 
-			//Mark all objects
-			markAllObjects(generation, runtimeInformation.stackFrame);
-
-	//		//Sweep objects
-	//		sweepObjects();
-	//		mNumAllocated = 0;
+			StackReferences stackReferences;
+			findStackReferences(runtimeInformation.stackFrame, stackReferences);
+			collectGeneration(generation, stackReferences, finishMarking);
+
+			//When collecting by bytes, the old generation is collected when most of it is used after a young collection.
+			//When counting allocations, it is only collected after a young collection when the large objects have grown.
+			//A concurrent marking in progress is left to finish, unless the large objects are running out of memory.
+			//Their memory is only freed when the marking is finished.
+			bool collectOld = collectsByBytes() ? needsToCollect(mOldGeneration) : needsToCollectLargeObjects();
+			if (isYoung(generation) && (collectOld || fullCollection)) {
+				bool marking = mConcurrentMarker != nullptr && mConcurrentMarker->isMarking();
+
+				//A full collection can't wait for the marker, which is started and finished at once
+				if (fullCollection && mConcurrentMarker != nullptr && !marking) {
+					collectGeneration(mOldGeneration, stackReferences, false);
+					marking = true;
+				}
 
-			//Compact objects
-			compactObjects(generation, &mOldGeneration, runtimeInformation);
-			generation.collected();
+				if (!marking || fullCollection || isLargeObjectSpaceFull()) {
+					collectGeneration(mOldGeneration, stackReferences, marking);
+				}
+			}
 
 			if (mVMState.config.enableDebug && mVMState.config.printGCPeriod) {
 				printTimes('-', (int)startStrLength / 2 - 3);
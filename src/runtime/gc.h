@@ -3,8 +3,15 @@
 #include "../stackjit.h"
 #include "stackframe.h"
 #include "gcgeneration.h"
+#include "gcworkers.h"
+#include "heapmemory.h"
+#include "largeobjectspace.h"
+#include "sizepolicy.h"
+#include "markstack.h"
+#include "concurrentmarker.h"
 #include <unordered_map>
 #include <vector>
+#include <memory>
 #include <chrono>
 
 namespace stackjit {
@@ -25,8 +32,62 @@ namespace stackjit {
 	private:
 		VMState& mVMState;
 
+		//The maximum size of the old generation
+		const std::size_t mMaxOldGenerationSize;
+
+		//The memory for the heaps. The old generation is followed by the young, which lets the card table of the old
+		//generation cover both heaps. The memory up to the maximum size of the old generation is reserved for it to grow into.
+		HeapMemory mHeapMemory;
+
 		CollectorGeneration mYoungGeneration;
 		CollectorGeneration mOldGeneration;
+
+		//The arrays without references that are larger than the large object size. They are collected with the old generation.
+		LargeObjectSpace mLargeObjects;
+
+		//The heap that the copying collector copies the alive young objects to. It is swapped with the heap of the
+		//young generation after each collection. Empty if the young generation is compacted instead.
+		ManagedHeap mYoungToSpace;
+
+		//The workers that mark and compact in parallel
+		GCWorkerPool mWorkers;
+		MarkStacks mMarkStacks;
+		std::vector<RawObjectRef> mRoots;
+
+		//A part of the heap that is compacted by one worker. Regions start at objects, and are taken in address order.
+		struct CompactionRegion {
+			BytePtr start;
+			BytePtr end;
+
+			//The new location of the first object in the region that is not promoted
+			BytePtr destination;
+			int numDeallocatedObjects;
+		};
+
+		std::vector<CompactionRegion> mCompactionRegions;
+
+		//The objects promoted by the copying collector, in the order they were promoted. They are scanned like the to-space.
+		std::vector<BytePtr> mPromotedObjects;
+
+		//The estimated number of bytes that can be evacuated per millisecond, when the old generation is divided into regions
+		double mEvacuationRate;
+
+		//Adapts the size of the young generation and the promotion age, when collecting by bytes
+		AdaptiveSizePolicy mSizePolicy;
+
+		//The number of bytes used by the young generation after its last collection
+		std::size_t mYoungSurvivedBytes = 0;
+
+		//The number of bytes promoted by the current collection
+		std::size_t mPromotedBytes = 0;
+
+		//Marks the old generation while the program runs. Null if the old generation is marked when collected.
+		std::unique_ptr<ConcurrentMarker> mConcurrentMarker;
+
+		//The objects allocated in the free blocks of the old generation while marking concurrently
+		std::vector<BytePtr> mAllocatedWhileMarking;
+
+		std::vector<std::size_t> mDirtyCards;
 		std::chrono::time_point<std::chrono::high_resolution_clock> mGCStart;
 
 		//Indicates if the given generation is the young
@@ -38,50 +99,177 @@ namespace stackjit {
 		//Prints the given object
 		void printObject(ObjectRef objRef);
 
-		//Allocate an object of given type and size in the given heap
+		//Allocate an object of given type and size in the given heap. If the heap is full, the object is allocated in the old generation.
+		//Large objects are allocated in the large object space.
 		RawObjectRef allocateObject(CollectorGeneration& generation, const Type* type, std::size_t size);
 
+		//Indicates if an object of the given type and size (including the header) is allocated in the large object space
+		bool isLargeObject(const Type* type, std::size_t size) const;
+
+		//Indicates if the given object is in the large object space. Every object outside the heaps is.
+		bool inLargeObjectSpace(BytePtr objPtr) const;
+
+		//Returns the amount of memory that the old generation and the large objects can grow with, without exceeding the maximum heap size
+		std::size_t availableHeapSize() const;
+
+		//Grows the old generation to make room for a memory block of the given size, without exceeding the maximum heap size.
+		//Returns false if the old generation is at its maximum size.
+		bool growOldGeneration(std::size_t size);
+
+		//Allocates a memory block of the given size in the large object space.
+		//Signals an out of memory error if the block doesn't fit in the maximum heap size.
+		BytePtr allocateLargeObject(std::size_t size);
+
+		//Allocates a memory block of the given size in the old generation, which grows if full.
+		//Signals an out of memory error if the block doesn't fit in the maximum heap size.
+		BytePtr allocateInOldGeneration(std::size_t size);
+
 		//Deletes the given object
 		void deleteObject(ObjectRef objRef);
 
-		//Marks the given object
-		void markObject(CollectorGeneration& generation, ObjectRef objRef);
+		//Pushes the given object to the mark stack of the given worker, unless null or outside the collected generation.
+		//When the old generation is collected, the large objects are marked instead, as they have no references to trace.
+		void pushMarkStack(CollectorGeneration& generation, int workerNumber, RawObjectRef objPtr);
+
+		//Marks the objects reachable from the mark stack of the given worker, stealing from the other workers when out of objects
+		void markObjects(CollectorGeneration& generation, int workerNumber);
+
+		//The locations of the references in the stack frames
+		using StackReferences = std::vector<RegisterValue*>;
+
+		//Finds the references in all stack frames, starting at the given frame. The stack is only walked once per
+		//collection, as the locations are used both for marking and for updating the references.
+		void findStackReferences(const StackFrame& stackFrame, StackReferences& stackReferences);
+
+		//Finds the dirty cards of the old generation
+		void findDirtyCards();
+
+		//Visits the reference slots in the dirty cards of the old generation that are before the given address
+		void visitDirtyCardReferences(BytePtr end, std::function<void (PtrValue*)> fn);
 
-		//Marks the value of the given type
-		void markValue(CollectorGeneration& generation, RegisterValue value, const Type* type);
+		//Marks the card of the given reference slot in the old generation if it refers to an object in the given young heap
+		void markCardIfYoung(PtrValue* referencePtr, const ManagedHeap& youngHeap);
 
-		//Marks the objects in all stack frames, starting at the given frame
-		void markAllObjects(CollectorGeneration& generation, const StackFrame& stackFrame);
+		//Finds the roots for marking the given generation. For the young generation, these are the references in the stack
+		//frames and the dirty cards. For the old generation, these are the references in the stack frames and the young objects.
+		void findRoots(CollectorGeneration& generation, const StackReferences& stackReferences);
 
-		//Deletes unreachable objects.
-		void sweepObjects(CollectorGeneration& generation);
+		//Marks the objects referenced by the roots
+		void markAllObjects(CollectorGeneration& generation, const StackReferences& stackReferences);
+
+		//Deletes the unreachable objects, and unmarks the rest. The memory between the alive objects is added to the free lists
+		//of the generation, and the free memory at the end is allocated from the end again. Returns the number of deleted objects.
+		int sweepObjects(CollectorGeneration& generation);
+
+		//Indicates if the old generation is swept, and most of its free memory is in small free blocks
+		bool isOldGenerationFragmented() const;
+
+		//Sweeps the marked old generation without moving the objects. If fragmented, it is compacted instead.
+		void sweepOldGeneration(const StackReferences& stackReferences);
+
+		//Frees the large objects that were not marked by the collection of the old generation. Returns the number of freed objects.
+		int sweepLargeObjects();
 
-		using ForwardingTable = std::unordered_map<BytePtr, BytePtr>;
 		using PromotedObjects = std::vector<BytePtr>;
 
-		//Computes the new locations of the objects
-		BytePtr computeNewLocations(CollectorGeneration& generation, ForwardingTable& forwardingAddress, PromotedObjects& promotedObjects);
+		//Computes the new locations of the objects, and divides the heap into regions for the workers
+		BytePtr computeNewLocations(CollectorGeneration& generation, PromotedObjects& promotedObjects);
 
 		//Updates the given object reference
-		void updateReference(ForwardingTable& forwardingAddress, PtrValue* objRef);
+		void updateReference(const ForwardingTable& forwardingTable, PtrValue* objRef);
+
+		//Updates the references stored in the given object
+		void updateObjectReferences(const ForwardingTable& forwardingTable, ObjectRef objRef);
+
+		//Updates the references stored in the given heap. If onlyMarked is true, only the references in marked objects are updated.
+		void updateHeapReferences(CollectorGeneration& generation, const ForwardingTable& forwardingTable, bool onlyMarked = true);
+
+		//Updates the references stored in the marked objects of the compaction regions, in parallel
+		void updateRegionReferences(CollectorGeneration& generation, const ForwardingTable& forwardingTable);
 
-		//Updates the references stored in the given heap
-		void updateHeapReferences(CollectorGeneration& generation, ForwardingTable& forwardingAddress);
+		//Updates the references in the old generation after a young collection. Only the objects in the dirty cards and
+		//the promoted objects can refer to young objects. The cards are marked again if they still refer to young objects.
+		void updateOldGenerationReferences(const ForwardingTable& forwardingTable, BytePtr promotedStart, const PromotedObjects& promotedObjects);
+
+		//Recomputes the card table of the old generation after the old generation has been compacted
+		void rebuildOldGenerationCards();
 
 		//Updates the references stored in the stack
-		void updateStackReferences(const GCRuntimeInformation& runtimeInformation, ForwardingTable& forwardingAddress);
+		void updateStackReferences(const StackReferences& stackReferences, const ForwardingTable& forwardingTable);
 
-		//Moves the objects
-		int moveObjects(CollectorGeneration& generation, ForwardingTable& forwardingAddress);
+		//Moves the objects of the compaction regions, in parallel. A region is moved when the earlier regions
+		//that its objects are moved into have been moved.
+		int moveObjects(CollectorGeneration& generation, const ForwardingTable& forwardingTable);
 
-		//Promotes the object to the given generation
-		void promoteObjects(CollectorGeneration& generation, PromotedObjects& promotedObjects, ForwardingTable& forwardingAddress);
+		//Promotes the objects to the old generation
+		void promoteObjects(PromotedObjects& promotedObjects, ForwardingTable& forwardingTable);
 
 		//Compacts the objects
-		void compactObjects(CollectorGeneration& generation, CollectorGeneration* nextGeneration, const GCRuntimeInformation& runtimeInformations);
+		void compactObjects(CollectorGeneration& generation, CollectorGeneration* nextGeneration, const StackReferences& stackReferences);
+
+		//Copies the young object referenced by the given slot to the to-space, or promotes it to the old generation.
+		//The slot is updated to the new location.
+		void copyReference(PtrValue* referencePtr);
+
+		//Collects the young generation by copying the alive objects breadth-first (Cheney's algorithm).
+		//Returns the number of deallocated objects if they are printed, else zero.
+		int copyYoungObjects(const StackReferences& stackReferences);
+
+		//Adds the card of the given reference slot in the old generation to the remembered set of the region it refers to,
+		//unless in the same region. Does nothing if the old generation is not divided into regions.
+		void rememberReference(PtrValue* referencePtr);
+
+		//Computes the alive bytes of the regions after the old generation has been marked, and unmarks the objects.
+		//The dead objects are deleted, and the regions without alive objects are freed. Returns the number of deleted objects.
+		int sweepRegions();
+
+		//Selects the regions to evacuate. The regions with the most garbage are selected first, until the estimated
+		//time of the evacuation reaches the pause time target.
+		std::vector<HeapRegion*> selectCollectionSet();
+
+		//Evacuates the alive objects in the given regions to free regions, and frees the given regions. The references to the
+		//moved objects are found in the stack frames, the young objects and the remembered sets of the regions.
+		void evacuateRegions(const std::vector<HeapRegion*>& collectionSet, const StackReferences& stackReferences);
+
+		//Collects the old generation when divided into regions
+		void collectRegions(const StackReferences& stackReferences);
+
+		//Starts marking the old generation concurrently. The roots are found while the program is stopped.
+		void startConcurrentMarking(const StackReferences& stackReferences);
+
+		//Finishes the concurrent marking of the old generation, and compacts it
+		void finishConcurrentMarking(const StackReferences& stackReferences);
+
+		//Indicates if the collections are triggered by the number of allocated bytes, instead of the number of allocations
+		bool collectsByBytes() const;
+
+		//Indicates if less is left of the maximum heap size than has been allocated in the large object space since its last collection
+		bool isLargeObjectSpaceFull() const;
+
+		//Indicates if the large object space needs to be collected, which is the case when it has doubled or grown by the size
+		//of the old generation since its last collection, or when it is full.
+		bool needsToCollectLargeObjects() const;
+
+		//Returns the size (including the header) of the large object that the instruction of the given frame allocates,
+		//or zero if it doesn't allocate a large object
+		std::size_t largeObjectAllocationSize(const StackFrame& stackFrame) const;
+
+		//Indicates if the given generation needs to be collected. When collecting by bytes, the old generation
+		//is collected when most of it is used, or when the large object space has grown enough.
+		bool needsToCollect(const CollectorGeneration& generation) const;
+
+		//Sets the allocation limit of the young generation after a collection. When collecting by bytes, the limit is
+		//the number of bytes given by the size policy after the alive objects.
+		void setYoungAllocationLimit();
+
+		//Grows the old generation if most of it is still used after a collection
+		void expandOldGeneration();
 
 		//Begins the garbage collection. Return true if started.
 		bool beginGC(int generationNumber, bool forceGC);
+
+		//Collects the given generation. The adaptive size policy is updated after a young collection.
+		void collectGeneration(CollectorGeneration& generation, const StackReferences& stackReferences, bool finishMarking);
 	public:
 		//Creates a new GC
 		GarbageCollector(VMState& vmState);
@@ -102,6 +290,9 @@ namespace stackjit {
 		CollectorGeneration& getGeneration(int generationNumber);
 		const CollectorGeneration& getGeneration(int generationNumber) const;
 
+		//Returns the concurrent marker of the old generation, or null if not used
+		ConcurrentMarker* concurrentMarker() const;
+
 		//Allocates a new array of the given type and length.
 		RawArrayRef newArray(const ArrayType* arrayType, int length);
 
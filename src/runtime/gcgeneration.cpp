@@ -1,17 +1,36 @@
 #include "gcgeneration.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace stackjit {
-	CollectorGeneration::CollectorGeneration(std::size_t size,
+	CollectorGeneration::CollectorGeneration(BytePtr data,
+											 std::size_t size,
 											 std::size_t allocatedBeforeCollection,
 											 int survivedCollectionsBeforePromote,
-											 std::size_t cardSize)
-			: mHeap(size),
+											 std::size_t cardSize,
+											 std::size_t coveredAfterHeap)
+			: mHeap(data, size),
+			  mForwardingTable(mHeap),
 			  mAllocatedBeforeCollection(allocatedBeforeCollection),
 			  mSurvivedCollectionsBeforePromote(survivedCollectionsBeforePromote),
 			  mCardSize(cardSize),
 			  mNumCards(mCardSize > 0 ? (size / mCardSize) : 0),
-			  mCardTable(mCardSize > 0 ? (new unsigned char[mNumCards]{ 0 }) : nullptr) {
+			  mNumCoveredCards(mCardSize > 0 ? ((size + coveredAfterHeap) / mCardSize) : 0),
+			  mCardTable(mCardSize > 0 ? (new unsigned char[mNumCoveredCards]{ 0 }) : nullptr),
+			  mCrossingMap(mNumCards, 0) {
+		if (mCardSize > 0) {
+			if ((mCardSize & (mCardSize - 1)) != 0) {
+				throw std::runtime_error("The card size must be a power of two.");
+			}
 
+			if (((std::size_t)data & (mCardSize - 1)) != 0) {
+				throw std::runtime_error("The heap must be aligned to the card size.");
+			}
+
+			while (((std::size_t)1 << mCardShift) < mCardSize) {
+				mCardShift++;
+			}
+		}
 	}
 
 	CollectorGeneration::~CollectorGeneration() {
@@ -26,27 +45,112 @@ namespace stackjit {
 		return mHeap;
 	}
 
+	ForwardingTable& CollectorGeneration::forwardingTable() {
+		return mForwardingTable;
+	}
+
 	std::size_t CollectorGeneration::numCards() const {
 		return mNumCards;
 	}
 
+	std::size_t CollectorGeneration::numCoveredCards() const {
+		return mNumCoveredCards;
+	}
+
 	std::size_t CollectorGeneration::cardSize() const {
 		return mCardSize;
 	}
 
+	std::size_t CollectorGeneration::cardShift() const {
+		return mCardShift;
+	}
+
 	BytePtr CollectorGeneration::cardTable() const {
 		return mCardTable;
 	}
 
+	PtrValue CollectorGeneration::biasedCardTable() const {
+		return (PtrValue)mCardTable - ((PtrValue)mHeap.start() >> mCardShift);
+	}
+
 	std::size_t CollectorGeneration::getCardNumber(BytePtr ptr) const {
 		if (mCardSize == 0) {
 			return 0;
 		}
 
-		return (std::size_t)(ptr - mHeap.start()) / mCardSize;
+		return (std::size_t)(ptr - mHeap.start()) >> mCardShift;
+	}
+
+	BytePtr CollectorGeneration::getCardStart(std::size_t cardNumber) const {
+		return mHeap.start() + cardNumber * mCardSize;
+	}
+
+	void CollectorGeneration::recordInCrossingMap(BytePtr blockPtr, std::size_t size) {
+		//The block covers the first byte of the cards that start inside it
+		auto offset = (std::size_t)(blockPtr - mHeap.start());
+		for (auto cardNumber = (offset + mCardSize - 1) / mCardSize;
+			 cardNumber < mNumCards && cardNumber * mCardSize < offset + size;
+			 cardNumber++) {
+			mCrossingMap[cardNumber] = (std::uint32_t)offset;
+		}
+	}
+
+	void CollectorGeneration::visitObjectsInCard(std::size_t cardNumber, std::function<void (ObjectRef)> fn) const {
+		auto cardEnd = std::min(getCardStart(cardNumber) + mCardSize, mHeap.nextAllocation());
+		auto current = mHeap.start() + mCrossingMap[cardNumber];
+
+		while (current < cardEnd) {
+			if (!ManagedHeap::isDeadObject(current)) {
+				ObjectRef objRef(current + stackjit::OBJECT_HEADER_SIZE);
+				fn(objRef);
+				current += objRef.fullSize();
+			} else {
+				current += ManagedHeap::blockSize(current);
+			}
+		}
+	}
+
+	void CollectorGeneration::rebuildCrossingMap() {
+		if (mCardSize == 0) {
+			return;
+		}
+
+		//The dead objects are included, as they can cover the start of a card
+		auto current = mHeap.start();
+		while (current < mHeap.nextAllocation()) {
+			auto size = ManagedHeap::blockSize(current);
+			recordInCrossingMap(current, size);
+			current += size;
+		}
+	}
+
+	void CollectorGeneration::clearCardTable() {
+		for (std::size_t i = 0; i < mNumCards; i++) {
+			mCardTable[i] = 0;
+		}
+	}
+
+	std::size_t CollectorGeneration::allocatedBeforeCollection() const {
+		return mAllocatedBeforeCollection;
+	}
+
+	std::size_t* CollectorGeneration::numAllocatedPtr() {
+		return &mNumAllocated;
+	}
+
+	BytePtr* CollectorGeneration::allocationLimitPtr() {
+		return &mAllocationLimit;
+	}
+
+	void CollectorGeneration::setAllocationLimit(BytePtr allocationLimit) {
+		mAllocationLimit = allocationLimit;
 	}
 
 	bool CollectorGeneration::needsToCollect() const {
+		if (mAllocationLimit != nullptr && mHeap.nextAllocation() >= mAllocationLimit) {
+			return true;
+		}
+
 		return mNumAllocated >= mAllocatedBeforeCollection;
 	}
 
@@ -58,23 +162,122 @@ namespace stackjit {
 		return survivalCount >= mSurvivedCollectionsBeforePromote;
 	}
 
+	void CollectorGeneration::setSurvivedCollectionsBeforePromote(int survivedCollections) {
+		mSurvivedCollectionsBeforePromote = survivedCollections;
+	}
+
+	std::size_t CollectorGeneration::usedBytes() const {
+		if (mRegions != nullptr) {
+			return mHeap.size() - mRegions->numFreeRegions() * mRegions->regionSize();
+		}
+
+		auto usedBytes = (std::size_t)(mHeap.nextAllocation() - mHeap.start());
+		if (mFreeLists != nullptr) {
+			usedBytes -= mFreeLists->freeBytes();
+		}
+
+		return usedBytes;
+	}
+
 	BytePtr CollectorGeneration::allocate(std::size_t size) {
-		auto objPtr = mHeap.allocate(size);
+		auto objPtr = tryAllocate(size);
+		if (objPtr == nullptr) {
+			throw std::runtime_error("Could not allocate object.");
+		}
+
+		return objPtr;
+	}
+
+	BytePtr CollectorGeneration::tryAllocate(std::size_t size) {
+		BytePtr objPtr = nullptr;
+
+		if (mRegions != nullptr) {
+			objPtr = mRegions->allocate(size);
+		} else {
+			if (mFreeLists != nullptr) {
+				objPtr = mFreeLists->allocate(size);
+			}
+
+			if (objPtr == nullptr) {
+				objPtr = mHeap.allocate(size);
+			}
+		}
+
 		if (objPtr != nullptr) {
 			mNumAllocated++;
-		} else {
-			throw std::runtime_error("Could not allocate object.");
+
+			if (mCardSize > 0) {
+				//The rest of a free block is before the object, and still covers the cards that start inside it
+				recordInCrossingMap(objPtr, size);
+
+				//The cards after a humongous object start inside it, unless covered by the dead object after it
+				if (mRegions != nullptr && mRegions->isHumongous(size)) {
+					auto& lastRegion = mRegions->regionOf(objPtr + size - 1);
+					recordInCrossingMap(lastRegion.top, (std::size_t)(lastRegion.end - lastRegion.top));
+				}
+			}
 		}
 
 		return objPtr;
 	}
 
-	void CollectorGeneration::collected() {
-		mNumAllocated = 0;
+	void CollectorGeneration::grow(std::size_t size) {
+		auto oldEnd = mHeap.start() + mHeap.size();
+		mHeap.grow(size);
+		mForwardingTable.resize();
 
-		//Reset the card table
-		for (std::size_t i = 0; i < mNumCards; i++) {
-			mCardTable[i] = 0;
+		if (mCardSize > 0) {
+			mNumCards = mHeap.size() / mCardSize;
+			if (mNumCards > mNumCoveredCards) {
+				throw std::runtime_error("The heap has grown outside the card table.");
+			}
+
+			mCrossingMap.resize(mNumCards, 0);
+		}
+
+		if (mRegions != nullptr) {
+			mRegions->grow();
+
+			//The cards of the new regions start inside the dead objects that cover them
+			for (auto regionStart = oldEnd; regionStart < oldEnd + size; regionStart += mRegions->regionSize()) {
+				recordInCrossingMap(regionStart, mRegions->regionSize());
+			}
+		}
+	}
+
+	void CollectorGeneration::useRegions(std::size_t regionSize) {
+		mRegions.reset(new HeapRegions(mHeap, regionSize));
+		rebuildCrossingMap();
+	}
+
+	HeapRegions* CollectorGeneration::regions() const {
+		return mRegions.get();
+	}
+
+	void CollectorGeneration::freeRegion(HeapRegion& region) {
+		mRegions->freeRegion(region);
+
+		//The cards of the region start inside the dead object that covers it
+		recordInCrossingMap(region.start, mRegions->regionSize());
+		for (auto cardNumber = getCardNumber(region.start); cardNumber < getCardNumber(region.end - 1) + 1; cardNumber++) {
+			mCardTable[cardNumber] = 0;
 		}
 	}
+
+	void CollectorGeneration::useFreeLists() {
+		mFreeLists.reset(new FreeLists());
+	}
+
+	FreeLists* CollectorGeneration::freeLists() const {
+		return mFreeLists.get();
+	}
+
+	void CollectorGeneration::freeBlock(BytePtr start, std::size_t size) {
+		mFreeLists->add(start, size);
+		recordInCrossingMap(start, size);
+	}
+
+	void CollectorGeneration::collected() {
+		mNumAllocated = 0;
+	}
 }
\ No newline at end of file
@@ -1,25 +1,54 @@
 #pragma once
 #include "managedheap.h"
+#include "forwardingtable.h"
+#include "heapregions.h"
+#include "freelists.h"
+#include <cstdint>
+#include <vector>
+#include <memory>
 
 namespace stackjit {
 	//Represents a generation for the garbage collector
 	class CollectorGeneration {
 	private:
 		ManagedHeap mHeap;
+		ForwardingTable mForwardingTable;
 
 		std::size_t mNumAllocated = 0;
 		const std::size_t mAllocatedBeforeCollection = 0;
-		const int mSurvivedCollectionsBeforePromote = 0;
+		int mSurvivedCollectionsBeforePromote = 0;
+
+		//Where the allocations stop and a collection is needed. Null if the generation has no limit.
+		BytePtr mAllocationLimit = nullptr;
 
 		const std::size_t mCardSize;
-		const std::size_t mNumCards;
+		std::size_t mNumCards;
+		const std::size_t mNumCoveredCards;
+		std::size_t mCardShift = 0;
 		BytePtr mCardTable;
+
+		//The crossing map holds, for each card, the offset of the object that covers the first byte of the card.
+		//This makes it possible to find the objects in a card without walking the heap from the start.
+		std::vector<std::uint32_t> mCrossingMap;
+
+		//The regions of the heap. Null if the heap is allocated as a whole.
+		std::unique_ptr<HeapRegions> mRegions;
+
+		//The free blocks of the heap, when swept instead of compacted. Null if the heap is only allocated at its end.
+		std::unique_ptr<FreeLists> mFreeLists;
+
+		//Records the given memory block in the crossing map
+		void recordInCrossingMap(BytePtr blockPtr, std::size_t size);
 	public:
-		//Creates a new generation
-		CollectorGeneration(std::size_t size,
+		//Creates a new generation with the heap in the given memory. The card size must be a power of two, and the memory
+		//aligned to it. The card table also covers the given amount of memory after the heap, which lets the write barrier
+		//mark the card of any object in the heaps that follow without checking which heap the object is in.
+		CollectorGeneration(BytePtr data,
+							std::size_t size,
 							std::size_t allocatedBeforeCollection,
 							int survivedCollectionsBeforePromote = -1,
-							std::size_t cardSize = 0);
+							std::size_t cardSize = 0,
+							std::size_t coveredAfterHeap = 0);
 		~CollectorGeneration();
 
 		//Prevent the generation from being copied
@@ -30,28 +59,98 @@ namespace stackjit {
 		ManagedHeap& heap();
 		const ManagedHeap& heap() const;
 
+		//Returns the table holding the new locations of the objects when the heap is compacted
+		ForwardingTable& forwardingTable();
+
 		//Returns the number of cards
 		std::size_t numCards() const;
 
+		//Returns the number of entries in the card table, which includes the cards for the memory after the heap
+		std::size_t numCoveredCards() const;
+
 		//Returns the size of a card
 		std::size_t cardSize() const;
 
+		//Returns the number of bits to shift an address right to get its card
+		std::size_t cardShift() const;
+
 		//Returns the card table
 		BytePtr cardTable() const;
 
+		//Returns the address of the card table biased by the start of the heap,
+		//which means that the card for an address is at biasedCardTable() + (address >> cardShift()).
+		PtrValue biasedCardTable() const;
+
 		//Returns the card number for the given memory.
 		// Note: assumes that the pointer is inside the heap.
 		std::size_t getCardNumber(BytePtr ptr) const;
 
+		//Returns the start of the given card
+		BytePtr getCardStart(std::size_t cardNumber) const;
+
+		//Visits the alive objects that overlap the given card
+		void visitObjectsInCard(std::size_t cardNumber, std::function<void (ObjectRef)> fn) const;
+
+		//Rebuilds the crossing map. Must be called when the objects in the heap have been moved.
+		void rebuildCrossingMap();
+
+		//Clears the card table
+		void clearCardTable();
+
+		//Returns the number of allocations made before a collection is required
+		std::size_t allocatedBeforeCollection() const;
+
+		//Returns a pointer to the number of allocations since the last collection.
+		//Used by the allocations made in the generated code.
+		std::size_t* numAllocatedPtr();
+
+		//Returns a pointer to the allocation limit. Used by the allocations made in the generated code.
+		BytePtr* allocationLimitPtr();
+
+		//Sets the address where the allocations stop and a collection is needed. The heap itself can still be allocated
+		//past it, which means that the allocation that reaches the limit can always be made.
+		void setAllocationLimit(BytePtr allocationLimit);
+
 		//Indicates if the generation requires a collection
 		bool needsToCollect() const;
 
 		//Indicates if the given object needs to be promoted to an older generation
 		bool needsToPromote(int survivalCount) const;
 
+		//Sets the number of collections that an object survives before it is promoted
+		void setSurvivedCollectionsBeforePromote(int survivedCollections);
+
+		//Returns the number of bytes used by the objects in the heap, including the dead objects.
+		//When divided into regions, the regions in use count as full. The blocks in the free lists are not used.
+		std::size_t usedBytes() const;
+
 		//Allocates an object of the given size
 		BytePtr allocate(std::size_t size);
 
+		//Allocates an object of the given size. Returns nullptr if not allocated
+		BytePtr tryAllocate(std::size_t size);
+
+		//Grows the heap by the given amount. The memory after the heap must be zeroed, and covered by the card table.
+		void grow(std::size_t size);
+
+		//Divides the heap into regions of the given size. The heap must be empty.
+		void useRegions(std::size_t regionSize);
+
+		//Returns the regions of the heap, or null if not divided into regions
+		HeapRegions* regions() const;
+
+		//Frees the given region, and clears its cards
+		void freeRegion(HeapRegion& region);
+
+		//Allocates the objects in the free lists first, which are filled by sweeping the heap
+		void useFreeLists();
+
+		//Returns the free lists of the heap, or null if not used
+		FreeLists* freeLists() const;
+
+		//Adds the given memory block to the free lists
+		void freeBlock(BytePtr start, std::size_t size);
+
 		//Marks that the generation has been collected
 		void collected();
 	};
@@ -0,0 +1,85 @@
+#include "gcworkers.h"
+#include <stdexcept>
+
+namespace stackjit {
+	GCWorkerPool::GCWorkerPool(int numWorkers) {
+		if (numWorkers < 1) {
+			throw std::runtime_error("The GC requires at least one worker.");
+		}
+
+		for (int workerNumber = 1; workerNumber < numWorkers; workerNumber++) {
+			mThreads.emplace_back([this, workerNumber]() {
+				workerLoop(workerNumber);
+			});
+		}
+	}
+
+	GCWorkerPool::~GCWorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+
+		mStartCondition.notify_all();
+		for (auto& thread : mThreads) {
+			thread.join();
+		}
+	}
+
+	int GCWorkerPool::numWorkers() const {
+		return (int)mThreads.size() + 1;
+	}
+
+	void GCWorkerPool::workerLoop(int workerNumber) {
+		std::size_t lastTaskNumber = 0;
+
+		while (true) {
+			Task task;
+
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mStartCondition.wait(lock, [&]() {
+					return mStop || mTaskNumber != lastTaskNumber;
+				});
+
+				if (mStop) {
+					return;
+				}
+
+				lastTaskNumber = mTaskNumber;
+				task = mTask;
+			}
+
+			task(workerNumber);
+
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mNumRunning--;
+			}
+
+			mDoneCondition.notify_one();
+		}
+	}
+
+	void GCWorkerPool::run(Task task) {
+		if (mThreads.empty()) {
+			task(0);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mTask = task;
+			mTaskNumber++;
+			mNumRunning = (int)mThreads.size();
+		}
+
+		mStartCondition.notify_all();
+		task(0);
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDoneCondition.wait(lock, [this]() {
+			return mNumRunning == 0;
+		});
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace stackjit {
+	//A pool of threads that the garbage collector uses to run the phases of a collection in parallel.
+	//The threads are created once and wait for work between the collections.
+	class GCWorkerPool {
+	public:
+		//A task, called with the number of the worker running it
+		using Task = std::function<void (int workerNumber)>;
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mMutex;
+		std::condition_variable mStartCondition;
+		std::condition_variable mDoneCondition;
+
+		Task mTask;
+		std::size_t mTaskNumber = 0;
+		int mNumRunning = 0;
+		bool mStop = false;
+
+		//The loop run by the threads
+		void workerLoop(int workerNumber);
+	public:
+		//Creates a pool with the given number of workers. The thread that runs a task is also a worker,
+		//so one less thread is created.
+		explicit GCWorkerPool(int numWorkers);
+		~GCWorkerPool();
+
+		//Prevent the pool from being copied
+		GCWorkerPool(const GCWorkerPool&) = delete;
+		GCWorkerPool& operator=(const GCWorkerPool&) = delete;
+
+		//Returns the number of workers
+		int numWorkers() const;
+
+		//Runs the given task on all workers, and waits for them to finish.
+		//The calling thread runs the task as worker zero.
+		void run(Task task);
+	};
+}
@@ -0,0 +1,36 @@
+#include "heapmemory.h"
+#include "../compiler/allocator.h"
+#include <stdexcept>
+
+namespace stackjit {
+	HeapMemory::HeapMemory(std::size_t size)
+		: mData((BytePtr)Allocator::reserve(size)), mSize(size) {
+		if (mData == nullptr) {
+			throw std::runtime_error("Could not reserve memory for the heap.");
+		}
+	}
+
+	HeapMemory::~HeapMemory() {
+		Allocator::deallocate(mData, mSize);
+	}
+
+	BytePtr HeapMemory::data() const {
+		return mData;
+	}
+
+	std::size_t HeapMemory::size() const {
+		return mSize;
+	}
+
+	bool HeapMemory::inside(BytePtr ptr) const {
+		return ptr >= mData && ptr < mData + mSize;
+	}
+
+	bool HeapMemory::commit(BytePtr start, std::size_t size) {
+		if (start < mData || start + size > mData + mSize) {
+			throw std::runtime_error("The memory is outside the reserved memory.");
+		}
+
+		return Allocator::commit(start, size);
+	}
+}
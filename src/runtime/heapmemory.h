@@ -0,0 +1,33 @@
+#pragma once
+#include "../type/objectref.h"
+
+namespace stackjit {
+	//Represents the address space reserved for the heaps. Memory is committed to the parts of it that the heaps use,
+	//which lets a heap grow without moving it.
+	class HeapMemory {
+	private:
+		BytePtr mData;
+		std::size_t mSize;
+	public:
+		//Reserves address space of the given size
+		HeapMemory(std::size_t size);
+		~HeapMemory();
+
+		//Prevent the memory from being copied
+		HeapMemory(const HeapMemory&) = delete;
+		HeapMemory& operator=(const HeapMemory&) = delete;
+
+		//Returns the start of the memory
+		BytePtr data() const;
+
+		//Returns the size of the memory
+		std::size_t size() const;
+
+		//Indicates if the given pointer is inside the memory
+		bool inside(BytePtr ptr) const;
+
+		//Commits memory to the given part of the reserved memory. The committed memory is zeroed.
+		//Returns false if there is not enough memory.
+		bool commit(BytePtr start, std::size_t size);
+	};
+}
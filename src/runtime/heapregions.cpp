@@ -0,0 +1,190 @@
+#include "heapregions.h"
+#include "managedheap.h"
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+namespace stackjit {
+	HeapRegions::HeapRegions(ManagedHeap& heap, std::size_t regionSize)
+		: mHeap(heap), mRegionSize(regionSize) {
+		if ((mRegionSize & (mRegionSize - 1)) != 0 || mHeap.size() % mRegionSize != 0) {
+			throw std::runtime_error("The region size must be a power of two that divides the size of the heap.");
+		}
+
+		while (((std::size_t)1 << mRegionShift) < mRegionSize) {
+			mRegionShift++;
+		}
+
+		grow();
+	}
+
+	void HeapRegions::grow() {
+		if (mHeap.size() % mRegionSize != 0) {
+			throw std::runtime_error("The heap must grow by a multiple of the region size.");
+		}
+
+		//The regions can move in memory
+		std::size_t allocationRegionIndex = 0;
+		if (mAllocationRegion != nullptr) {
+			allocationRegionIndex = (std::size_t)(mAllocationRegion - &mRegions[0]);
+		}
+
+		auto firstNew = mRegions.size();
+		mRegions.resize(mHeap.size() / mRegionSize);
+		for (auto i = firstNew; i < mRegions.size(); i++) {
+			auto& region = mRegions[i];
+			region.start = mHeap.start() + i * mRegionSize;
+			region.end = region.start + mRegionSize;
+			region.top = region.start;
+			region.collectionTop = region.start;
+			fill(region.start, region.end);
+		}
+
+		if (mAllocationRegion != nullptr) {
+			mAllocationRegion = &mRegions[allocationRegionIndex];
+		}
+
+		//As all the regions are covered by objects, the whole heap can be walked
+		mHeap.setNextAllocation(mHeap.end());
+	}
+
+	void HeapRegions::fill(BytePtr start, BytePtr end) {
+		if (start < end) {
+			ManagedHeap::makeDeadObject(start, (std::size_t)(end - start));
+		}
+	}
+
+	bool HeapRegions::fits(BytePtr start, BytePtr end, std::size_t size) const {
+		auto available = (std::size_t)(end - start);
+		return available == size || available >= size + stackjit::OBJECT_HEADER_SIZE;
+	}
+
+	HeapRegion* HeapRegions::takeFreeRegions(std::size_t size) {
+		for (std::size_t first = 0; first < mRegions.size(); first++) {
+			if (!mRegions[first].isFree) {
+				continue;
+			}
+
+			auto last = first;
+			while (!fits(mRegions[first].start, mRegions[last].end, size)) {
+				last++;
+				if (last == mRegions.size() || !mRegions[last].isFree) {
+					break;
+				}
+			}
+
+			if (last < mRegions.size() && mRegions[last].isFree) {
+				for (auto i = first; i <= last; i++) {
+					mRegions[i].isFree = false;
+				}
+
+				return &mRegions[first];
+			}
+
+			first = last;
+		}
+
+		return nullptr;
+	}
+
+	std::size_t HeapRegions::regionSize() const {
+		return mRegionSize;
+	}
+
+	std::vector<HeapRegion>& HeapRegions::regions() {
+		return mRegions;
+	}
+
+	const std::vector<HeapRegion>& HeapRegions::regions() const {
+		return mRegions;
+	}
+
+	HeapRegion& HeapRegions::regionOf(BytePtr ptr) {
+		return mRegions[(std::size_t)(ptr - mHeap.start()) >> mRegionShift];
+	}
+
+	std::size_t HeapRegions::numFreeRegions() const {
+		std::size_t numFree = 0;
+		for (auto& region : mRegions) {
+			if (region.isFree) {
+				numFree++;
+			}
+		}
+
+		return numFree;
+	}
+
+	bool HeapRegions::isHumongous(std::size_t size) const {
+		return size > mRegionSize / 2;
+	}
+
+	BytePtr HeapRegions::allocate(std::size_t size) {
+		if (isHumongous(size)) {
+			auto firstRegion = takeFreeRegions(size);
+			if (firstRegion == nullptr) {
+				return nullptr;
+			}
+
+			//The object starts at the first region, and the rest of the last region is covered by a dead object
+			auto objPtr = firstRegion->start;
+			auto& lastRegion = regionOf(objPtr + size - 1);
+			for (auto region = firstRegion; region <= &lastRegion; region++) {
+				region->isHumongous = true;
+				region->top = region->end;
+			}
+
+			lastRegion.top = objPtr + size;
+			fill(lastRegion.top, lastRegion.end);
+			return objPtr;
+		}
+
+		if (mAllocationRegion == nullptr || !fits(mAllocationRegion->top, mAllocationRegion->end, size)) {
+			mAllocationRegion = takeFreeRegions(size);
+			if (mAllocationRegion == nullptr) {
+				return nullptr;
+			}
+		}
+
+		auto objPtr = mAllocationRegion->top;
+		mAllocationRegion->top += size;
+		fill(mAllocationRegion->top, mAllocationRegion->end);
+		return objPtr;
+	}
+
+	HeapRegion* HeapRegions::allocationRegion() const {
+		return mAllocationRegion;
+	}
+
+	void HeapRegions::freeRegion(HeapRegion& region) {
+		std::memset(region.start, 0, mRegionSize);
+		fill(region.start, region.end);
+
+		region.top = region.start;
+		region.isFree = true;
+		region.isHumongous = false;
+		region.inCollectionSet = false;
+		region.evacuationFailed = false;
+		region.liveBytes = 0;
+		region.rememberedCards.clear();
+
+		if (mAllocationRegion == &region) {
+			mAllocationRegion = nullptr;
+		}
+	}
+
+	void HeapRegions::addLiveBytes(BytePtr blockPtr, std::size_t size) {
+		while (size > 0) {
+			auto& region = regionOf(blockPtr);
+			auto sizeInRegion = std::min(size, (std::size_t)(region.end - blockPtr));
+			region.liveBytes += sizeInRegion;
+			blockPtr += sizeInRegion;
+			size -= sizeInRegion;
+		}
+	}
+
+	void HeapRegions::recordTops() {
+		for (auto& region : mRegions) {
+			region.collectionTop = region.top;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "../type/objectref.h"
+#include <vector>
+#include <unordered_set>
+
+namespace stackjit {
+	class ManagedHeap;
+
+	//Represents a region of a heap
+	struct HeapRegion {
+		BytePtr start;
+		BytePtr end;
+
+		//Where the next allocation in the region occurs
+		BytePtr top;
+
+		//The top of the region when the current collection started. The objects after it were allocated by the collection.
+		BytePtr collectionTop;
+
+		bool isFree = true;
+
+		//Indicates if the region holds a part of a humongous object. Such objects are never moved.
+		bool isHumongous = false;
+
+		//Indicates if the region is evacuated by the current collection
+		bool inCollectionSet = false;
+
+		//Indicates if an object in the region could not be evacuated, as there was no free memory left
+		bool evacuationFailed = false;
+
+		//The size of the alive objects in the region, computed after the heap has been marked
+		std::size_t liveBytes = 0;
+
+		//The cards in other regions that can contain references to objects in the region
+		std::unordered_set<std::size_t> rememberedCards;
+	};
+
+	//Divides a heap into regions of equal size, which can be collected separately. The objects are allocated in one
+	//region at a time, and are never split between regions. Objects larger than half a region (humongous objects) get
+	//regions of their own. The parts of the regions that are not allocated are covered by dead objects, which keeps
+	//the whole heap walkable.
+	class HeapRegions {
+	private:
+		ManagedHeap& mHeap;
+		const std::size_t mRegionSize;
+		std::size_t mRegionShift = 0;
+		std::vector<HeapRegion> mRegions;
+		HeapRegion* mAllocationRegion = nullptr;
+
+		//Covers the given memory with a dead object
+		void fill(BytePtr start, BytePtr end);
+
+		//Indicates if the given amount of memory can be allocated in the given memory. The rest must be large enough for a dead object.
+		bool fits(BytePtr start, BytePtr end, std::size_t size) const;
+
+		//Takes the first free regions that the given amount of memory fits in. Returns null if not found.
+		HeapRegion* takeFreeRegions(std::size_t size);
+	public:
+		//Divides the given heap into regions of the given size, which must be a power of two that divides the size of the heap
+		HeapRegions(ManagedHeap& heap, std::size_t regionSize);
+
+		//Prevent the regions from being copied
+		HeapRegions(const HeapRegions&) = delete;
+		HeapRegions& operator=(const HeapRegions&) = delete;
+
+		//Adds regions for the memory that the heap has grown with. The growth must be a multiple of the region size.
+		void grow();
+
+		//Returns the size of a region
+		std::size_t regionSize() const;
+
+		//Returns the regions
+		std::vector<HeapRegion>& regions();
+		const std::vector<HeapRegion>& regions() const;
+
+		//Returns the region of the given memory
+		HeapRegion& regionOf(BytePtr ptr);
+
+		//Returns the number of free regions
+		std::size_t numFreeRegions() const;
+
+		//Indicates if an object of the given size is humongous
+		bool isHumongous(std::size_t size) const;
+
+		//Allocates a memory block of the given size. Returns nullptr if not allocated
+		BytePtr allocate(std::size_t size);
+
+		//Returns the region that is currently allocated in, or null if the next allocation takes a free region
+		HeapRegion* allocationRegion() const;
+
+		//Frees the given region. The memory of the region is cleared.
+		void freeRegion(HeapRegion& region);
+
+		//Adds the given memory block to the alive bytes of the regions it is in
+		void addLiveBytes(BytePtr blockPtr, std::size_t size);
+
+		//Records the tops of the regions when a collection starts
+		void recordTops();
+	};
+}
@@ -0,0 +1,28 @@
+#include "inlinecache.h"
+#include <cstddef>
+
+namespace stackjit {
+	VirtualCallCache::VirtualCallCache(int index)
+		: types(), targets(), index(index) {
+
+	}
+
+	int VirtualCallCache::typeOffset(int entry) {
+		return (int)(offsetof(VirtualCallCache, types) + entry * sizeof(const ClassType*));
+	}
+
+	int VirtualCallCache::targetOffset(int entry) {
+		return (int)(offsetof(VirtualCallCache, targets) + entry * sizeof(BytePtr));
+	}
+
+	void VirtualCallCache::add(const ClassType* type, BytePtr target) {
+		for (int i = 0; i < SIZE; i++) {
+			if (types[i] == nullptr) {
+				//The target must be set before the type, as the type is compared first
+				targets[i] = target;
+				types[i] = type;
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "../type/objectref.h"
+
+namespace stackjit {
+	class ClassType;
+
+	//Represents the inline cache of a virtual call site. The generated code compares the type of the receiver
+	//with the cached types, and calls the cached function on a hit. Misses are handled by the runtime,
+	//which adds the type to the cache. When the cache is full, the call site is megamorphic, and the generated code
+	//instead loads the function from the virtual function table, which is checked by the last type being non-null.
+	struct VirtualCallCache {
+		//The number of types that can be cached
+		static const int SIZE = 4;
+
+		//The cached types, where unused entries are null
+		const ClassType* types[SIZE];
+
+		//The function to call for the type at the same index
+		BytePtr targets[SIZE];
+
+		//The index of the virtual function in the virtual function table
+		const int index;
+
+		//Creates an empty cache for the given virtual function
+		VirtualCallCache(int index);
+
+		//Returns the offset of the given type entry
+		static int typeOffset(int entry);
+
+		//Returns the offset of the given target entry
+		static int targetOffset(int entry);
+
+		//Adds the given type to the cache. If the cache is full, the type is not added.
+		void add(const ClassType* type, BytePtr target);
+	};
+}
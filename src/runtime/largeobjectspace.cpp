@@ -0,0 +1,76 @@
+#include "largeobjectspace.h"
+#include "../compiler/allocator.h"
+#include <algorithm>
+
+namespace stackjit {
+	namespace {
+		const std::size_t PAGE_SIZE = 4096;
+	}
+
+	LargeObjectSpace::LargeObjectSpace() {
+
+	}
+
+	LargeObjectSpace::~LargeObjectSpace() {
+		for (auto& chunk : mChunks) {
+			Allocator::deallocate(chunk.start, chunk.size);
+		}
+	}
+
+	std::size_t LargeObjectSpace::chunkSize(std::size_t size) {
+		return (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	}
+
+	std::size_t LargeObjectSpace::size() const {
+		return mSize;
+	}
+
+	BytePtr LargeObjectSpace::allocate(std::size_t size) {
+		auto memorySize = chunkSize(size);
+		auto memory = (BytePtr)Allocator::reserve(memorySize);
+		if (memory == nullptr) {
+			return nullptr;
+		}
+
+		if (!Allocator::commit(memory, memorySize)) {
+			Allocator::deallocate(memory, memorySize);
+			return nullptr;
+		}
+
+		mChunks.push_back({ memory, memorySize });
+		mSize += memorySize;
+		return memory;
+	}
+
+	void LargeObjectSpace::visitObjects(std::function<void (ObjectRef)> fn) {
+		for (auto& chunk : mChunks) {
+			fn(ObjectRef(chunk.start + stackjit::OBJECT_HEADER_SIZE));
+		}
+	}
+
+	int LargeObjectSpace::sweep(std::function<void (ObjectRef)> freed) {
+		int numFreed = 0;
+
+		auto newEnd = std::remove_if(mChunks.begin(), mChunks.end(), [&](const Chunk& chunk) {
+			ObjectRef objRef(chunk.start + stackjit::OBJECT_HEADER_SIZE);
+			if (objRef.isMarked()) {
+				objRef.unmark();
+				return false;
+			}
+
+			freed(objRef);
+			Allocator::deallocate(chunk.start, chunk.size);
+			mSize -= chunk.size;
+			numFreed++;
+			return true;
+		});
+
+		mChunks.erase(newEnd, mChunks.end());
+		mSizeAfterSweep = mSize;
+		return numFreed;
+	}
+
+	std::size_t LargeObjectSpace::allocatedSinceSweep() const {
+		return mSize - mSizeAfterSweep;
+	}
+}
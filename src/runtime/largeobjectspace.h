@@ -0,0 +1,49 @@
+#pragma once
+#include "../type/objectref.h"
+#include <vector>
+#include <functional>
+
+namespace stackjit {
+	//Holds the objects that are too large to be moved by the collections. Each object gets page aligned memory of its own,
+	//which is given back to the operating system when the object dies. The objects are marked when the old generation
+	//is collected, but never moved. As the objects can't contain references, they are never traced.
+	class LargeObjectSpace {
+	private:
+		//The memory of an object
+		struct Chunk {
+			BytePtr start;
+			std::size_t size;
+		};
+
+		std::vector<Chunk> mChunks;
+		std::size_t mSize = 0;
+		std::size_t mSizeAfterSweep = 0;
+	public:
+		//Creates an empty space
+		LargeObjectSpace();
+		~LargeObjectSpace();
+
+		//Prevent the space from being copied
+		LargeObjectSpace(const LargeObjectSpace&) = delete;
+		LargeObjectSpace& operator=(const LargeObjectSpace&) = delete;
+
+		//Returns the size of the memory used by the given amount of memory, which is rounded up to whole pages
+		static std::size_t chunkSize(std::size_t size);
+
+		//Returns the size of the memory used by the objects
+		std::size_t size() const;
+
+		//Allocates a zeroed memory block of the given size. Returns nullptr if not allocated
+		BytePtr allocate(std::size_t size);
+
+		//Visits all the objects
+		void visitObjects(std::function<void (ObjectRef)> fn);
+
+		//Frees the objects that are not marked, and unmarks the rest. The given function is called for each object before
+		//it is freed. Returns the number of freed objects.
+		int sweep(std::function<void (ObjectRef)> freed);
+
+		//Returns the size of the memory allocated since the last sweep
+		std::size_t allocatedSinceSweep() const;
+	};
+}
@@ -1,15 +1,15 @@
 #include "managedheap.h"
+#include "../helpers.h"
+#include <cstring>
+#include <stdexcept>
+#include <utility>
 
 namespace stackjit {
-	ManagedHeap::ManagedHeap(std::size_t size)
-		: mData(new unsigned char[size]), mSize(size), mNextAllocation(mData) {
+	ManagedHeap::ManagedHeap(BytePtr data, std::size_t size)
+		: mData(data), mSize(size), mEnd(mData + (mSize - 1)), mNextAllocation(mData) {
 
 	}
 
-	ManagedHeap::~ManagedHeap() {
-		delete[] mData;
-	}
-
 	BytePtr ManagedHeap::data() const {
 		return mData;
 	}
@@ -23,7 +23,7 @@ namespace stackjit {
 	}
 
 	BytePtr ManagedHeap::end() const {
-		return mData + (mSize - 1);
+		return mEnd;
 	}
 
 	bool ManagedHeap::inside(BytePtr ptr) const {
@@ -42,24 +42,69 @@ namespace stackjit {
 		}
 	}
 
+	void ManagedHeap::grow(std::size_t size) {
+		mSize += size;
+		mEnd = mData + (mSize - 1);
+	}
+
 	void ManagedHeap::setNextAllocation(BytePtr nextAllocation) {
 		if (nextAllocation >= mData && nextAllocation <= end()) {
+			if (nextAllocation < mNextAllocation) {
+				std::memset(nextAllocation, 0, (std::size_t)(mNextAllocation - nextAllocation));
+			}
+
 			mNextAllocation = nextAllocation;
 		} else {
 			throw std::runtime_error("The pointer is outside the heap.");
 		}
 	}
 
+	BytePtr ManagedHeap::nextAllocation() const {
+		return mNextAllocation;
+	}
+
+	BytePtr* ManagedHeap::nextAllocationPtr() {
+		return &mNextAllocation;
+	}
+
+	void ManagedHeap::swap(ManagedHeap& other) {
+		std::swap(mData, other.mData);
+		std::swap(mSize, other.mSize);
+		std::swap(mEnd, other.mEnd);
+		std::swap(mNextAllocation, other.mNextAllocation);
+	}
+
+	//A dead object holds the amount of memory to skip, followed by the indicator
+	void ManagedHeap::makeDeadObject(BytePtr start, std::size_t size) {
+		Helpers::setValue<std::size_t>(start, 0, size);
+		Helpers::setValue<unsigned char>(start, sizeof(std::size_t), DEAD_OBJECT_INDICATOR);
+	}
+
+	bool ManagedHeap::isDeadObject(BytePtr start) {
+		return *(start + sizeof(std::size_t)) == DEAD_OBJECT_INDICATOR;
+	}
+
+	std::size_t ManagedHeap::blockSize(BytePtr start) {
+		if (isDeadObject(start)) {
+			return *(std::size_t*)start;
+		} else {
+			return ObjectRef(start + stackjit::OBJECT_HEADER_SIZE).fullSize();
+		}
+	}
+
 	void ManagedHeap::visitObjects(std::function<void (ObjectRef)> fn) {
-		auto current = mData;
-		while (current < mNextAllocation) {
-			if (*(current + sizeof(std::size_t)) != 0xFF) {
+		visitObjects(mData, mNextAllocation, fn);
+	}
+
+	void ManagedHeap::visitObjects(BytePtr start, BytePtr end, std::function<void (ObjectRef)> fn) {
+		auto current = start;
+		while (current < end) {
+			if (!isDeadObject(current)) {
 				ObjectRef objRef(current + stackjit::OBJECT_HEADER_SIZE);
 				fn(objRef);
 				current += objRef.fullSize();
 			} else {
-				//Dead object
-				current += *(std::size_t*)(current);
+				current += blockSize(current);
 			}
 		}
 	}
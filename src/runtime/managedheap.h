@@ -3,16 +3,20 @@
 #include <vector>
 
 namespace stackjit {
-	//Represents a managed heap.
+	//Represents a managed heap. The memory that has not been allocated is always zero,
+	//which means that allocated objects don't need to be cleared.
 	class ManagedHeap {
 	private:
-		BytePtr const mData;
-		const std::size_t mSize;
+		BytePtr mData;
+		std::size_t mSize;
+		BytePtr mEnd;
 		BytePtr mNextAllocation;
+
+		//Stored after the size of a dead object, where an alive object has its GC info
+		static const unsigned char DEAD_OBJECT_INDICATOR = 0xFF;
 	public:
-		//Creates a heap of the given size
-		ManagedHeap(std::size_t size);
-		~ManagedHeap();
+		//Creates a heap in the given memory, which must be zeroed. The memory is owned by the caller.
+		ManagedHeap(BytePtr data, std::size_t size);
 
 		//Returns a pointer to the data in the heap.
 		BytePtr data() const;
@@ -32,10 +36,35 @@ namespace stackjit {
 		//Allocates a memory block of the given size. Returns nullptr if not allocated
 		BytePtr allocate(std::size_t size);
 
-		//Sets where the next allocation should occur.
+		//Grows the heap by the given amount. The memory after the heap must be zeroed.
+		void grow(std::size_t size);
+
+		//Sets where the next allocation should occur. The memory after it is zeroed.
 		void setNextAllocation(BytePtr nextAllocation);
 
+		//Returns where the next allocation occurs
+		BytePtr nextAllocation() const;
+
+		//Swaps the memory and allocations of the heaps. The addresses of the heaps themselves stay the same.
+		void swap(ManagedHeap& other);
+
+		//Returns a pointer to where the next allocation occurs. Used by the allocations made in the generated code.
+		BytePtr* nextAllocationPtr();
+
+		//Covers the given memory with a dead object, which is skipped when walking the heap.
+		//The memory must be at least as large as an object header.
+		static void makeDeadObject(BytePtr start, std::size_t size);
+
+		//Indicates if a dead object starts at the given memory
+		static bool isDeadObject(BytePtr start);
+
+		//Returns the size of the dead object or the alive object, including the header, that starts at the given memory
+		static std::size_t blockSize(BytePtr start);
+
 		//Visits all the alive objects in the heap.
 		void visitObjects(std::function<void (ObjectRef)> fn);
+
+		//Visits the alive objects in the given part of the heap. The part must start at an object.
+		void visitObjects(BytePtr start, BytePtr end, std::function<void (ObjectRef)> fn);
 	};
 }
@@ -0,0 +1,113 @@
+#include "markstack.h"
+#include <thread>
+
+namespace stackjit {
+	MarkStacks::WorkerStack::WorkerStack()
+		: numShared(0) {
+
+	}
+
+	MarkStacks::MarkStacks()
+		: mNumActive(0) {
+		reset(1);
+	}
+
+	void MarkStacks::reset(int numWorkers) {
+		while ((int)mStacks.size() < numWorkers) {
+			mStacks.emplace_back(new WorkerStack());
+		}
+
+		mStacks.resize((std::size_t)numWorkers);
+		for (auto& stack : mStacks) {
+			stack->local.clear();
+			stack->shared.clear();
+			stack->numShared = 0;
+		}
+
+		mNumActive = numWorkers;
+	}
+
+	int MarkStacks::numWorkers() const {
+		return (int)mStacks.size();
+	}
+
+	void MarkStacks::share(WorkerStack& stack) {
+		auto half = stack.local.size() / 2;
+
+		std::lock_guard<std::mutex> lock(stack.sharedMutex);
+		stack.shared.insert(stack.shared.end(), stack.local.begin(), stack.local.begin() + half);
+		stack.local.erase(stack.local.begin(), stack.local.begin() + half);
+		stack.numShared = stack.shared.size();
+	}
+
+	bool MarkStacks::steal(int workerNumber) {
+		auto& stack = *mStacks[workerNumber];
+
+		for (std::size_t i = 0; i < mStacks.size(); i++) {
+			auto& victim = *mStacks[(workerNumber + i) % mStacks.size()];
+			if (victim.numShared == 0) {
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(victim.sharedMutex);
+			if (victim.shared.empty()) {
+				continue;
+			}
+
+			//The own shared stack is taken completely, which means that it is empty when the worker becomes inactive
+			auto count = &victim == &stack ? victim.shared.size() : (victim.shared.size() + 1) / 2;
+			auto first = victim.shared.end() - count;
+			stack.local.insert(stack.local.end(), first, victim.shared.end());
+			victim.shared.erase(first, victim.shared.end());
+			victim.numShared = victim.shared.size();
+			return true;
+		}
+
+		return false;
+	}
+
+	bool MarkStacks::anyShared() const {
+		for (auto& stack : mStacks) {
+			if (stack->numShared != 0) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool MarkStacks::popSlow(int workerNumber, RawObjectRef& objPtr) {
+		auto& stack = *mStacks[workerNumber];
+
+		while (stack.local.empty()) {
+			if (steal(workerNumber)) {
+				break;
+			}
+
+			//Only active workers share objects. As an inactive worker has an empty shared stack, all objects
+			//have been marked when no worker is active.
+			mNumActive--;
+
+			while (true) {
+				if (mNumActive == 0) {
+					return false;
+				}
+
+				if (anyShared()) {
+					mNumActive++;
+					break;
+				}
+
+				std::this_thread::yield();
+			}
+		}
+
+		if (stack.local.size() > SHARE_THRESHOLD && mStacks.size() > 1 && stack.numShared == 0) {
+			share(stack);
+		}
+
+		objPtr = stack.local.back();
+		stack.local.pop_back();
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "../type/objectref.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+namespace stackjit {
+	//The mark stacks of the workers when the GC marks in parallel. Each worker pushes and pops on its own stack,
+	//and shares the bottom half of it when it grows large. A worker that runs out of objects steals from the shared
+	//part of the other stacks. The marking has finished when all workers are out of objects.
+	class MarkStacks {
+	private:
+		//The size of the local stack before half of it is shared
+		static const std::size_t SHARE_THRESHOLD = 64;
+
+		struct WorkerStack {
+			std::vector<RawObjectRef> local;
+
+			std::mutex sharedMutex;
+			std::vector<RawObjectRef> shared;
+			std::atomic<std::size_t> numShared;
+
+			WorkerStack();
+		};
+
+		std::vector<std::unique_ptr<WorkerStack>> mStacks;
+		std::atomic<int> mNumActive;
+
+		//Moves the bottom half of the local stack of the given worker to its shared stack
+		void share(WorkerStack& stack);
+
+		//Moves objects from the shared stacks to the local stack of the given worker. The shared stack of the worker is
+		//taken first, and then half of the shared stack of another worker. Returns false if there was nothing to take.
+		bool steal(int workerNumber);
+
+		//Indicates if any of the shared stacks has objects
+		bool anyShared() const;
+
+		//Pops an object when the local stack is empty or needs to be shared
+		bool popSlow(int workerNumber, RawObjectRef& objPtr);
+	public:
+		//Creates the stacks for a single worker
+		MarkStacks();
+
+		//Clears the stacks and sets the number of workers. All workers are active.
+		void reset(int numWorkers);
+
+		//Returns the number of workers
+		int numWorkers() const;
+
+		//Pushes the given object to the stack of the given worker
+		inline void push(int workerNumber, RawObjectRef objPtr) {
+			mStacks[workerNumber]->local.push_back(objPtr);
+		}
+
+		//Pops an object for the given worker, stealing objects if its stack is empty.
+		//Returns false when all workers are out of objects.
+		inline bool pop(int workerNumber, RawObjectRef& objPtr) {
+			auto& local = mStacks[workerNumber]->local;
+			if (!local.empty() && (local.size() <= SHARE_THRESHOLD || mStacks.size() == 1)) {
+				objPtr = local.back();
+				local.pop_back();
+				return true;
+			}
+
+			return popSlow(workerNumber, objPtr);
+		}
+	};
+}
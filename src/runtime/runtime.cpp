@@ -4,6 +4,7 @@
 #include "../core/function.h"
 #include "../type/type.h"
 #include "stackframe.h"
+#include "inlinecache.h"
 #include "../helpers.h"
 #include "../stackjit.h"
 #include "native.h"
@@ -95,26 +96,75 @@ namespace stackjit {
 		Helpers::setValue(codePtr, (std::size_t)checkStart + 1, checkEnd - (checkStart + 5));
 	}
 
+	void Runtime::tierUpFunction(ManagedFunction* function) {
+		//Active invocations of the baseline code may still reach the counters
+		if (function->jitTier() == JitTier::Optimizing) {
+			return;
+		}
+
+		if (vmState()->config.enableDebug && vmState()->config.printTierUp) {
+			std::cout << "Recompiling " << FunctionSignature::from(function->def()).str() << " with the optimizing tier." << std::endl;
+		}
+
+		try {
+			vmState()->engine().tierUpFunction(function);
+		} catch (std::runtime_error& e) {
+			std::cout << e.what() << std::endl;
+			exit(0);
+		}
+
+		//Invocations that are still in a loop of the baseline code enter the optimized code at the next iteration
+		function->backedgeCounter() = 1;
+	}
+
+	BytePtr Runtime::tierUpLoop(ManagedFunction* function, int loopHeader) {
+		tierUpFunction(function);
+
+		auto osrEntry = vmState()->engine().jitCompiler().getOsrEntry(*function, loopHeader);
+		if (osrEntry != nullptr) {
+			//Other invocations that are in the baseline code may also be replaced
+			function->backedgeCounter() = 1;
+
+			if (vmState()->config.enableDebug && vmState()->config.printTierUp) {
+				std::cout
+					<< "Replacing " << FunctionSignature::from(function->def()).str()
+					<< " at instruction " << loopHeader << "." << std::endl;
+			}
+		}
+
+		return osrEntry;
+	}
+
 	BytePtr Runtime::getVirtualFunctionAddress(RawClassRef rawClassRef, int index) {
 		auto classRef = vmState()->gc().getClassRef(rawClassRef);
 		auto classType = static_cast<const ClassType*>(classRef.objRef().type());
-		auto funcPtr = classType->metadata()->virtualFunctionTable()[index];
+		return compileVirtualFunction(classType->metadata(), index);
+	}
 
-		if (funcPtr != nullptr) {
-			return funcPtr;
-		} else {
-			//Compile
-			auto signature = classType->metadata()->getVirtualFunctionSignature(index);
-			JitFunction entryPoint = nullptr;
+	BytePtr Runtime::compileVirtualFunction(const ClassMetadata* metadata, int index) {
+		//The function might already have been compiled, if it is inherited from a parent class
+		auto& signature = metadata->getVirtualFunctionSignature(index);
+		auto& funcDef = vmState()->binder().getFunction(signature);
+
+		if (funcDef.entryPoint() == nullptr) {
 			try {
-				vmState()->engine().compileFunction(signature, entryPoint);
+				vmState()->engine().compileFunction(signature);
 			} catch (std::runtime_error& e) {
 				std::cout << e.what() << std::endl;
 				exit(0);
 			}
-
-			return (BytePtr)entryPoint;
 		}
+
+		auto funcPtr = funcDef.entryPoint();
+		metadata->virtualFunctionTable()[index] = funcPtr;
+		return funcPtr;
+	}
+
+	BytePtr Runtime::virtualCallCacheMiss(RawClassRef rawClassRef, VirtualCallCache* cache) {
+		auto funcPtr = getVirtualFunctionAddress(rawClassRef, cache->index);
+		auto classRef = vmState()->gc().getClassRef(rawClassRef);
+		cache->add(static_cast<const ClassType*>(classRef.objRef().type()), funcPtr);
+		return funcPtr;
 	}
 
 	std::string Runtime::Internal::valueToString(RegisterValue value, const Type* type) {
@@ -233,4 +283,8 @@ namespace stackjit {
 	void Runtime::stackOverflow() {
 		Runtime::runtimeError("Stack overflow.");
 	}
+
+	void Runtime::outOfMemoryError() {
+		Runtime::runtimeError("Out of memory.");
+	}
 }
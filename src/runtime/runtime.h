@@ -8,7 +8,9 @@ namespace stackjit {
 	class FunctionDefinition;
 	class Type;
 	class ClassType;
+	class ClassMetadata;
 	class ArrayType;
+	struct VirtualCallCache;
 
 	//Defines the interface to the runtime
 	namespace Runtime {
@@ -27,6 +29,9 @@ namespace stackjit {
 		//Returns the directory of the executing VM
 		std::string getExecutableDir();
 
+		//Gets the lowest and the highest address of the stack of the current thread. False if they can't be determined.
+		bool getThreadStackBounds(BytePtr& low, BytePtr& high);
+
 		//Prints the given stack frame
 		void printStackFrame(RegisterValue* basePtr, ManagedFunction* func);
 
@@ -45,9 +50,24 @@ namespace stackjit {
 		//Compiles the given function
 		void compileFunction(ManagedFunction* callee, int callOffset, int checkStart, int checkEnd, FunctionDefinition* funcToCall);
 
+		//Recompiles the given function with the optimizing tier
+		void tierUpFunction(ManagedFunction* function);
+
+		//Recompiles the given function with the optimizing tier when the given loop is hot.
+		//Returns the entry for on-stack replacement at the loop, or null if the baseline code continues.
+		BytePtr tierUpLoop(ManagedFunction* function, int loopHeader);
+
 		//Returns the exact address of the given virtual function
 		BytePtr getVirtualFunctionAddress(RawClassRef rawClassRef, int index);
 
+		//Compiles the virtual function at the given index of the given class (if not compiled),
+		//and binds it in the virtual function table. Returns the address of the function.
+		BytePtr compileVirtualFunction(const ClassMetadata* metadata, int index);
+
+		//Returns the exact address of the virtual function called at the call site with the given inline cache,
+		//and adds the type of the object to the cache
+		BytePtr virtualCallCacheMiss(RawClassRef rawClassRef, VirtualCallCache* cache);
+
 		//Tries to collect garbage
 		void garbageCollect(RegisterValue* basePtr, ManagedFunction* func, int instructionIndex, int generation);
 
@@ -77,5 +97,8 @@ namespace stackjit {
 
 		//Signals that the call stack has run out of memory
 		void stackOverflow();
+
+		//Signals that the heap has run out of memory
+		void outOfMemoryError();
 	}
 }
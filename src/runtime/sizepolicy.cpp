@@ -0,0 +1,97 @@
+#include "sizepolicy.h"
+#include <algorithm>
+
+namespace stackjit {
+	namespace {
+		//The part of the young generation (in percent) that the alive young objects should take at most
+		const std::size_t MAX_SURVIVOR_PERCENT = 25;
+
+		//The survival rate (in percent) below which the young generation grows faster
+		const std::size_t LOW_SURVIVAL_PERCENT = 10;
+
+		//The maximum number of collections that an object survives before it is promoted
+		const int MAX_PROMOTION_AGE = 15;
+
+		//The size of the young generation is a multiple of this
+		const std::size_t SIZE_ALIGNMENT = 4096;
+
+		//A shrink reduces the pause when the pause decreases by at least this part (in percent) of the decrease in size
+		const std::size_t MIN_PAUSE_REDUCTION_PERCENT = 50;
+	}
+
+	AdaptiveSizePolicy::AdaptiveSizePolicy(std::size_t minYoungSize, std::size_t maxYoungSize, double pauseTarget, int promotionAge)
+		: mMinYoungSize(std::min(minYoungSize, maxYoungSize)),
+		  mMaxYoungSize(maxYoungSize),
+		  mPauseTarget(pauseTarget),
+		  mYoungSize(maxYoungSize),
+		  mPromotionAge(promotionAge),
+		  mSizeBeforeShrink(0),
+		  mPauseBeforeShrink(0),
+		  mShrinkReducesPause(true) {
+
+	}
+
+	std::size_t AdaptiveSizePolicy::youngSize() const {
+		return mYoungSize;
+	}
+
+	int AdaptiveSizePolicy::promotionAge() const {
+		return mPromotionAge;
+	}
+
+	void AdaptiveSizePolicy::youngCollected(std::size_t allocatedBytes, std::size_t survivedBytes, std::size_t promotedBytes, double pauseTime) {
+		if (allocatedBytes == 0) {
+			return;
+		}
+
+		//The alive young objects take space from the allocations, and are moved by every collection
+		auto maxSurvivedBytes = mYoungSize * MAX_SURVIVOR_PERCENT / 100;
+		if (survivedBytes > maxSurvivedBytes) {
+			//In a shrunk generation, the alive objects take a larger part of it without there being more of them
+			if (mYoungSize >= mMaxYoungSize) {
+				mPromotionAge = std::max(mPromotionAge - 1, 1);
+			}
+		} else if (survivedBytes < maxSurvivedBytes / 2 && promotedBytes > 0) {
+			//Objects that are kept for more collections have more time to die before they fill the old generation
+			mPromotionAge = std::min(mPromotionAge + 1, MAX_PROMOTION_AGE);
+		}
+
+		auto youngSize = mYoungSize;
+		if (pauseTime > mPauseTarget) {
+			if (mSizeBeforeShrink > 0) {
+				auto sizeReduction = (double)(mSizeBeforeShrink - mYoungSize) / mSizeBeforeShrink;
+				auto pauseReduction = (mPauseBeforeShrink - pauseTime) / mPauseBeforeShrink;
+				mShrinkReducesPause = pauseReduction * 100 >= sizeReduction * MIN_PAUSE_REDUCTION_PERCENT;
+			}
+
+			if (mShrinkReducesPause) {
+				youngSize = youngSize / 4 * 3;
+			} else if (mSizeBeforeShrink > 0) {
+				//Most of the pause is a fixed cost, such as scanning the dirty cards, which a smaller generation
+				//only pays more often. The shrink is undone, and not tried again until a pause is within the target.
+				youngSize = mSizeBeforeShrink;
+			}
+		} else if (pauseTime < mPauseTarget / 2) {
+			//The cost of a collection depends on the alive objects, not on the size of the generation.
+			//When few objects survive, fewer collections of a larger generation are cheaper.
+			auto survivalPercent = (survivedBytes + promotedBytes) * 100 / allocatedBytes;
+			youngSize = survivalPercent < LOW_SURVIVAL_PERCENT ? youngSize * 2 : youngSize / 4 * 5;
+		}
+
+		if (pauseTime <= mPauseTarget) {
+			mShrinkReducesPause = true;
+		}
+
+		youngSize = youngSize / SIZE_ALIGNMENT * SIZE_ALIGNMENT;
+		youngSize = std::max(mMinYoungSize, std::min(youngSize, mMaxYoungSize));
+
+		if (youngSize < mYoungSize) {
+			mSizeBeforeShrink = mYoungSize;
+			mPauseBeforeShrink = pauseTime;
+		} else {
+			mSizeBeforeShrink = 0;
+		}
+
+		mYoungSize = youngSize;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+
+namespace stackjit {
+	//Adapts the size of the young generation, and the number of collections that objects survive before they are promoted,
+	//to the young collections made. The young generation shrinks when the collections take longer than the pause time target,
+	//as long as shrinking it reduces the pauses, and grows when they are well within it. Objects are promoted earlier when
+	//the alive young objects take a large part of the young generation, and later when few of them survive.
+	class AdaptiveSizePolicy {
+	private:
+		const std::size_t mMinYoungSize;
+		const std::size_t mMaxYoungSize;
+		const double mPauseTarget;
+
+		std::size_t mYoungSize;
+		int mPromotionAge;
+
+		//The size and the pause time before the last shrink, where the size is zero if the last collection didn't shrink
+		std::size_t mSizeBeforeShrink;
+		double mPauseBeforeShrink;
+
+		//Indicates if shrinking reduces the pauses. Reset when the pauses are within the target.
+		bool mShrinkReducesPause;
+	public:
+		//Creates a new policy for a young generation between the given sizes, which starts at the maximum size.
+		//The pause time target is in milliseconds.
+		AdaptiveSizePolicy(std::size_t minYoungSize, std::size_t maxYoungSize, double pauseTarget, int promotionAge);
+
+		//Returns the number of bytes allocated in the young generation between two collections
+		std::size_t youngSize() const;
+
+		//Returns the number of collections that an object survives before it is promoted
+		int promotionAge() const;
+
+		//Adapts the policy to a collection of the young generation. The survived bytes are the alive objects that
+		//were kept in the young generation, and the pause time is in milliseconds.
+		void youngCollected(std::size_t allocatedBytes, std::size_t survivedBytes, std::size_t promotedBytes, double pauseTime);
+	};
+}
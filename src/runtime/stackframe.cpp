@@ -1,6 +1,7 @@
 #include "stackframe.h"
 #include "../core/function.h"
 #include "runtime.h"
+#include <stdexcept>
 
 namespace stackjit {
 	//Stack frame entry
@@ -10,6 +11,10 @@ namespace stackjit {
 	}
 
 	RegisterValue StackFrameEntry::value() const {
+		if (mValue == nullptr) {
+			return 0;
+		}
+
 		return *mValue;
 	}
 
@@ -25,7 +30,8 @@ namespace stackjit {
 	StackFrame::StackFrame(RegisterValue* basePtr, const ManagedFunction* function, const int instructionIndex)
 		: mBasePtr(basePtr),
 		  mFunction(function),
-		  mInstructionIndex(instructionIndex) {
+		  mInstructionIndex(instructionIndex),
+		  mSafepoint(function->stackMap().getSafepoint(instructionIndex)) {
 	}
 
 	RegisterValue* StackFrame::basePtr() const {
@@ -40,26 +46,82 @@ namespace stackjit {
 		return mInstructionIndex;
 	}
 
+	const Safepoint* StackFrame::safepoint() const {
+		return mSafepoint;
+	}
+
+	std::vector<const InlinedFunction*> StackFrame::inlinedFunctions() const {
+		std::vector<const InlinedFunction*> inlinedFunctions;
+
+		for (auto& inlinedFunction : mFunction->inlinedFunctions()) {
+			if (inlinedFunction.contains(mInstructionIndex)) {
+				inlinedFunctions.push_back(&inlinedFunction);
+			}
+		}
+
+		return inlinedFunctions;
+	}
+
+	void StackFrame::setRegisterLocations(std::vector<RegisterValue*> registerLocations) {
+		mRegisterLocations = registerLocations;
+	}
+
+	RegisterValue* StackFrame::getRegisterSaveSlot(int registerIndex) const {
+		return mBasePtr + mFunction->registerSaveSlotOffset(registerIndex) / (int)sizeof(RegisterValue);
+	}
+
+	StackFrameEntry StackFrame::getVariable(RegisterValue* variablePtr,
+											const VariableRegister& variableRegister,
+											const Type* type) const {
+		if (!variableRegister.isAllocated()) {
+			return StackFrameEntry(variablePtr, type);
+		}
+
+		//The register may be used by another variable
+		if (!variableRegister.isLive(mInstructionIndex)) {
+			return StackFrameEntry(nullptr, type);
+		}
+
+		if (mRegisterLocations.empty()) {
+			return StackFrameEntry(variablePtr, type);
+		}
+
+		return StackFrameEntry(mRegisterLocations[variableRegister.registerIndex], type);
+	}
+
 	const std::vector<const Type*>& StackFrame::operandTypes() const {
 		return mFunction->instructions()[mInstructionIndex].operandTypes();
 	}
 
 	StackFrameEntry StackFrame::getArgument(std::size_t index) const {
 		RegisterValue* argsStart = mBasePtr - 1;
-		return StackFrameEntry(argsStart - index, mFunction->def().parameters()[index]);
+		return getVariable(argsStart - index, mFunction->getArgumentRegister(index), mFunction->def().parameters()[index]);
 	}
 
 	StackFrameEntry StackFrame::getLocal(std::size_t index) const {
 		RegisterValue* localsStart = mBasePtr - 1 - mFunction->def().numParameters();
-		return StackFrameEntry(localsStart - index, mFunction->getLocal(index));
+		return getVariable(localsStart - index, mFunction->getLocalRegister(index), mFunction->getLocal(index));
 	}
 
 	StackFrameEntry StackFrame::getStackOperand(std::size_t index) const {
+		const Type* type = nullptr;
+		if (index < operandTypes().size()) {
+			type = operandTypes()[operandTypes().size() - 1 - index];
+		}
+
+		return StackFrameEntry(getStackOperandPtr(index), type);
+	}
+
+	RegisterValue* StackFrame::getStackOperandPtr(std::size_t index) const {
 		RegisterValue* stackStart = mBasePtr - 1 - mFunction->def().numParameters() - mFunction->numLocals();
-		return StackFrameEntry(stackStart - index, operandTypes()[operandTypes().size() - 1 - index]);
+		return stackStart - index;
 	}
 
 	std::size_t StackFrame::operandStackSize() const {
+		if (mSafepoint != nullptr) {
+			return mSafepoint->operandStackSize;
+		}
+
 		return operandTypes().size();
 	}
 
@@ -69,49 +131,59 @@ namespace stackjit {
 
 	}
 
-	RegisterValue* StackWalker::findBasePtr(RegisterValue* currentBasePtr, int currentIndex, int targetIndex) {
-		if (currentBasePtr == nullptr) {
-			return nullptr;
+	void StackWalker::visitReference(RegisterValue* referencePtr, VisitReferenceFn fn) {
+		//Don't visit nulls, or variables that are not live
+		if (referencePtr == nullptr || *referencePtr == 0) {
+			return;
 		}
 
-		if (currentIndex == targetIndex) {
-			return (RegisterValue*)*currentBasePtr;
-		}
-
-		return findBasePtr((RegisterValue*)*currentBasePtr, currentIndex + 1, targetIndex);
+		fn(referencePtr);
 	}
 
-	void StackWalker::visitReference(StackFrameEntry frameEntry, VisitReferenceFn fn) {
-		if (frameEntry.type()->isReference()) {
-			auto objPtr = (BytePtr)frameEntry.value();
-
-			//Don't visit nulls
-			if (objPtr == nullptr) {
-				return;
-			}
-
-			fn(frameEntry);
+	void StackWalker::visitReferencesInFrame(const StackFrame& stackFrame, VisitReferenceFn fn) {
+		auto safepoint = stackFrame.safepoint();
+		if (safepoint == nullptr) {
+			throw std::runtime_error("The stack frame is not at a safepoint.");
 		}
-	}
 
-	void StackWalker::visitReferencesInFrame(const StackFrame& stackFrame, VisitReferenceFn fn) {
+		auto& stackMap = stackFrame.function()->stackMap();
 		auto numArgs = stackFrame.function()->def().numParameters();
 		auto numLocals = stackFrame.function()->numLocals();
-		auto stackSize = stackFrame.operandStackSize();
+		auto stackSize = safepoint->operandStackSize;
 
 		for (std::size_t i = 0; i < numArgs; i++) {
-			auto arg = stackFrame.getArgument(i);
-			visitReference(arg, fn);
+			if (stackMap.isReference(*safepoint, i)) {
+				visitReference(stackFrame.getArgument(i).valuePtr(), fn);
+			}
 		}
 
 		for (std::size_t i = 0; i < numLocals; i++) {
-			auto local = stackFrame.getLocal(i);
-			visitReference(local, fn);
+			if (stackMap.isReference(*safepoint, numArgs + i)) {
+				visitReference(stackFrame.getLocal(i).valuePtr(), fn);
+			}
 		}
 
 		for (std::size_t i = 0; i < stackSize; i++) {
-			auto operand = stackFrame.getStackOperand(i);
-			visitReference(operand, fn);
+			if (stackMap.isReference(*safepoint, numArgs + numLocals + i)) {
+				visitReference(stackFrame.getStackOperandPtr(i), fn);
+			}
+		}
+	}
+
+	void StackWalker::updateRegisterLocations(const StackFrame& stackFrame,
+											  std::vector<RegisterValue*>& registerLocations,
+											  bool isTopFrame) {
+		auto function = stackFrame.function();
+		if (!function->hasRegisterSaveArea()) {
+			return;
+		}
+
+		//The values of the registers used by the function are saved at entry, and the top frame stores all the
+		//other registers at the GC call.
+		for (int i = 0; i < ManagedFunction::NUM_VARIABLE_REGISTERS; i++) {
+			if (isTopFrame || function->usesRegister(i)) {
+				registerLocations[i] = stackFrame.getRegisterSaveSlot(i);
+			}
 		}
 	}
 
@@ -123,24 +195,30 @@ namespace stackjit {
 		//Visit the calling stack frame
 		visitReferencesInFrame(stackFrame, fn);
 
-		//Then all other stack frames
-		auto topEntryPtr = mVMState.engine().callStack().top();
-		int topFuncIndex = 0;
-		while (topEntryPtr > mVMState.engine().callStack().start()) {
-			auto callEntry = *topEntryPtr;
-			auto topFunc = callEntry.function;
-			auto callPoint = callEntry.callPoint;
-			auto callBasePtr = findBasePtr(stackFrame.basePtr(), 0, topFuncIndex);
+		std::vector<RegisterValue*> registerLocations(ManagedFunction::NUM_VARIABLE_REGISTERS, nullptr);
+		updateRegisterLocations(stackFrame, registerLocations, true);
+
+		//Then all other stack frames, which are found by following the base pointers.
+		//The return address of a frame identifies the call site in the caller.
+		auto& callStack = mVMState.engine().callStack();
+		auto basePtr = stackFrame.basePtr();
 
-			StackFrame callStackFrame(callBasePtr, topFunc, callPoint);
+		while (true) {
+			auto callSite = callStack.getCallSite((BytePtr)basePtr[1]);
+			if (callSite == nullptr) {
+				//The frame of the entry point, which was called from native code
+				break;
+			}
+
+			basePtr = (RegisterValue*)*basePtr;
+			StackFrame callStackFrame(basePtr, callSite->function, callSite->callPoint);
+			callStackFrame.setRegisterLocations(registerLocations);
 			if (frameFn) {
 				frameFn(callStackFrame);
 			}
 
 			visitReferencesInFrame(callStackFrame, fn);
-
-			topEntryPtr--;
-			topFuncIndex++;
+			updateRegisterLocations(callStackFrame, registerLocations, false);
 		}
 	}
 }
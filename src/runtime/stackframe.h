@@ -5,8 +5,11 @@
 
 namespace stackjit {
 	class ManagedFunction;
+	struct VariableRegister;
+	struct InlinedFunction;
 	class Type;
 	class VMState;
+	struct Safepoint;
 
 	//Represents a stack frame entry (argument, local, operand)
 	class StackFrameEntry {
@@ -14,7 +17,7 @@ namespace stackjit {
 		RegisterValue* mValue;
 		const Type* mType;
 	public:
-		//Creates a new stack frame entry
+		//Creates a new stack frame entry. The value is null if the entry has no location (not live).
 		StackFrameEntry(RegisterValue* value, const Type* type);
 
 		//Returns the value of the entry
@@ -33,9 +36,14 @@ namespace stackjit {
 		RegisterValue* mBasePtr;
 		const ManagedFunction* mFunction;
 		const int mInstructionIndex;
+		const Safepoint* mSafepoint;
+		std::vector<RegisterValue*> mRegisterLocations;
 
 		//Returns the types of the operands for the current instruction
 		const std::vector<const Type*>& operandTypes() const;
+
+		//Returns the entry for the given variable
+		StackFrameEntry getVariable(RegisterValue* variablePtr, const VariableRegister& variableRegister, const Type* type) const;
 	public:
 		//Creates a new stack frame
 		StackFrame(RegisterValue* basePtr, const ManagedFunction* function, const int instructionIndex);
@@ -49,15 +57,33 @@ namespace stackjit {
 		//Returns the index of the current instruction
 		int instructionIndex() const;
 
+		//Returns the safepoint for the current instruction, or null if the instruction is not a safepoint
+		const Safepoint* safepoint() const;
+
+		//Returns the inlined functions that the current instruction belongs to, where the outermost is first.
+		//The arguments and locals of inlined functions are locals of the frame.
+		std::vector<const InlinedFunction*> inlinedFunctions() const;
+
+		//Sets where the values of the variable registers are stored. If not set, the variables allocated
+		//to registers are assumed to have been stored in the stack frame at the current instruction.
+		void setRegisterLocations(std::vector<RegisterValue*> registerLocations);
+
+		//Returns a pointer to the save slot for the given register
+		RegisterValue* getRegisterSaveSlot(int registerIndex) const;
+
 		//Returns the given function argument
 		StackFrameEntry getArgument(std::size_t index) const;
 
 		//Returns the given local
 		StackFrameEntry getLocal(std::size_t index) const;
 
-		//Returns the given operand
+		//Returns the given operand, where the first operand is the bottom of the stack.
+		//The type is only available if the operand types of the function have not been freed.
 		StackFrameEntry getStackOperand(std::size_t index) const;
 
+		//Returns a pointer to the given operand
+		RegisterValue* getStackOperandPtr(std::size_t index) const;
+
 		//Returns the size of the operand stack at the current instruction
 		std::size_t operandStackSize() const;
 	};
@@ -65,19 +91,19 @@ namespace stackjit {
 	//Represents a stack walker
 	class StackWalker {
 	public:
-		using VisitReferenceFn = std::function<void (StackFrameEntry)>;
+		using VisitReferenceFn = std::function<void (RegisterValue* referencePtr)>;
 		using VisitFrameFn = std::function<void (const StackFrame& stackFrame)>;
 	private:
 		VMState& mVMState;
 
-		//Finds the base ptr for the function at the given index
-		RegisterValue* findBasePtr(RegisterValue* currentBasePtr, int currentIndex, int targetIndex);
+		//Visits the given reference if it is not null
+		void visitReference(RegisterValue* referencePtr, VisitReferenceFn fn);
 
-		//Visits the given frame entry if reference
-		void visitReference(StackFrameEntry frameEntry, VisitReferenceFn fn);
-
-		//Visits all the references in the given stack frame
+		//Visits all the references in the given stack frame, which are given by the stack map of the function
 		void visitReferencesInFrame(const StackFrame& stackFrame, VisitReferenceFn fn);
+
+		//Updates where the values of the variable registers are stored for the caller of the given frame
+		void updateRegisterLocations(const StackFrame& stackFrame, std::vector<RegisterValue*>& registerLocations, bool isTopFrame);
 	public:
 		//Creates a new stack walker
 		StackWalker(VMState& vmState);
@@ -16,6 +16,52 @@ struct OptionsResult {
 	std::vector<std::string> libraries;
 };
 
+//Parses the given size in the given unit for the given option, and returns it in bytes. Negative numbers are rejected,
+//as they would wrap around to huge sizes.
+std::size_t parseSize(const std::string& option, const std::string& value, const std::string& unitName, std::size_t unitSize) {
+	int size = -1;
+	try {
+		size = std::stoi(value);
+	} catch (std::logic_error&) {
+
+	}
+
+	if (size < 0) {
+		throw std::runtime_error("Expected a valid, non-negative number of " + unitName + " after the '" + option + "' option.");
+	}
+
+	return (std::size_t)size * unitSize;
+}
+
+//Parses the given number of MB for the given option, and returns it in bytes
+std::size_t parseMegabytes(const std::string& option, const std::string& value) {
+	return parseSize(option, value, "MB", 1024 * 1024);
+}
+
+//Parses the given number of KB for the given option, and returns it in bytes
+std::size_t parseKilobytes(const std::string& option, const std::string& value) {
+	return parseSize(option, value, "KB", 1024);
+}
+
+//Parses the given number for the given option. Numbers less than the given minimum are rejected.
+int parseNumber(const std::string& option, const std::string& value, int minValue) {
+	bool isValid = false;
+	int number = 0;
+	try {
+		number = std::stoi(value);
+		isValid = number >= minValue;
+	} catch (std::logic_error&) {
+
+	}
+
+	if (!isValid) {
+		std::string expected = minValue > 0 ? "positive" : "non-negative";
+		throw std::runtime_error("Expected a valid, " + expected + " number after the '" + option + "' option.");
+	}
+
+	return number;
+}
+
 //Parses the options
 OptionsResult handleOptions(int argc, char* argv[]) {
 	bool isFile = false;
@@ -57,6 +103,114 @@ OptionsResult handleOptions(int argc, char* argv[]) {
 			continue;
 		}
 
+		if (switchStr == "-cgc" || switchStr == "--copying-gc") {
+			result.config.copyingYoungCollector = true;
+			continue;
+		}
+
+		if (switchStr == "-cm" || switchStr == "--concurrent-marking") {
+			result.config.concurrentOldMarking = true;
+			continue;
+		}
+
+		if (switchStr == "-nsc" || switchStr == "--no-stack-cache") {
+			result.config.cacheOperandStack = false;
+			continue;
+		}
+
+		if (switchStr == "-nic" || switchStr == "--no-inline-cache") {
+			result.config.cacheVirtualCalls = false;
+			continue;
+		}
+
+		if (switchStr == "-ra" || switchStr == "--register-allocation") {
+			result.config.allocateRegisters = true;
+			continue;
+		}
+
+		if (switchStr == "-jt" || switchStr == "--jit-tier") {
+			int next = i + 1;
+
+			if (next < argc) {
+				std::string tier = argv[next];
+				i++;
+
+				if (tier == "baseline") {
+					result.config.jitTier = JitTier::Baseline;
+				} else if (tier == "opt") {
+					result.config.jitTier = JitTier::Optimizing;
+				} else {
+					std::cout << "'" << tier << "' is not a valid JIT tier." << std::endl;
+				}
+			} else {
+				std::cout << "Expected a tier after the '" << switchStr << "' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "-tc" || switchStr == "--tiered-compilation") {
+			result.config.tieredCompilation = true;
+			continue;
+		}
+
+		if (switchStr == "--tier-up-invocations") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.tierUpInvocations = parseNumber(switchStr, argv[next], 0);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--tier-up-invocations' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--tier-up-backedges") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.tierUpBackedges = parseNumber(switchStr, argv[next], 0);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--tier-up-backedges' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "-inl" || switchStr == "--inline") {
+			result.config.inlineFunctions = true;
+			continue;
+		}
+
+		if (switchStr == "--inline-max-size") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.inlineMaxSize = parseNumber(switchStr, argv[next], 0);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--inline-max-size' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--inline-max-depth") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.inlineMaxDepth = parseNumber(switchStr, argv[next], 0);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--inline-max-depth' option." << std::endl;
+			}
+
+			continue;
+		}
+
 		if (switchStr == "-t" || switchStr == "--test") {
 			result.config.testMode = true;
 			continue;
@@ -77,7 +231,7 @@ OptionsResult handleOptions(int argc, char* argv[]) {
 			int next = i + 1;
 
 			if (next < argc) {
-				result.config.allocationsBeforeGC = std::stoi(argv[next]);
+				result.config.allocationsBeforeGC = parseNumber(switchStr, argv[next], 0);
 				i++;
 			} else {
 				std::cout << "Expected an number after the '--allocs-before-gc' option." << std::endl;
@@ -86,6 +240,99 @@ OptionsResult handleOptions(int argc, char* argv[]) {
 			continue;
 		}
 
+		if (switchStr == "--no-adaptive-gc") {
+			result.config.adaptiveGC = false;
+			continue;
+		}
+
+		if (switchStr == "--young-size") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.youngGenerationSize = parseMegabytes(switchStr, argv[next]);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--young-size' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--old-size") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.oldGenerationSize = parseMegabytes(switchStr, argv[next]);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--old-size' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--max-heap") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.maxHeapSize = parseMegabytes(switchStr, argv[next]);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--max-heap' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--large-object-size") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.largeObjectSize = parseKilobytes(switchStr, argv[next]);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--large-object-size' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "-rgc" || switchStr == "--region-gc") {
+			result.config.regionOldGeneration = true;
+			continue;
+		}
+
+		if (switchStr == "-msgc" || switchStr == "--mark-sweep-gc") {
+			result.config.sweepOldGeneration = true;
+			continue;
+		}
+
+		if (switchStr == "--gc-pause-target") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.gcPauseTarget = parseNumber(switchStr, argv[next], 0);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--gc-pause-target' option." << std::endl;
+			}
+
+			continue;
+		}
+
+		if (switchStr == "--gc-threads") {
+			int next = i + 1;
+
+			if (next < argc) {
+				result.config.gcThreads = parseNumber(switchStr, argv[next], 1);
+				i++;
+			} else {
+				std::cout << "Expected an number after the '--gc-threads' option." << std::endl;
+			}
+
+			continue;
+		}
+
 		if (switchStr == "-psf" || switchStr == "--print-stack-frame") {
 			result.config.printStackFrame = true;
 			continue;
@@ -101,6 +348,11 @@ OptionsResult handleOptions(int argc, char* argv[]) {
 			continue;
 		}
 
+		if (switchStr == "--print-tier-up") {
+			result.config.printTierUp = true;
+			continue;
+		}
+
 		if (switchStr == "--print-gc-period") {
 			result.config.printGCPeriod = true;
 			continue;
@@ -241,6 +493,8 @@ int main(int argc, char* argv[]) {
 			std::cout << "Program output:" << std::endl;
 		}
 
+		//The stack limit is taken from the thread that runs the program
+		engine.callStack().enterThread();
 		auto programPtr = engine.entryPoint();
 
 		start = std::chrono::high_resolution_clock::now();
@@ -78,6 +78,10 @@ namespace stackjit {
 		return mFields;
 	}
 
+	const std::vector<std::size_t>& ClassMetadata::referenceFieldOffsets() const {
+		return mReferenceFieldOffsets;
+	}
+
 	bool ClassMetadata::fieldExists(const std::string& name) const {
 		return mFields.count(name) > 0;
 	}
@@ -92,6 +96,10 @@ namespace stackjit {
 		}
 
 		mFields.insert({ name, field });
+
+		if (field.type()->isReference()) {
+			mReferenceFieldOffsets.push_back(field.offset());
+		}
 	}
 
 	void ClassMetadata::makeFields() {
@@ -184,13 +192,13 @@ namespace stackjit {
 			if (mParentClass != nullptr) {
 				mParentClass->metadata()->makeVirtualFunctionTable();
 
-				//Add the parent class virtual functions
+				//Add the parent class virtual functions, which are bound to the functions that the parent class uses
 				for (auto& virtualFunc : mParentClass->metadata()->mIndexToVirtualFunction) {
 					auto name = virtualFunc.second;
 					auto index = virtualFunc.first;
 					mIndexToVirtualFunction.insert({ index, name });
 					mVirtualFunctionToIndex.insert({ name, index });
-					virtualFuncMapping[name] = name;
+					virtualFuncMapping[name] = mParentClass->metadata()->mVirtualFunctionMapping[index];
 					virtualFuncIndex = std::max(virtualFuncIndex, index);
 					hasParentVirtual = true;
 				}
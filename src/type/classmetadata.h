@@ -74,6 +74,7 @@ namespace stackjit {
 
 		std::vector<FieldDefinition> mFieldDefinitions;
 		std::unordered_map<std::string, Field> mFields;
+		std::vector<std::size_t> mReferenceFieldOffsets;
 
 		std::vector<const FunctionDefinition*> mVirtualFunctions;
 		std::unordered_map<std::string, int> mVirtualFunctionToIndex;
@@ -114,6 +115,9 @@ namespace stackjit {
 		//Returns the fields
 		const std::unordered_map<std::string, Field>& fields() const;
 
+		//Returns the offsets of the fields that are references, in increasing order. Used by the GC to trace objects.
+		const std::vector<std::size_t>& referenceFieldOffsets() const;
+
 		//Indicates if a field with the given name exits
 		bool fieldExists(const std::string& name) const;
 
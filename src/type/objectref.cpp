@@ -1,4 +1,5 @@
 #include "objectref.h"
+#include <atomic>
 
 namespace stackjit {
 	//Object ref
@@ -48,6 +49,11 @@ namespace stackjit {
 		setMarked(true);
 	}
 
+	bool ObjectRef::tryMark() {
+		auto gcInfo = reinterpret_cast<std::atomic<unsigned char>*>(mPtr + sizeof(PtrValue));
+		return (gcInfo->fetch_or(0x1) & 0x1) == 0;
+	}
+
 	void ObjectRef::unmark() {
 		setMarked(false);
 	}
@@ -56,6 +56,10 @@ namespace stackjit {
 		//Marks the current object
 		void mark();
 
+		//Marks the current object unless already marked. Returns true if marked by this call.
+		//Safe to call from multiple threads at the same time.
+		bool tryMark();
+
 		//Unmarks the current object
 		void unmark();
 
@@ -99,7 +99,7 @@ namespace stackjit {
 
 	//Class type
 	ClassType::ClassType(std::string name, ClassMetadata* metadata)
-		: ReferenceType(name), mClassName(name), mMetadata(metadata) {
+		: ReferenceType(name), mClassName(name), mMetadata(metadata), mVirtualFunctionTable(metadata->virtualFunctionTable()) {
 
 	}
 
@@ -111,6 +111,18 @@ namespace stackjit {
 		return mMetadata;
 	}
 
+	BytePtr* ClassType::virtualFunctionTable() const {
+		return mVirtualFunctionTable;
+	}
+
+	int ClassType::virtualFunctionTableOffset() const {
+		return (int)((const unsigned char*)&mVirtualFunctionTable - (const unsigned char*)this);
+	}
+
+	void ClassType::bindVirtualFunctionTable() {
+		mVirtualFunctionTable = mMetadata->virtualFunctionTable();
+	}
+
 	bool ClassType::isArray() const {
 		return false;
 	}
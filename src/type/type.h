@@ -2,6 +2,7 @@
 #include <string>
 #include <functional>
 #include "classmetadata.h"
+#include "../stackjit.h"
 
 namespace stackjit {
 	class ClassMetadata;
@@ -94,6 +95,7 @@ namespace stackjit {
 	private:
 		const std::string mClassName;
 		ClassMetadata* mMetadata;
+		BytePtr* mVirtualFunctionTable;
 	public:
 		//Creates a new class type
 		ClassType(std::string name, ClassMetadata* metadata);
@@ -104,6 +106,16 @@ namespace stackjit {
 		//Returns the metadata for the class
 		ClassMetadata* metadata() const;
 
+		//Returns the virtual function table of the class, which is null until the table has been created
+		BytePtr* virtualFunctionTable() const;
+
+		//Returns the offset of the pointer to the virtual function table in the type. Used by the generated code for
+		//virtual calls, which saves a load compared to going through the metadata.
+		int virtualFunctionTableOffset() const;
+
+		//Takes the virtual function table from the metadata, after it has been created
+		void bindVirtualFunctionTable();
+
 		virtual bool isArray() const override;
 		virtual bool isClass() const override;
 	};
@@ -122,7 +122,9 @@ namespace stackjit {
 					}
 
 					if (mClassProvider.isDefined(className)) {
-						type = new ClassType(className, &mClassProvider.getMetadata(className));
+						auto classType = new ClassType(className, &mClassProvider.getMetadata(className));
+						mClassTypes.push_back(classType);
+						type = classType;
 					}
 				}
 			}
@@ -142,4 +144,10 @@ namespace stackjit {
 	        return nullptr;
 	    }
 	}
+
+	void TypeProvider::bindVirtualFunctionTables() {
+		for (auto classType : mClassTypes) {
+			classType->bindVirtualFunctionTable();
+		}
+	}
 }
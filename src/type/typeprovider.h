@@ -1,15 +1,18 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace stackjit {
 	class Type;
+	class ClassType;
 	class ClassMetadataProvider;
 
 	//Provides types
 	class TypeProvider {
 	private:
 		std::unordered_map<std::string, const Type*> mTypes;
+		std::vector<ClassType*> mClassTypes;
 		ClassMetadataProvider& mClassProvider;
 	public:
 		//Creates a new type provider
@@ -24,5 +27,8 @@ namespace stackjit {
 
 	    //Returns the given type. Nullptr if not found.
 	    const Type* getType(std::string name) const;
+
+		//Binds the virtual function tables of the created class types. Called after the tables have been created.
+		void bindVirtualFunctionTables();
 	};
 }
@@ -36,8 +36,74 @@ namespace stackjit {
 		//Indicates if the functions are lazily compiled
 		bool lazyJIT = true;
 
-		//The number of allocations before a GC happens
-		int allocationsBeforeGC = 1000;
+		//Indicates if the top operands of the operand stack are cached in registers
+		bool cacheOperandStack = true;
+
+		//Indicates if virtual calls use inline caches, instead of loading the function from the virtual function table
+		bool cacheVirtualCalls = true;
+
+		//Indicates if arguments and locals are allocated to registers
+		bool allocateRegisters = false;
+
+		//The tier used for compiling functions that don't specify a tier
+		JitTier jitTier = JitTier::Baseline;
+
+		//Indicates if functions start in the baseline tier and are recompiled by the optimizing tier when hot
+		bool tieredCompilation = false;
+
+		//The number of invocations before a function is recompiled by the optimizing tier
+		int tierUpInvocations = 1000;
+
+		//The number of loop iterations before a function is recompiled by the optimizing tier
+		int tierUpBackedges = 10000;
+
+		//Indicates if calls to small managed functions and constructors are inlined
+		bool inlineFunctions = false;
+
+		//The maximum number of instructions in an inlined function
+		int inlineMaxSize = 20;
+
+		//The maximum depth of inlined calls
+		int inlineMaxDepth = 3;
+
+		//The number of allocations before a GC happens. If negative, the young generation is collected when a number of bytes
+		//have been allocated in it, and the old generation when most of it is used.
+		int allocationsBeforeGC = -1;
+
+		//Indicates if the size of the young generation and the promotion age adapt to the collections, when collecting by bytes
+		bool adaptiveGC = true;
+
+		//The size of the young generation in bytes
+		std::size_t youngGenerationSize = 4 * 1024 * 1024;
+
+		//The initial size of the old generation in bytes
+		std::size_t oldGenerationSize = 8 * 1024 * 1024;
+
+		//The maximum size of the heap in bytes, which includes the young generation and the large objects.
+		//The old generation grows up to it when full.
+		std::size_t maxHeapSize = 256 * 1024 * 1024;
+
+		//Arrays without references larger than this number of bytes are allocated in memory of their own, where they are never moved.
+		//If zero, all objects are allocated in the generations.
+		std::size_t largeObjectSize = 256 * 1024;
+
+		//Indicates if the young generation is collected by copying the alive objects to another heap, instead of compacting it
+		bool copyingYoungCollector = false;
+
+		//The number of threads that mark and compact the objects in a collection
+		int gcThreads = 1;
+
+		//Indicates if the old generation is marked on a background thread while the program runs
+		bool concurrentOldMarking = false;
+
+		//Indicates if the old generation is divided into regions, where a collection evacuates the regions with the most garbage
+		bool regionOldGeneration = false;
+
+		//Indicates if the old generation is swept into free lists instead of compacted, unless it is too fragmented
+		bool sweepOldGeneration = false;
+
+		//The pause time in milliseconds that the collections aim for
+		int gcPauseTarget = 10;
 
 		//Prints the info about the stack frame
 		bool printStackFrame = false;
@@ -45,6 +111,9 @@ namespace stackjit {
 		//Prints when lazy calls are patched
 		bool printLazyPatching = false;
 
+		//Prints when a function is recompiled by the optimizing tier
+		bool printTierUp = false;
+
 		//Prints when a function has been compiled
 		bool printFunctionGeneration = false;
 
@@ -18,5 +18,17 @@ namespace stackjit {
 	bool Allocator::makeExecutable(void* memory, std::size_t size) {
 		return VirtualProtect(memory, size, PAGE_EXECUTE_READ, nullptr) == 0;
 	}
+
+	void* Allocator::reserve(std::size_t size) {
+		return VirtualAlloc(
+			nullptr,
+			size,
+			MEM_RESERVE,
+			PAGE_NOACCESS);
+	}
+
+	bool Allocator::commit(void* memory, std::size_t size) {
+		return VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+	}
 }
 #endif
@@ -1,6 +1,7 @@
 #pragma once
 #if defined(_WIN64) || defined(__MINGW32__)
 #include "../compiler/x64/amd64.h"
+#include "../compiler/x64/amd64assembler.h"
 
 namespace stackjit {
 	//The register for function arguments
@@ -21,5 +22,20 @@ namespace stackjit {
 
 		const FloatRegisters ReturnValue = FloatRegisters::XMM0;
 	}
+
+	//The registers that the operand stack can cache entries in.
+	//These are only used for passing arguments, and the cache is spilled before any call is made.
+	namespace OperandStackCacheRegisters {
+		const IntRegister Int[] = { ExtendedRegisters::R8, ExtendedRegisters::R9 };
+		const FloatRegisters Float[] = { FloatRegisters::XMM2, FloatRegisters::XMM3, FloatRegisters::XMM4, FloatRegisters::XMM5 };
+	}
+
+	//The callee saved registers that variables can be allocated to
+	const IntRegister VARIABLE_REGISTERS[] = {
+		Registers::BX,
+		ExtendedRegisters::R13,
+		ExtendedRegisters::R14,
+		ExtendedRegisters::R15
+	};
 }
 #endif
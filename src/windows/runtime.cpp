@@ -1,4 +1,5 @@
 #if defined(_WIN64) || defined(__MINGW32__)
+#include "../runtime/runtime.h"
 #include <string>
 #include <Windows.h>
 
@@ -15,6 +16,15 @@ namespace stackjit {
 			buffer[bytes - 12] = '\0';
 			return std::string(buffer);
 		}
+
+		bool getThreadStackBounds(BytePtr& low, BytePtr& high) {
+			ULONG_PTR lowLimit = 0;
+			ULONG_PTR highLimit = 0;
+			GetCurrentThreadStackLimits(&lowLimit, &highLimit);
+			low = (BytePtr)lowLimit;
+			high = (BytePtr)highLimit;
+			return true;
+		}
 	}
 }
 #endif
\ No newline at end of file
@@ -104,6 +104,30 @@ public:
         generatedCode.clear();
     }
 
+    //Tests moveRegToReg for float registers
+    void testMoveRegToRegFloat() {
+        CodeGen generatedCode;
+        Amd64Backend::moveRegToReg(generatedCode, FloatRegisters::XMM1, FloatRegisters::XMM2);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x0F, 0x28, 0xCA }));
+        generatedCode.clear();
+
+        Amd64Backend::moveRegToReg(generatedCode, FloatRegisters::XMM0, Registers::AX);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x66, 0x48, 0x0F, 0x6E, 0xC0 }));
+        generatedCode.clear();
+
+        Amd64Backend::moveRegToReg(generatedCode, FloatRegisters::XMM1, ExtendedRegisters::R8);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x66, 0x49, 0x0F, 0x6E, 0xC8 }));
+        generatedCode.clear();
+
+        Amd64Backend::moveRegToReg(generatedCode, Registers::AX, FloatRegisters::XMM1);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x66, 0x48, 0x0F, 0x7E, 0xC8 }));
+        generatedCode.clear();
+
+        Amd64Backend::moveRegToReg(generatedCode, ExtendedRegisters::R9, FloatRegisters::XMM2);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x66, 0x49, 0x0F, 0x7E, 0xD1 }));
+        generatedCode.clear();
+    }
+
     //Tests moveRegToMemory
     void testMoveRegToMemory() {
         CodeGen generatedCode;
@@ -458,6 +482,18 @@ public:
         generatedCode.clear();
     }
 
+    //Tests the jumpInReg generator
+    void testJumpInReg() {
+        CodeGen generatedCode;
+        Amd64Backend::jumpInReg(generatedCode, Registers::AX);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xFF, 0xE0 }));
+        generatedCode.clear();
+
+        Amd64Backend::jumpInReg(generatedCode, ExtendedRegisters::R11);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x41, 0xFF, 0xE3 }));
+        generatedCode.clear();
+    }
+
     //Tests the ret generator
     void testRet() {
         CodeGen generatedCode;
@@ -727,6 +763,11 @@ public:
         Amd64Backend::divRegFromReg(generatedCode, Registers::AX, Registers::BX, true);
         TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xF7, 0xFB }));
         generatedCode.clear();
+
+        //Float
+        Amd64Backend::divRegFromReg(generatedCode, FloatRegisters::XMM0, FloatRegisters::XMM1);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xF3, 0x0F, 0x5E, 0xC1 }));
+        generatedCode.clear();
     }
 
     //Tests the andRegToReg generator
@@ -861,6 +902,38 @@ public:
         generatedCode.clear();
     }
 
+    //Tests the shiftRightReg generator
+    void testShiftRightReg() {
+        CodeGen generatedCode;
+        Amd64Backend::shiftRightReg(generatedCode, Registers::AX, 10);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x48, 0xC1, 0xE8, 0x0A }));
+        generatedCode.clear();
+
+        Amd64Backend::shiftRightReg(generatedCode, Registers::CX, 1);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x48, 0xC1, 0xE9, 0x01 }));
+        generatedCode.clear();
+
+        Amd64Backend::shiftRightReg(generatedCode, ExtendedRegisters::R10, 3);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x49, 0xC1, 0xEA, 0x03 }));
+        generatedCode.clear();
+    }
+
+    //Tests the moveByteToMemoryRegWithIntOffset generator
+    void testMoveByteToMemoryRegWithIntOffset() {
+        CodeGen generatedCode;
+        Amd64Backend::moveByteToMemoryRegWithIntOffset(generatedCode, Registers::AX, 0, 1);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xC6, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01 }));
+        generatedCode.clear();
+
+        Amd64Backend::moveByteToMemoryRegWithIntOffset(generatedCode, Registers::SP, 16, 1);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xC6, 0x84, 0x24, 0x10, 0x00, 0x00, 0x00, 0x01 }));
+        generatedCode.clear();
+
+        Amd64Backend::moveByteToMemoryRegWithIntOffset(generatedCode, ExtendedRegisters::R11, -4, 2);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x41, 0xC6, 0x83, 0xFC, 0xFF, 0xFF, 0xFF, 0x02 }));
+        generatedCode.clear();
+    }
+
     //Tests the compareRegToReg generator
     void testCompareRegToReg() {
         CodeGen generatedCode;
@@ -880,4 +953,21 @@ public:
         TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0x48, 0x39, 0xC9 }));
         generatedCode.clear();
     }
+
+    //Tests the convertIntToFloat generator
+    void testConvertIntToFloat() {
+        CodeGen generatedCode;
+        Amd64Backend::convertIntToFloat(generatedCode, FloatRegisters::XMM0, Registers::AX);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xF3, 0x48, 0x0F, 0x2A, 0xC0 }));
+        generatedCode.clear();
+
+        //32 bits
+        Amd64Backend::convertIntToFloat(generatedCode, FloatRegisters::XMM1, Registers::CX, true);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xF3, 0x0F, 0x2A, 0xC9 }));
+        generatedCode.clear();
+
+        Amd64Backend::convertIntToFloat(generatedCode, FloatRegisters::XMM2, Registers::AX, true);
+        TS_ASSERT_EQUALS(generatedCode, CodeGen({ 0xF3, 0x0F, 0x2A, 0xD0 }));
+        generatedCode.clear();
+    }
 };
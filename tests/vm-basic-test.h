@@ -24,6 +24,8 @@ public:
         TS_ASSERT_EQUALS(invokeVM("basic/program13"), "4711\n13.37\n1\n0\n");
         TS_ASSERT_EQUALS(invokeVM("basic/program14"), "2\n");
         TS_ASSERT_EQUALS(invokeVM("basic/program15"), "-2\n");
+        TS_ASSERT_EQUALS(invokeVM("basic/program16"), "5.5\n4.5\n0\n");
+        TS_ASSERT_EQUALS(invokeVM("basic/program17"), "-3\n-1.5\n0\n");
 
         TS_ASSERT_EQUALS(invokeVM("basic/recursion1"), "21\n");
 		TS_ASSERT_EQUALS(invokeVM("basic/duplicate1"), "10\n");
@@ -35,6 +37,10 @@ public:
 		TS_ASSERT_EQUALS(invokeVM("stack/largestackframe1"), "55\n");
 		TS_ASSERT_EQUALS(invokeVM("stack/largestackframe2"), "0\n");
 		TS_ASSERT_EQUALS(invokeVM("stack/largestackframe3"), "0\n");
+		TS_ASSERT_EQUALS(invokeVM("stack/cached_operands1"), "36\n");
+		TS_ASSERT_EQUALS(invokeVM("stack/cached_operands2"), "151\n");
+		TS_ASSERT_EQUALS(invokeVM("stack/cached_operands1", "--no-stack-cache"), "36\n");
+		TS_ASSERT_EQUALS(invokeVM("stack/cached_operands2", "--no-stack-cache"), "151\n");
 	}
 
     void testLazy() {
@@ -46,6 +52,79 @@ public:
         TS_ASSERT_EQUALS(invokeVM("lazy/loop", "--no-rtlib -lc 1"), "0\n");
     }
 
+	void testRegisterAllocation() {
+		TS_ASSERT_EQUALS(invokeVM("basic/program8", "-ra"), "10\n9\n8\n7\n6\n5\n4\n3\n2\n1\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program11", "-ra"), "60.48\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program17", "-ra"), "-3\n-1.5\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/recursion1", "-ra"), "21\n");
+		TS_ASSERT_EQUALS(invokeVM("stack/largestackframe1", "-ra"), "55\n");
+	}
+
+	void testJitTier() {
+		TS_ASSERT_EQUALS(invokeVM("basic/jittier1"), "289\n4.25\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/jittier1", "--jit-tier baseline"), "289\n4.25\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program8", "--jit-tier opt"), "10\n9\n8\n7\n6\n5\n4\n3\n2\n1\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program11", "--jit-tier opt"), "60.48\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program17", "--jit-tier opt"), "-3\n-1.5\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/recursion1", "--jit-tier opt"), "21\n");
+		TS_ASSERT_EQUALS(invokeVM("branch/int_ge3", "--jit-tier opt"), "1\n");
+		TS_ASSERT_EQUALS(invokeVM("branch/float_le3", "--jit-tier opt"), "1\n");
+	}
+
+	void testTieredCompilation() {
+		std::string options = "--no-rtlib -tc --tier-up-invocations 2 --tier-up-backedges 3";
+		TS_ASSERT_EQUALS(invokeVM("basic/tierup1", options), "108\n109\n285\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/tierup1", options + " -lc 0"), "108\n109\n285\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/tierup1", options + " -ra"), "108\n109\n285\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/program8", options), "10\n9\n8\n7\n6\n5\n4\n3\n2\n1\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/recursion1", options), "21\n");
+	}
+
+	void testInvalidTierUpOptions() {
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("basic/program1", "--no-rtlib -tc --tier-up-invocations -1")),
+			"Expected a valid, non-negative number after the '--tier-up-invocations' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("basic/program1", "--no-rtlib -tc --tier-up-backedges -5")),
+			"Expected a valid, non-negative number after the '--tier-up-backedges' option.");
+	}
+
+	void testInlining() {
+		TS_ASSERT_EQUALS(invokeVM("basic/inline1", "-inl"), "236\n18\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/inline1", "-inl --inline-max-depth 1"), "236\n18\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/inline1", "-inl -ra --allocs-before-gc 0"), "236\n18\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/inline1", "-inl --jit-tier opt"), "236\n18\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/inline1", "-inl -tc --tier-up-invocations 2 --tier-up-backedges 3"), "236\n18\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/recursion1", "-inl"), "21\n");
+	}
+
+	void testInvalidInliningOptions() {
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("basic/inline1", "-inl --inline-max-size -1")),
+			"Expected a valid, non-negative number after the '--inline-max-size' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("basic/inline1", "-inl --inline-max-depth -2")),
+			"Expected a valid, non-negative number after the '--inline-max-depth' option.");
+	}
+
+	void testOnStackReplacement() {
+		std::string options = "--no-rtlib -tc --tier-up-backedges 3";
+		TS_ASSERT_EQUALS(invokeVM("basic/osr1", options), "10\n1020\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/osr1", options + " -ra -nsc"), "10\n1020\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/tierup1", options + " --tier-up-invocations 100"), "108\n109\n285\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/osr2", options), "108\n109\n285\n0\n");
+	}
+
+	void testTierUpKeepsResults() {
+		//The function is replaced in the middle of the inner loop, which must not change the result
+		auto expected = invokeVM("basic/osr3", "--no-rtlib --jit-tier opt");
+		TS_ASSERT_EQUALS(expected, "-2800\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("basic/osr3", "--no-rtlib"), expected);
+		TS_ASSERT_EQUALS(invokeVM("basic/osr3", "--no-rtlib -tc --tier-up-backedges 3"), expected);
+		TS_ASSERT_EQUALS(invokeVM("basic/osr3", "--no-rtlib -tc --tier-up-backedges 50"), expected);
+		TS_ASSERT_EQUALS(invokeVM("basic/osr3", "--no-rtlib -tc --tier-up-backedges 3 -ra -nsc"), expected);
+	}
+
 	void testBool() {
 		TS_ASSERT_EQUALS(invokeVM("bool/and1"), "false\n0\n");
 		TS_ASSERT_EQUALS(invokeVM("bool/and2"), "true\n0\n");
@@ -13,6 +13,7 @@ public:
 		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/nullref1")), "Error: Null reference.");
 		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/nullref2")), "Error: Null reference.");
 		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/nullref3")), "Error: Null reference.");
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/nullref4", "-inl")), "Error: Null reference.");
 	}
 
 	//Tests bounds check
@@ -29,4 +30,18 @@ public:
 	void testInvalidArrayCreation() {
 		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/invalidarraycreation")), "Error: The length of the array must be >= 0.");
 	}
+
+	//Tests stack overflow
+	void testStackOverflow() {
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/stackoverflow1")), "Error: Stack overflow.");
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/stackoverflow1", "-ra --no-rtlib")), "Error: Stack overflow.");
+	}
+
+	//Tests running out of memory
+	void testOutOfMemory() {
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/outofmemory1")), "Error: Out of memory.");
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/outofmemory2", "--max-heap 16")), "Error: Out of memory.");
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/outofmemory2", "-cgc --max-heap 16")), "Error: Out of memory.");
+		TS_ASSERT_EQUALS(stripErrorMessage(invokeVM("exception/outofmemory2", "-rgc --max-heap 16")), "Error: Out of memory.");
+	}
 };
\ No newline at end of file
@@ -241,6 +241,54 @@ public:
 		TS_ASSERT_EQUALS(gcTest.collections.at(0).deallocatedObjects.size(), 1);
 	}
 
+	//Tests that the references in old objects are updated when the young generation compacts
+	void testOldRef() {
+		TS_ASSERT_EQUALS(invokeVM("gc/compact_update_old_ref", "--allocs-before-gc 0"), "42\n0\n");
+	}
+
+	//Tests that the references in young objects are updated when the old generation compacts
+	void testYoungRef() {
+		TS_ASSERT_EQUALS(invokeVM("gc/compact_update_young_ref"), "77\n");
+	}
+
+	//Tests that the card of a reference field is marked when the field is in another card than the start of the object
+	void testCardMarkingField() {
+		TS_ASSERT_EQUALS(invokeVM("gc/card_marking_field", "--allocs-before-gc 0"), "42\n0\n");
+	}
+
+	//Tests GC with refs in registers
+	void testRegisterAllocation() {
+		TS_ASSERT_EQUALS(invokeVM("gc/register_locals1", "--allocs-before-gc 0"), "7385\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/register_locals1", "-ra --allocs-before-gc 0"), "7385\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/register_locals1", "-ra --no-stack-cache --allocs-before-gc 0"), "7385\n");
+	}
+
+	//Tests objects allocated in the generated code
+	void testInlineAllocation() {
+		TS_ASSERT_EQUALS(invokeVM("gc/inline_alloc1"), "0\n9945\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/inline_alloc1", "--allocs-before-gc 10"), "0\n9945\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/inline_alloc1", "-ra --allocs-before-gc 0"), "0\n9945\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/inline_alloc1", "-ngc"), "0\n9945\n0\n");
+	}
+
+	//Tests GC with the roots in a deep call stack, which are found by walking the frames
+	void testGCCallStack() {
+		TS_ASSERT_EQUALS(invokeVM("gc/callstack2"), "4501500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/callstack2", "-ra --allocs-before-gc 0"), "4501500\n");
+	}
+
+	//Tests marking a long linked list, which must not overflow the native stack
+	void testGCLinkedList() {
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "--no-rtlib --allocs-before-gc 10000"), "-1634976888\n");
+	}
+
+	//Tests young collections that only scan the dirty cards of the old generation
+	void testGCDirtyCards() {
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1"), "12578858\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "--no-rtlib --allocs-before-gc 100"), "12578858\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "-ra --no-rtlib --allocs-before-gc 100"), "12578858\n");
+	}
+
 	//Tests when the GC is run implicit
 	void testGCImplicit() {
 		GCTest gcTest;
@@ -264,6 +312,202 @@ public:
 		TS_ASSERT_EQUALS(gcTest.collections.at(0).hasDeallocated(gcTest.allocatedObjects.at(1)), true);
 	}
 
+	//Tests the copying collector for the young generation
+	void testCopyingCollector() {
+		GCTest gcTest;
+
+		TS_ASSERT_EQUALS(invokeVM("gc/callstack2", "-cgc --no-rtlib --allocs-before-gc 0"), "4501500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "-cgc --no-rtlib --allocs-before-gc 10000"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "-cgc --no-rtlib --allocs-before-gc 100"), "12578858\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "-cgc -ra --no-rtlib --allocs-before-gc 100"), "12578858\n");
+
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/generation2", options + " -cgc"), gcTest),
+			"0\n");
+
+		TS_ASSERT_EQUALS(gcTest.allocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.size(), 8);
+		TS_ASSERT_EQUALS(gcTest.numDeallocatedObjects(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(5).promotedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).deallocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).hasDeallocated(gcTest.collections.at(5).promotedObjects[0].second), true);
+
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/gctime", "-d --print-alloc --print-dealloc --print-gc-period --no-rtlib -cgc --allocs-before-gc 2"), gcTest),
+			"0\n");
+
+		TS_ASSERT_EQUALS(gcTest.allocatedObjects.size(), 4);
+		TS_ASSERT_EQUALS(gcTest.collections.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(0).deallocatedObjects.size(), 2);
+		TS_ASSERT_EQUALS(gcTest.collections.at(0).hasDeallocated(gcTest.allocatedObjects.at(0)), true);
+		TS_ASSERT_EQUALS(gcTest.collections.at(0).hasDeallocated(gcTest.allocatedObjects.at(1)), true);
+	}
+
+	//Tests marking and compacting with multiple GC threads
+	void testParallelCollector() {
+		GCTest gcTest;
+
+		TS_ASSERT_EQUALS(invokeVM("gc/callstack2", "--gc-threads 4 --no-rtlib --allocs-before-gc 0"), "4501500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "--gc-threads 4 --no-rtlib --allocs-before-gc 10000"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "--gc-threads 4 --no-rtlib --allocs-before-gc 100"), "12578858\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "--gc-threads 4 -cgc --no-rtlib --allocs-before-gc 100"), "12578858\n");
+
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/generation2", options + " --gc-threads 4"), gcTest),
+			"0\n");
+
+		TS_ASSERT_EQUALS(gcTest.allocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.size(), 8);
+		TS_ASSERT_EQUALS(gcTest.numDeallocatedObjects(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(5).promotedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).deallocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).hasDeallocated(gcTest.collections.at(5).promotedObjects[0].second), true);
+
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/callstack2", "--gc-threads 0 --no-rtlib")),
+			"Expected a valid, positive number after the '--gc-threads' option.");
+	}
+
+	//Tests marking the old generation concurrently with the program
+	void testConcurrentMarking() {
+		TS_ASSERT_EQUALS(invokeVM("gc/compact_update_young_ref", "--no-rtlib"), "77\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/compact_update_young_ref", "-cm --no-rtlib"), "77\n");
+
+		TS_ASSERT_EQUALS(invokeVM("gc/concurrent1", "-cm --no-rtlib"), "4498500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/concurrent1", "-cm --no-rtlib --allocs-before-gc 0"), "4498500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/concurrent1", "-cm -cgc --no-rtlib --allocs-before-gc 10"), "4498500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/concurrent1", "-cm --gc-threads 4 --no-rtlib --allocs-before-gc 10"), "4498500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/callstack2", "-cm --no-rtlib --allocs-before-gc 0"), "4501500\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "-cm --no-rtlib --allocs-before-gc 100"), "12578858\n");
+	}
+
+	//Tests the old generation divided into regions
+	void testRegionCollector() {
+		GCTest gcTest;
+
+		TS_ASSERT_EQUALS(invokeVM("gc/regions1", "--no-rtlib"), "9995000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/regions1", "-rgc --no-rtlib"), "9995000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/regions1", "-rgc --no-rtlib --allocs-before-gc 0"), "9995000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/regions1", "-rgc -cgc --no-rtlib --allocs-before-gc 10"), "9995000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/regions1", "-rgc --gc-pause-target 0 --no-rtlib --allocs-before-gc 0"), "9995000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/compact_update_young_ref", "-rgc --no-rtlib"), "77\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/cards1", "-rgc --no-rtlib --allocs-before-gc 100"), "12578858\n");
+
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/generation2", options + " -rgc"), gcTest),
+			"0\n");
+
+		TS_ASSERT_EQUALS(gcTest.allocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.size(), 8);
+		TS_ASSERT_EQUALS(gcTest.numDeallocatedObjects(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(5).promotedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).deallocatedObjects.size(), 1);
+		TS_ASSERT_EQUALS(gcTest.collections.at(7).hasDeallocated(gcTest.collections.at(5).promotedObjects[0].second), true);
+	}
+
+	//Tests growing the old generation when full
+	void testGrowHeap() {
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "--young-size 1 --old-size 1 --no-rtlib --allocs-before-gc 0"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "-cgc --young-size 1 --old-size 1 --no-rtlib --allocs-before-gc 0"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "-rgc --young-size 1 --old-size 1 --no-rtlib --allocs-before-gc 0"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "-cm --young-size 1 --old-size 1 --no-rtlib --allocs-before-gc 0"), "-1634976888\n");
+
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array1", "--no-rtlib"), "6000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array1", "--no-rtlib --allocs-before-gc 0"), "6000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array1", "-cgc --no-rtlib --allocs-before-gc 0"), "6000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array1", "-rgc --old-size 1 --no-rtlib --allocs-before-gc 0"), "6000000\n");
+	}
+
+	//Tests invalid sizes of the heap
+	void testInvalidHeapSizes() {
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--young-size -1 --no-rtlib")),
+			"Expected a valid, non-negative number of MB after the '--young-size' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--max-heap -1 --no-rtlib")),
+			"Expected a valid, non-negative number of MB after the '--max-heap' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--old-size 0 --no-rtlib")),
+			"The sizes of the generations must be non-zero multiples of 256 KB.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--old-size 2048 --max-heap 4096 --no-rtlib")),
+			"The sizes of the generations must be less than 2 GB.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--large-object-size -1 --no-rtlib")),
+			"Expected a valid, non-negative number of KB after the '--large-object-size' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/linked_list1", "--large-object-size 4294967296 --no-rtlib")),
+			"Expected a valid, non-negative number of KB after the '--large-object-size' option.");
+	}
+
+	//Tests triggering the collections by the allocated bytes
+	void testByteTriggering() {
+		GCTest gcTest;
+
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/small_objects1", "-d --print-gc-period --no-rtlib"), gcTest),
+			"-1474936480\n");
+		TS_ASSERT_EQUALS(gcTest.collections.size(), 0);
+
+		GCTest countGCTest;
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/small_objects1", "-d --print-gc-period --no-rtlib --allocs-before-gc 1000"), countGCTest),
+			"-1474936480\n");
+		TS_ASSERT_EQUALS(countGCTest.collections.size(), 199);
+
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "--young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "--young-size 1 --max-heap 16 --no-rtlib --no-adaptive-gc"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-cgc --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-rgc --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-cm --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/small_objects1", "--allocs-before-gc -1 --no-rtlib")),
+			"Expected a valid, non-negative number after the '--allocs-before-gc' option.");
+		TS_ASSERT_EQUALS(
+			stripErrorMessage(invokeVM("gc/small_objects1", "--gc-pause-target -10 --no-rtlib")),
+			"Expected a valid, non-negative number after the '--gc-pause-target' option.");
+	}
+
+	//Tests that the young generation keeps its size when shrinking it doesn't reduce the pauses, where most of the pause
+	//is scanning the dirty cards of a large old array. The pause target is zero, so every pause is too long.
+	void testAdaptiveSizeWithDirtyCards() {
+		GCTest gcTest;
+		TS_ASSERT_EQUALS(
+			parseGCData(invokeVM("gc/cards2", "-d --print-gc-period --no-rtlib --gc-pause-target 0"), gcTest),
+			"400000\n");
+
+		//The young generation of 4 MB is collected 20 times, but more than 300 times at the minimum size
+		TS_ASSERT_EQUALS(gcTest.collections.size() < 40, true);
+	}
+
+	//Tests the large object space
+	void testLargeObjects() {
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "--max-heap 24 --no-rtlib"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "--max-heap 24 --no-rtlib --gc-threads 4"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "-rgc --max-heap 24 --no-rtlib"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "-cgc --max-heap 28 --no-rtlib"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "-cm --max-heap 48 --no-rtlib"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "-cm --max-heap 24 --no-rtlib"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "--max-heap 24 --no-rtlib --allocs-before-gc 10"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "--max-heap 24 --no-rtlib --allocs-before-gc 1000000"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "--max-heap 24 --no-rtlib --large-object-size 0"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array1", "--max-heap 32 --no-rtlib --large-object-size 64"), "6000000\n");
+	}
+
+	//Tests the mark-sweep old generation
+	void testMarkSweep() {
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-msgc --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-msgc -cgc --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-msgc -cm --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/old_garbage1", "-msgc --gc-threads 4 --young-size 1 --max-heap 16 --no-rtlib"), "2000000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/linked_list1", "-msgc --young-size 1 --no-rtlib"), "-1634976888\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/fragmentation1", "-msgc --young-size 1 --max-heap 16 --no-rtlib"), "1950000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/large_array2", "-msgc --max-heap 24 --no-rtlib --allocs-before-gc 10"), "787\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/fragmentation2", "-msgc --young-size 1 --no-rtlib"), "175000\n");
+		TS_ASSERT_EQUALS(invokeVM("gc/fragmentation2", "-msgc -cm --young-size 1 --no-rtlib"), "175000\n");
+	}
+
 	//Tests the generational GC
 	void testGeneration() {
 		GCTest gcTest;
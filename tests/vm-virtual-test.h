@@ -16,5 +16,18 @@ public:
 
 	void testInheritance() {
 		TS_ASSERT_EQUALS(invokeVM("virtual/inheritance1", ""), "A\nB\nB\nB\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("virtual/inheritance2", ""), "B\nB\n0\n");
+	}
+
+	void testPolymorphic() {
+		TS_ASSERT_EQUALS(invokeVM("virtual/polymorphic1"), "180\n4\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("virtual/polymorphic1", "-inl"), "180\n4\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("virtual/polymorphic1", "-nic"), "180\n4\n0\n");
+	}
+
+	void testVirtualFunctionTable() {
+		TS_ASSERT_EQUALS(invokeVM("virtual/stub1", "-nic"), "158.25\n79.125\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("virtual/stub1", "-nic -ra"), "158.25\n79.125\n0\n");
+		TS_ASSERT_EQUALS(invokeVM("virtual/inheritance1", "-nic"), "A\nB\nB\nB\n0\n");
 	}
 };
\ No newline at end of file